@@ -0,0 +1,35 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// one quad per object instance, six vertices without vertex buffer, camera from push constants
+layout(location = 0) in vec2 inPosition; // center
+layout(location = 1) in vec2 inExtent; // half size
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in uint inTexture;
+
+layout(push_constant) uniform camera {
+    vec2 scale;
+    vec2 offset;
+} pc;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexcoord;
+layout(location = 2) flat out uint fragTexture;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(1.0, 1.0), vec2(0.0, 1.0), vec2(0.0, 0.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 position = inPosition + (corner * 2.0 - 1.0) * inExtent;
+    gl_Position = vec4(position * pc.scale + pc.offset, 0.0, 1.0);
+    fragColor = inColor.rgb;
+    fragTexcoord = corner;
+    fragTexture = inTexture;
+}
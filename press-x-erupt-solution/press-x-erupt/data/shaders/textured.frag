@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// classic binding, descriptor set of the texture is bound per draw
+layout(set = 0, binding = 0) uniform sampler2D textures[1];
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexcoord;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(fragColor, 1.0) * texture(textures[0], fragTexcoord);
+}
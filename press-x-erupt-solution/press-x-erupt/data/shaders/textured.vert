@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in uint inTexture; // per instance
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexcoord;
+layout(location = 2) flat out uint fragTexture;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    gl_Position = vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+    fragTexcoord = inPosition + vec2(0.5);
+    fragTexture = inTexture;
+}
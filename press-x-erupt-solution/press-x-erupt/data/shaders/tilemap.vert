@@ -0,0 +1,46 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// one quad per tile instance, six vertices without vertex buffer, chunk origin from push constants
+layout(location = 0) in uvec2 inTile; // atlas cell, flip flags
+
+layout(push_constant) uniform chunk {
+    vec2 scale;
+    vec2 offset;
+    ivec2 origin;
+    uint texture;
+    uint grid; // atlas columns in low half, rows in high half
+} pc;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexcoord;
+layout(location = 2) flat out uint fragTexture;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(1.0, 1.0), vec2(0.0, 1.0), vec2(0.0, 0.0)
+);
+
+void main() {
+    if (inTile.x == 0xffffu) {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0); // empty tile, degenerate and clipped
+        return;
+    }
+
+    vec2 corner = corners[gl_VertexIndex];
+    ivec2 local = ivec2(gl_InstanceIndex % 32, gl_InstanceIndex / 32);
+    vec2 position = vec2(pc.origin + local) + corner;
+    gl_Position = vec4(position * pc.scale + pc.offset, 0.0, 1.0);
+
+    uvec2 grid = uvec2(pc.grid & 0xffffu, pc.grid >> 16);
+    vec2 cell = vec2(inTile.x % grid.x, inTile.x / grid.x);
+    vec2 flipped = mix(corner, 1.0 - corner, bvec2((inTile.y & 1u) != 0u, (inTile.y & 2u) != 0u));
+
+    fragColor = vec3(1.0);
+    fragTexcoord = (cell + flipped) / vec2(grid);
+    fragTexture = pc.texture;
+}
@@ -1,19 +1,86 @@
 
 #include <px/core/application.hpp>
+#include <px/core/job_benchmark.hpp>
+#include <px/core/profiler.hpp>
+#include <px/core/simd_benchmark.hpp>
+#include <px/replay.hpp>
 
+#include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main()
+int main(int argc, char* argv[])
 {
+	bool threaded = false;
+	bool benchmark = false;
+	bool benchmark_simd = false;
+	bool profile = false;
+	bool compute = false; // default quad animated by compute pass
+	double fps = 240; // cap keeps cpu bounded when presentation does not wait (mailbox, immediate), zero disables
+	std::string replay; // capture file
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--replay" && i + 1 < argc)
+		{
+			replay = argv[++i];
+			continue;
+		}
+		if (std::string(argv[i]) == "--fps" && i + 1 < argc)
+		{
+			fps = std::atof(argv[++i]);
+			continue;
+		}
+		threaded |= std::string(argv[i]) == "--threaded";
+		benchmark |= std::string(argv[i]) == "--benchmark-jobs";
+		benchmark_simd |= std::string(argv[i]) == "--benchmark-simd";
+		profile |= std::string(argv[i]) == "--profile";
+		compute |= std::string(argv[i]) == "--compute";
+	}
+
+	if (benchmark)
+	{
+		px::benchmark_jobs(std::cout);
+		return EXIT_SUCCESS;
+	}
+	if (benchmark_simd)
+	{
+		return px::benchmark_simd(std::cout) ? EXIT_SUCCESS : EXIT_FAILURE; // mismatch with scalar kernels fails
+	}
+
+	// capture from start covers renderer creation, saved on exit unless stopped with f7 before
+	if (profile)
+	{
+		px::profiler::global().start();
+	}
+
 	int code = EXIT_FAILURE;
 	try
 	{
-		code = px::application{}.run();
+		if (!replay.empty())
+		{
+			// headless, no window is opened
+			px::job_system jobs;
+			px::replay player;
+			player.open(replay);
+			player.run(jobs, 3, std::cout);
+			code = EXIT_SUCCESS;
+		}
+		else
+		{
+			px::application app{ threaded, compute };
+			app.frame_limit(fps);
+			code = app.run();
+		}
 	}
 	catch (std::runtime_error const& exception)
 	{
 		std::cerr << exception.what() << std::endl;
 	}
+	if (px::profiler::global().enabled())
+	{
+		px::profiler::global().stop();
+		std::cout << (px::profiler::global().save("trace.json") ? "trace saved to trace.json" : "trace not saved") << std::endl;
+	}
 	return code;
 }
\ No newline at end of file
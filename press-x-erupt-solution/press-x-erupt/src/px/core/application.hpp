@@ -1,8 +1,14 @@
 #pragma once
 
 #include "basic_application.hpp"
+#include "profiler.hpp"
 
 #include <px/renderer.hpp>
+#include <px/core/triple_buffer.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
 
 namespace px
 {
@@ -10,10 +16,34 @@ namespace px
 	class application : public basic_application
 	{
 	public:
-		application()
+		// immutable state handed from simulation to rendering
+		struct frame_snapshot
+		{
+			uint64_t index; // zero if nothing was published yet
+			uint64_t tick; // simulation steps done
+			double alpha; // interpolation between previous and current simulation step
+			int width;
+			int height;
+		};
+
+	public:
+		application(bool threaded = false, bool compute = false)
 			: basic_application{"press-x"}
 			, m_renderer(*this)
+			, m_index(0)
+			, m_tick(0)
+			, m_width(width())
+			, m_height(height())
+			, m_rendered_width(width())
+			, m_rendered_height(height())
+			, m_samples(VK_SAMPLE_COUNT_1_BIT)
+			, m_screenshots(0)
 		{
+			basic_application::threaded(threaded);
+			if (compute)
+			{
+				m_renderer.animate_quad();
+			}
 		}
 
 		virtual ~application()
@@ -21,16 +51,102 @@ namespace px
 		}
 
 	protected:
+		virtual void update(double /*delta*/) override
+		{
+			++m_tick;
+		}
+		virtual void interpolate(double alpha) override
+		{
+			frame_snapshot & snapshot = m_snapshots.write_buffer();
+			snapshot.index = ++m_index;
+			snapshot.tick = m_tick;
+			snapshot.alpha = alpha;
+			snapshot.width = m_width;
+			snapshot.height = m_height;
+			m_snapshots.publish();
+		}
 		virtual void frame() override
 		{
+			m_snapshots.update();
+			frame_snapshot const& snapshot = m_snapshots.read_buffer();
+			if (snapshot.index != 0 && (snapshot.width != m_rendered_width || snapshot.height != m_rendered_height))
+			{
+				m_rendered_width = snapshot.width;
+				m_rendered_height = snapshot.height;
+				m_renderer.resize(m_rendered_width, m_rendered_height);
+			}
 			m_renderer.draw_frame();
 		}
+
+		// called from event polling on main thread, renderer picks new size up from snapshot
 		virtual void on_resize(int width, int height) override
 		{
-			m_renderer.resize(width, height);
+			m_width = width;
+			m_height = height;
+		}
+
+		// f1-f4 switch presentation between low latency, vsync, uncapped and power saving, f5 cycles msaa sample count
+		// f6 prints memory reports, f7 starts and stops profiler capture, stopped capture is saved as chrome trace
+		// f8 captures next 300 frames for replay with --replay, f9 saves screenshot of next frame
+		virtual void on_key(int key, int action, int /*mods*/) override
+		{
+			if (action != GLFW_PRESS)
+			{
+				return;
+			}
+			if (key >= GLFW_KEY_F1 && key <= GLFW_KEY_F4)
+			{
+				std::cout << "px::application - " << to_string(m_renderer.present()) << " latency " << m_renderer.present_latency() << " ms" << std::endl;
+				m_renderer.present(static_cast<present_policy>(key - GLFW_KEY_F1));
+			}
+			else if (key == GLFW_KEY_F5)
+			{
+				m_samples = m_samples >= VK_SAMPLE_COUNT_8_BIT ? VK_SAMPLE_COUNT_1_BIT : static_cast<VkSampleCountFlagBits>(m_samples << 1);
+				m_renderer.samples(m_samples);
+			}
+			else if (key == GLFW_KEY_F6)
+			{
+				m_renderer.host_allocator().report(std::cout); // atomic counters, safe while render thread runs
+				m_renderer.device_memory().report(std::cout); // locked, safe as well
+				m_renderer.defragmenter().report(std::cout);
+			}
+			else if (key == GLFW_KEY_F7)
+			{
+				profiler & capture = profiler::global();
+				if (!capture.enabled())
+				{
+					capture.start();
+					std::cout << "px::application - profiler capture started" << std::endl;
+				}
+				else
+				{
+					capture.stop();
+					std::cout << "px::application - " << (capture.save("trace.json") ? "trace saved to " : "trace not saved to ") << "trace.json" << std::endl;
+				}
+			}
+			else if (key == GLFW_KEY_F8)
+			{
+				if (!m_renderer.capturing())
+				{
+					m_renderer.capture("capture.pxc", 300);
+				}
+			}
+			else if (key == GLFW_KEY_F9)
+			{
+				m_renderer.screenshot("screenshot_" + std::to_string(++m_screenshots) + ".png");
+			}
 		}
 
 	private:
-		renderer m_renderer;
+		renderer m_renderer; // used by render thread only after construction
+		triple_buffer<frame_snapshot> m_snapshots;
+		uint64_t m_index;
+		uint64_t m_tick;
+		int m_width; // main thread
+		int m_height;
+		int m_rendered_width; // render thread
+		int m_rendered_height;
+		VkSampleCountFlagBits m_samples; // requested, main thread
+		uint32_t m_screenshots; // taken, main thread
 	};
 }
\ No newline at end of file
@@ -3,7 +3,17 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "frame_limiter.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
 #include <string>
+#include <thread>
 
 namespace px
 {
@@ -19,11 +29,16 @@ namespace px
 
 			glfwSetWindowUserPointer(m_window, this);
 			glfwSetWindowSizeCallback(m_window, resize_callback);
+			glfwSetKeyCallback(m_window, key_callback);
 		}
 		static void resize_callback(GLFWwindow* window, int width, int height)
 		{
 			reinterpret_cast<basic_application*>(glfwGetWindowUserPointer(window))->on_resize(width, height);
 		}
+		static void key_callback(GLFWwindow* window, int key, int /*scancode*/, int action, int mods)
+		{
+			reinterpret_cast<basic_application*>(glfwGetWindowUserPointer(window))->on_key(key, action, mods);
+		}
 		int run()
 		{
 			main_loop();
@@ -50,13 +65,56 @@ namespace px
 		{
 			return m_window;
 		}
+		// shared by all parallel work, jobs queued with run_on_main() are executed by main loop
+		job_system & jobs() noexcept
+		{
+			return m_jobs;
+		}
+		// frame() on dedicated render thread, main thread only polls events and calls update()
+		// has to be set before run()
+		void threaded(bool enable) noexcept
+		{
+			m_threaded = enable;
+		}
+		bool threaded() const noexcept
+		{
+			return m_threaded;
+		}
+		// seconds of simulation advanced by each update()
+		void timestep(double step) noexcept
+		{
+			m_step = step;
+		}
+		double timestep() const noexcept
+		{
+			return m_step;
+		}
+		// caps frame() calls per second, zero for uncapped, safe to call from any thread
+		void frame_limit(double fps) noexcept
+		{
+			m_limiter.limit(fps);
+		}
+		double frame_limit() const noexcept
+		{
+			return m_limiter.limit();
+		}
+		// milliseconds from construction to first presented frame, zero before that
+		double cold_start() const noexcept
+		{
+			return m_cold_start.load();
+		}
 
 	public:
 		basic_application(std::string name)
-			: m_init(false)
+			: m_start(std::chrono::high_resolution_clock::now())
+			, m_cold_start(0)
+			, m_step(1.0 / 60.0)
+			, m_accumulator(0)
+			, m_init(false)
+			, m_threaded(false)
 			, m_fullscreen(false)
-			, m_name(name)
 			, m_width(800), m_height(600)
+			, m_name(name)
 		{
 			m_init = glfwInit() == GLFW_TRUE;
 			if (m_init)
@@ -76,25 +134,180 @@ namespace px
 		}
 
 	protected:
+		// fixed step simulation and input, always on main thread
+		virtual void update(double /*delta*/)
+		{
+		}
+		// called after updates with fraction of step accumulated but not simulated yet, on main thread
+		virtual void interpolate(double /*alpha*/)
+		{
+		}
+		// rendering, on render thread in threaded mode
 		virtual void frame()
 		{
 		}
 		virtual void on_resize(int /*width*/, int /*height*/)
 		{
 		}
+		// glfw key code, action and modifiers, on main thread
+		virtual void on_key(int /*key*/, int /*action*/, int /*mods*/)
+		{
+		}
 
 	private:
 		void main_loop()
 		{
+			if (m_threaded)
+			{
+				threaded_loop();
+				return;
+			}
+
+			PX_PROFILE_THREAD("main");
+			m_last = frame_limiter::clock::now();
 			while (!glfwWindowShouldClose(m_window))
 			{
-				glfwPollEvents();
-				frame();
+				PX_PROFILE_ZONE("main loop");
+				poll();
+				pump();
+				simulate();
+				draw();
+				measure_cold_start();
+				limit();
 			}
 		}
+		void threaded_loop()
+		{
+			std::atomic<bool> stop(false);
+			std::exception_ptr error;
+
+			std::thread render([this, &stop, &error]() {
+				PX_PROFILE_THREAD("render");
+				try
+				{
+					while (!stop)
+					{
+						PX_PROFILE_ZONE("render loop");
+						draw();
+						measure_cold_start();
+						limit();
+					}
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+					glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+					glfwPostEmptyEvent();
+				}
+			});
+
+			// render thread is stopped and joined on every way out, also when main thread throws
+			struct joiner
+			{
+				std::atomic<bool> & stop;
+				std::thread & thread;
+				~joiner()
+				{
+					stop = true;
+					thread.join();
+				}
+			};
+
+			// window system stalls no longer hold rendering
+			// main thread sleeps until next event or simulation step, waking at least every millisecond to refresh interpolation
+			{
+				joiner guard{ stop, render };
+				PX_PROFILE_THREAD("main");
+				m_last = frame_limiter::clock::now();
+				while (!glfwWindowShouldClose(m_window))
+				{
+					PX_PROFILE_ZONE("main loop");
+					double due = m_step - m_accumulator - seconds(frame_limiter::clock::now() - m_last);
+					if (due > 0)
+					{
+						PX_PROFILE_ZONE("wait events");
+						glfwWaitEventsTimeout(std::min(due, 0.001));
+					}
+					else
+					{
+						poll();
+					}
+					pump();
+					simulate();
+				}
+			}
+
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+		void poll()
+		{
+			PX_PROFILE_FUNCTION();
+			glfwPollEvents();
+		}
+		void draw()
+		{
+			PX_PROFILE_ZONE("frame");
+			frame();
+		}
+		void limit()
+		{
+			PX_PROFILE_ZONE("frame limiter");
+			m_limiter.wait();
+		}
+		void pump()
+		{
+			PX_PROFILE_FUNCTION();
+			while (m_jobs.pump_main())
+			{
+			}
+		}
+		void simulate()
+		{
+			PX_PROFILE_FUNCTION();
+			auto now = frame_limiter::clock::now();
+			double elapsed = seconds(now - m_last);
+			m_last = now;
+
+			// under load simulation slows down instead of spiralling into ever longer catch-up
+			m_accumulator += std::min(elapsed, m_step * max_steps);
+			while (m_accumulator >= m_step)
+			{
+				update(m_step);
+				m_accumulator -= m_step;
+			}
+			interpolate(m_accumulator / m_step);
+		}
+		void measure_cold_start()
+		{
+			if (m_cold_start.load() == 0)
+			{
+				double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+				m_cold_start.store(elapsed);
+				std::cout << "px::basic_application - cold start to first frame " << elapsed << " ms" << std::endl;
+			}
+		}
+
+		static double seconds(frame_limiter::clock::duration duration) noexcept
+		{
+			return std::chrono::duration<double>(duration).count();
+		}
+
+	private:
+		static const int max_steps = 8; // per loop iteration
 
 	private:
+		job_system m_jobs; // first, so workers outlive everything using them
+		std::chrono::high_resolution_clock::time_point m_start;
+		std::atomic<double> m_cold_start; // written once by thread presenting, read from any
+		double m_step; // seconds
+		double m_accumulator; // seconds not simulated yet
+		frame_limiter::clock::time_point m_last;
+		frame_limiter m_limiter;
 		bool m_init;
+		bool m_threaded;
 		bool m_fullscreen;
 		int m_width;
 		int m_height;
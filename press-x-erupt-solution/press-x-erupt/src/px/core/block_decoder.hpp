@@ -0,0 +1,390 @@
+#pragma once
+
+// cpu decoding of block compressed texels into rgba8, for devices not sampling the format natively
+// every 4x4 block decodes independently, so rows of blocks are spread over job system
+// bc1-5 follow directx block layouts, etc2 and eac follow khronos data format specification
+
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	enum class block_format : int
+	{
+		bc1,
+		bc1_rgb, // no punch-through alpha
+		bc2,
+		bc3,
+		bc4,
+		bc5,
+		etc2_rgb,
+		etc2_rgba
+	};
+
+	namespace block
+	{
+		inline unsigned int bytes(block_format format) noexcept
+		{
+			switch (format)
+			{
+			case block_format::bc1:
+			case block_format::bc1_rgb:
+			case block_format::bc4:
+			case block_format::etc2_rgb:
+				return 8;
+			default:
+				return 16;
+			}
+		}
+
+		inline uint8_t clamp(int value) noexcept
+		{
+			return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+		}
+		inline uint16_t load16(uint8_t const* data) noexcept
+		{
+			return static_cast<uint16_t>(data[0] | data[1] << 8);
+		}
+		inline uint32_t load32(uint8_t const* data) noexcept
+		{
+			return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+		}
+		inline uint64_t load64_be(uint8_t const* data) noexcept
+		{
+			uint64_t result = 0;
+			for (int i = 0; i != 8; ++i)
+			{
+				result = result << 8 | data[i];
+			}
+			return result;
+		}
+		inline uint32_t bits(uint64_t value, unsigned int high, unsigned int low) noexcept
+		{
+			return static_cast<uint32_t>((value >> low) & ((uint64_t{ 1 } << (high - low + 1)) - 1));
+		}
+
+		// texels are 4x4 rgba, row major
+		typedef uint8_t texels[64];
+
+		// color endpoints in 565 with two interpolated colors, or one and transparent black if first endpoint is not greater
+		inline void decode_bc1_color(uint8_t const* data, texels & out, bool four_colors, bool punch_through) noexcept
+		{
+			uint16_t c0 = load16(data);
+			uint16_t c1 = load16(data + 2);
+			uint32_t indices = load32(data + 4);
+
+			int palette[4][4];
+			for (int i = 0; i != 2; ++i)
+			{
+				uint16_t c = i == 0 ? c0 : c1;
+				int r = c >> 11 & 31, g = c >> 5 & 63, b = c & 31;
+				palette[i][0] = r << 3 | r >> 2;
+				palette[i][1] = g << 2 | g >> 4;
+				palette[i][2] = b << 3 | b >> 2;
+				palette[i][3] = 255;
+			}
+			if (four_colors || c0 > c1)
+			{
+				for (int k = 0; k != 3; ++k)
+				{
+					palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+					palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+				}
+				palette[2][3] = palette[3][3] = 255;
+			}
+			else
+			{
+				for (int k = 0; k != 3; ++k)
+				{
+					palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+					palette[3][k] = 0;
+				}
+				palette[2][3] = 255;
+				palette[3][3] = punch_through ? 0 : 255;
+			}
+
+			for (int i = 0; i != 16; ++i)
+			{
+				int const* color = palette[indices >> (2 * i) & 3];
+				for (int k = 0; k != 4; ++k)
+				{
+					out[i * 4 + k] = static_cast<uint8_t>(color[k]);
+				}
+			}
+		}
+
+		// two 8 bit endpoints, eight level ramp or six levels with explicit 0 and 255, 3 bit indices
+		inline void decode_bc4_channel(uint8_t const* data, texels & out, int channel) noexcept
+		{
+			int a0 = data[0];
+			int a1 = data[1];
+			int ramp[8] = { a0, a1 };
+			if (a0 > a1)
+			{
+				for (int i = 1; i != 7; ++i)
+				{
+					ramp[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+				}
+			}
+			else
+			{
+				for (int i = 1; i != 5; ++i)
+				{
+					ramp[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+				}
+				ramp[6] = 0;
+				ramp[7] = 255;
+			}
+
+			uint64_t indices = 0;
+			for (int i = 7; i != 1; --i)
+			{
+				indices = indices << 8 | data[i];
+			}
+			for (int i = 0; i != 16; ++i)
+			{
+				out[i * 4 + channel] = static_cast<uint8_t>(ramp[indices >> (3 * i) & 7]);
+			}
+		}
+
+		// etc1 luminance modifiers and etc2 t/h mode distances
+		static int const etc_modifiers[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+		static int const etc_distances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+		// individual, differential, t, h and planar modes, indices are column major
+		inline void decode_etc2_color(uint8_t const* data, texels & out) noexcept
+		{
+			uint64_t block = load64_be(data);
+			uint32_t low = static_cast<uint32_t>(block);
+			auto index = [low](int x, int y) { int p = x * 4 + y; return static_cast<int>((low >> (16 + p) & 1) << 1 | (low >> p & 1)); };
+			auto put = [&out](int x, int y, int r, int g, int b) {
+				uint8_t * texel = out + (y * 4 + x) * 4;
+				texel[0] = clamp(r);
+				texel[1] = clamp(g);
+				texel[2] = clamp(b);
+				texel[3] = 255;
+			};
+			auto extend4 = [](uint32_t v) { return static_cast<int>(v << 4 | v); };
+			auto extend5 = [](uint32_t v) { return static_cast<int>(v << 3 | v >> 2); };
+			auto extend6 = [](uint32_t v) { return static_cast<int>(v << 2 | v >> 4); };
+			auto extend7 = [](uint32_t v) { return static_cast<int>(v << 1 | v >> 6); };
+
+			int base[2][3];
+			if (bits(block, 33, 33) == 0)
+			{
+				// individual, two 444 colors
+				for (int k = 0; k != 3; ++k)
+				{
+					base[0][k] = extend4(bits(block, 63 - k * 8, 60 - k * 8));
+					base[1][k] = extend4(bits(block, 59 - k * 8, 56 - k * 8));
+				}
+			}
+			else
+			{
+				int c[3], d[3];
+				for (int k = 0; k != 3; ++k)
+				{
+					c[k] = static_cast<int>(bits(block, 63 - k * 8, 59 - k * 8));
+					d[k] = static_cast<int>(bits(block, 58 - k * 8, 56 - k * 8));
+					d[k] = d[k] >= 4 ? d[k] - 8 : d[k];
+				}
+
+				if (c[0] + d[0] < 0 || c[0] + d[0] > 31)
+				{
+					// t mode, one color and one pair around second color
+					int c1[3] = { extend4(bits(block, 60, 59) << 2 | bits(block, 57, 56)), extend4(bits(block, 55, 52)), extend4(bits(block, 51, 48)) };
+					int c2[3] = { extend4(bits(block, 47, 44)), extend4(bits(block, 43, 40)), extend4(bits(block, 39, 36)) };
+					int distance = etc_distances[bits(block, 35, 34) << 1 | bits(block, 32, 32)];
+					int paint[4][3];
+					for (int k = 0; k != 3; ++k)
+					{
+						paint[0][k] = c1[k];
+						paint[1][k] = c2[k] + distance;
+						paint[2][k] = c2[k];
+						paint[3][k] = c2[k] - distance;
+					}
+					for (int y = 0; y != 4; ++y)
+					{
+						for (int x = 0; x != 4; ++x)
+						{
+							int const* p = paint[index(x, y)];
+							put(x, y, p[0], p[1], p[2]);
+						}
+					}
+					return;
+				}
+				if (c[1] + d[1] < 0 || c[1] + d[1] > 31)
+				{
+					// h mode, two pairs, lowest distance bit is ordering of base colors
+					uint32_t r1 = bits(block, 62, 59), g1 = bits(block, 58, 56) << 1 | bits(block, 52, 52), b1 = bits(block, 51, 51) << 3 | bits(block, 49, 47);
+					uint32_t r2 = bits(block, 46, 43), g2 = bits(block, 42, 39), b2 = bits(block, 38, 35);
+					uint32_t order = (r1 << 8 | g1 << 4 | b1) >= (r2 << 8 | g2 << 4 | b2) ? 1 : 0;
+					int distance = etc_distances[bits(block, 34, 34) << 2 | bits(block, 32, 32) << 1 | order];
+					int c1[3] = { extend4(r1), extend4(g1), extend4(b1) };
+					int c2[3] = { extend4(r2), extend4(g2), extend4(b2) };
+					int paint[4][3];
+					for (int k = 0; k != 3; ++k)
+					{
+						paint[0][k] = c1[k] + distance;
+						paint[1][k] = c1[k] - distance;
+						paint[2][k] = c2[k] + distance;
+						paint[3][k] = c2[k] - distance;
+					}
+					for (int y = 0; y != 4; ++y)
+					{
+						for (int x = 0; x != 4; ++x)
+						{
+							int const* p = paint[index(x, y)];
+							put(x, y, p[0], p[1], p[2]);
+						}
+					}
+					return;
+				}
+				if (c[2] + d[2] < 0 || c[2] + d[2] > 31)
+				{
+					// planar, origin with horizontal and vertical gradients
+					int o[3] = { extend6(bits(block, 62, 57)), extend7(bits(block, 56, 56) << 6 | bits(block, 54, 49)), extend6(bits(block, 48, 48) << 5 | bits(block, 44, 43) << 3 | bits(block, 41, 39)) };
+					int h[3] = { extend6(bits(block, 38, 34) << 1 | bits(block, 32, 32)), extend7(bits(block, 31, 25)), extend6(bits(block, 24, 19)) };
+					int v[3] = { extend6(bits(block, 18, 13)), extend7(bits(block, 12, 6)), extend6(bits(block, 5, 0)) };
+					for (int y = 0; y != 4; ++y)
+					{
+						for (int x = 0; x != 4; ++x)
+						{
+							int rgb[3];
+							for (int k = 0; k != 3; ++k)
+							{
+								rgb[k] = (x * (h[k] - o[k]) + y * (v[k] - o[k]) + 4 * o[k] + 2) >> 2;
+							}
+							put(x, y, rgb[0], rgb[1], rgb[2]);
+						}
+					}
+					return;
+				}
+
+				// differential, 555 color and 333 signed offset
+				for (int k = 0; k != 3; ++k)
+				{
+					base[0][k] = extend5(static_cast<uint32_t>(c[k]));
+					base[1][k] = extend5(static_cast<uint32_t>(c[k] + d[k]));
+				}
+			}
+
+			// two half blocks with own luminance table, side by side or stacked
+			bool flip = bits(block, 32, 32) != 0;
+			uint32_t tables[2] = { bits(block, 39, 37), bits(block, 36, 34) };
+			for (int y = 0; y != 4; ++y)
+			{
+				for (int x = 0; x != 4; ++x)
+				{
+					int half = flip ? (y >= 2 ? 1 : 0) : (x >= 2 ? 1 : 0);
+					int i = index(x, y);
+					int modifier = etc_modifiers[tables[half]][i & 1];
+					modifier = (i & 2) != 0 ? -modifier : modifier;
+					put(x, y, base[half][0] + modifier, base[half][1] + modifier, base[half][2] + modifier);
+				}
+			}
+		}
+
+		// eac alpha, base value with multiplied modifier from one of sixteen tables, indices are column major
+		inline void decode_eac_alpha(uint8_t const* data, texels & out) noexcept
+		{
+			static int const tables[16][8] = {
+				{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 }, { -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+				{ -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 }, { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+				{ -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 }, { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+				{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 }, { -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 }
+			};
+
+			uint64_t block = load64_be(data);
+			int base = static_cast<int>(bits(block, 63, 56));
+			int multiplier = static_cast<int>(bits(block, 55, 52));
+			int const* table = tables[bits(block, 51, 48)];
+			for (int p = 0; p != 16; ++p)
+			{
+				int x = p / 4, y = p % 4;
+				out[(y * 4 + x) * 4 + 3] = clamp(base + table[bits(block, 47 - p * 3, 45 - p * 3)] * multiplier);
+			}
+		}
+
+		inline void decode(block_format format, uint8_t const* data, texels & out) noexcept
+		{
+			switch (format)
+			{
+			case block_format::bc1:
+				decode_bc1_color(data, out, false, true);
+				break;
+			case block_format::bc1_rgb:
+				decode_bc1_color(data, out, false, false);
+				break;
+			case block_format::bc2:
+				decode_bc1_color(data + 8, out, true, false);
+				for (int i = 0; i != 16; ++i)
+				{
+					out[i * 4 + 3] = static_cast<uint8_t>((data[i / 2] >> (4 * (i & 1)) & 15) * 17);
+				}
+				break;
+			case block_format::bc3:
+				decode_bc1_color(data + 8, out, true, false);
+				decode_bc4_channel(data, out, 3);
+				break;
+			case block_format::bc4:
+			case block_format::bc5:
+				std::memset(out, 0, sizeof(texels));
+				for (int i = 0; i != 16; ++i)
+				{
+					out[i * 4 + 3] = 255;
+				}
+				decode_bc4_channel(data, out, 0);
+				if (format == block_format::bc5)
+				{
+					decode_bc4_channel(data + 8, out, 1);
+				}
+				break;
+			case block_format::etc2_rgb:
+				decode_etc2_color(data, out);
+				break;
+			case block_format::etc2_rgba:
+				decode_etc2_color(data + 8, out);
+				decode_eac_alpha(data, out);
+				break;
+			}
+		}
+	}
+
+	// whole level into tightly packed rgba8 rows, partial blocks at right and bottom edges are cropped
+	inline std::vector<char> decode_blocks(block_format format, std::vector<char> const& data, uint32_t width, uint32_t height, job_system & jobs)
+	{
+		uint32_t columns = (width + 3) / 4;
+		uint32_t rows = (height + 3) / 4;
+		size_t stride = block::bytes(format);
+		if (data.size() < size_t{ columns } * rows * stride)
+		{
+			throw std::runtime_error("px::decode_blocks() - not enough data for level");
+		}
+
+		std::vector<char> result(size_t{ width } * height * 4);
+		jobs.parallel_for<uint32_t>(0, rows, 4, [&](uint32_t first, uint32_t last) {
+			block::texels texels;
+			for (uint32_t row = first; row != last; ++row)
+			{
+				for (uint32_t column = 0; column != columns; ++column)
+				{
+					block::decode(format, reinterpret_cast<uint8_t const*>(data.data()) + (size_t{ row } * columns + column) * stride, texels);
+
+					uint32_t x0 = column * 4, y0 = row * 4;
+					uint32_t w = std::min(4u, width - x0), h = std::min(4u, height - y0);
+					for (uint32_t y = 0; y != h; ++y)
+					{
+						std::memcpy(result.data() + ((size_t{ y0 } + y) * width + x0) * 4, texels + y * 16, w * 4);
+					}
+				}
+			}
+		});
+		return result;
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// caps loop frequency without burning cpu and without oversleeping
+// bulk of remaining time is slept, last part is spun
+// spin margin adapts to observed sleep overshoot of the system scheduler
+// limit may be changed from any thread, schedule restarts on next wait of the limited thread
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace px
+{
+	class frame_limiter final
+	{
+	public:
+		typedef std::chrono::high_resolution_clock clock;
+
+	public:
+		// frames per second, zero to disable
+		void limit(double fps) noexcept
+		{
+			m_period.store(fps > 0 ? 1.0 / fps : 0.0);
+			m_restart.store(true);
+		}
+		double limit() const noexcept
+		{
+			double period = m_period.load();
+			return period > 0 ? 1.0 / period : 0.0;
+		}
+
+		// blocks until next frame is due
+		void wait()
+		{
+			double period = m_period.load();
+			if (period <= 0)
+			{
+				return;
+			}
+			if (m_restart.exchange(false))
+			{
+				m_deadline = clock::now();
+			}
+
+			m_deadline += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(period));
+			auto now = clock::now();
+			if (m_deadline < now)
+			{
+				m_deadline = now; // late frame, do not try to catch up with burst
+				return;
+			}
+			wait_until(m_deadline);
+		}
+
+		// sleeps while far from target, spins the rest
+		void wait_until(clock::time_point target)
+		{
+			for (;;)
+			{
+				double remaining = seconds(target - clock::now());
+				if (remaining <= m_estimate)
+				{
+					break;
+				}
+
+				auto before = clock::now();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				double slept = seconds(clock::now() - before);
+
+				// running estimate of how long 1ms sleep really takes, biased to worst case
+				m_estimate = slept > m_estimate ? slept : m_estimate * 0.99 + slept * 0.01;
+			}
+
+			while (clock::now() < target)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+	public:
+		frame_limiter() noexcept
+			: m_period(0)
+			, m_restart(true)
+			, m_estimate(0.002)
+			, m_deadline(clock::now())
+		{
+		}
+
+	private:
+		static double seconds(clock::duration duration) noexcept
+		{
+			return std::chrono::duration<double>(duration).count();
+		}
+
+	private:
+		std::atomic<double> m_period; // seconds, zero if not limited
+		std::atomic<bool> m_restart; // limit changed, deadline starts over from now
+		double m_estimate; // seconds of sleep overshoot to spin through
+		clock::time_point m_deadline;
+	};
+}
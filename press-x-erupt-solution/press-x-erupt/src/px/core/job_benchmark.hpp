@@ -0,0 +1,65 @@
+#pragma once
+
+// micro-benchmark of job system scaling
+// same compute-bound parallel_for is timed with growing number of workers
+// speedup is relative to run with calling thread only
+
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace px
+{
+	// returns checksum of results, so the work can not be optimized away
+	inline double benchmark_jobs(std::ostream & stream, size_t elements = 1 << 20, unsigned int repeats = 8)
+	{
+		typedef std::chrono::high_resolution_clock clock;
+
+		std::vector<float> data(elements);
+		unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+		double single = 0;
+		double checksum = 0;
+
+		stream << "px::benchmark_jobs - " << elements << " elements, " << repeats << " repeats" << std::endl;
+		stream << std::fixed << std::setprecision(2);
+		for (unsigned int threads = 1; threads <= cores; threads = threads < cores ? std::min(threads * 2, cores) : cores + 1)
+		{
+			job_system jobs(threads - 1);
+
+			auto start = clock::now();
+			for (unsigned int r = 0; r != repeats; ++r)
+			{
+				jobs.parallel_for<size_t>(0, elements, 1024, [&data, r](size_t first, size_t last) {
+					for (size_t i = first; i != last; ++i)
+					{
+						float x = static_cast<float>(i + r);
+						for (int k = 0; k != 32; ++k)
+						{
+							x = std::sqrt(x * 1.0001f + 0.5f);
+						}
+						data[i] = x;
+					}
+				});
+			}
+			double elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+			for (size_t i = 0; i < elements; i += 4096)
+			{
+				checksum += data[i];
+			}
+			if (threads == 1)
+			{
+				single = elapsed;
+			}
+			stream << "  " << std::setw(3) << threads << " threads" << std::setw(10) << elapsed << " ms" << std::setw(8) << single / elapsed << "x" << std::endl;
+		}
+		return checksum;
+	}
+}
@@ -0,0 +1,518 @@
+#pragma once
+
+// work-stealing job scheduler
+// every worker owns lock-free deque (chase-lev), pushes and pops own end, steals from other end of others
+// thread that created the system owns deque too and executes jobs while waiting, so it is never blocked idle
+// other threads submit through shared injection queue
+// completion is tracked with counters, jobs can be chained to run after counter reaches zero
+// jobs with main-thread affinity are queued separately and executed by pump_main() or wait() on main thread
+// exception of job is kept in its counter and rethrown by wait(), first one wins, exceptions of jobs without counter are logged
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace px
+{
+	class job_system;
+
+	class job_counter final
+	{
+	public:
+		bool done() const noexcept
+		{
+			return m_value.load(std::memory_order_acquire) == 0;
+		}
+		int pending() const noexcept
+		{
+			return m_value.load(std::memory_order_acquire);
+		}
+
+	public:
+		job_counter() noexcept
+			: m_value(0)
+			, m_closed(false)
+		{
+		}
+		job_counter(job_counter const&) = delete;
+		job_counter& operator=(job_counter const&) = delete;
+
+	private:
+		friend class job_system;
+		std::atomic<int> m_value;
+		std::atomic<bool> m_closed; // last job finishing, continuations already taken
+		std::mutex m_mutex;
+		std::vector<std::function<void()>> m_continuations; // submitted when value reaches zero
+		std::exception_ptr m_error; // first exception thrown by counted jobs, taken by wait
+	};
+
+	class job_system final
+	{
+	public:
+		typedef std::function<void()> job_fn;
+
+	public:
+		unsigned int workers() const noexcept
+		{
+			return static_cast<unsigned int>(m_threads.size());
+		}
+		// one thread per core, including main thread
+		static unsigned int default_workers() noexcept
+		{
+			return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+
+		// counter is incremented now and decremented after job finishes, may be null
+		void run(job_fn fn, job_counter * counter = nullptr)
+		{
+			increment(counter);
+			submit(new job{ std::move(fn), counter });
+		}
+
+		// job is scheduled after dependency reaches zero, dependency must not be reused until then
+		void run_after(job_counter & dependency, job_fn fn, job_counter * counter = nullptr)
+		{
+			increment(counter);
+			{
+				std::lock_guard<std::mutex> lock(dependency.m_mutex);
+				if (!dependency.done() && !dependency.m_closed.load(std::memory_order_relaxed))
+				{
+					dependency.m_continuations.push_back([this, fn, counter]() { submit(new job{ fn, counter }); });
+					return;
+				}
+			}
+			submit(new job{ std::move(fn), counter });
+		}
+
+		// calling thread executes jobs until counter reaches zero, then rethrows exception of counted job if any
+		void wait(job_counter & counter)
+		{
+			bool main = std::this_thread::get_id() == m_main_thread;
+			while (!counter.done())
+			{
+				if (main && pump_main())
+				{
+					continue;
+				}
+				job * current = find();
+				if (current)
+				{
+					execute(current);
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			std::exception_ptr error;
+			{
+				std::lock_guard<std::mutex> lock(counter.m_mutex);
+				error.swap(counter.m_error);
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		// splits [begin, end) into chunks of at least grain elements, fn(chunk_begin, chunk_end) called concurrently, returns after all finished
+		// first exception thrown by any chunk is rethrown after all chunks finished
+		template <typename Index, typename Fn>
+		void parallel_for(Index begin, Index end, Index grain, Fn fn)
+		{
+			if (end <= begin)
+			{
+				return;
+			}
+			Index count = end - begin;
+			Index chunks = std::min<Index>(std::max<Index>(count / std::max<Index>(grain, 1), 1), static_cast<Index>((workers() + 1) * 4));
+			Index size = (count + chunks - 1) / chunks;
+
+			std::mutex error_mutex;
+			std::exception_ptr error;
+			auto chunk = [&](Index first, Index last) {
+				try
+				{
+					fn(first, last);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+				}
+			};
+
+			job_counter counter;
+			for (Index first = begin + size; first < end; first += size)
+			{
+				Index last = std::min<Index>(first + size, end);
+				run([&chunk, first, last]() { chunk(first, last); }, &counter);
+			}
+			chunk(begin, std::min<Index>(begin + size, end)); // first chunk on calling thread
+			wait(counter);
+
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		// job executed on main thread by pump_main() or while main thread waits
+		void run_on_main(job_fn fn, job_counter * counter = nullptr)
+		{
+			increment(counter);
+			std::lock_guard<std::mutex> lock(m_main_mutex);
+			m_main.push_back(new job{ std::move(fn), counter });
+		}
+
+		// executes one main-thread job, returns false if there was none
+		bool pump_main()
+		{
+			job * current = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_main_mutex);
+				if (!m_main.empty())
+				{
+					current = m_main.front();
+					m_main.pop_front();
+				}
+			}
+			if (current)
+			{
+				execute(current);
+			}
+			return current != nullptr;
+		}
+
+	public:
+		// creating thread becomes main thread, with zero workers all jobs run on threads waiting for them
+		job_system(unsigned int worker_count = default_workers())
+			: m_stop(false)
+			, m_main_thread(std::this_thread::get_id())
+			, m_sleeping(0)
+		{
+			for (unsigned int i = 0; i != worker_count + 1; ++i)
+			{
+				m_queues.push_back(std::make_unique<work_deque>());
+			}
+			for (unsigned int i = 1; i != worker_count + 1; ++i)
+			{
+				m_threads.emplace_back([this, i]() { work(i); });
+			}
+		}
+		job_system(job_system const&) = delete;
+		job_system& operator=(job_system const&) = delete;
+		~job_system()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_sleep_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (auto & thread : m_threads)
+			{
+				thread.join();
+			}
+
+			// jobs never started are dropped
+			job * current;
+			while ((current = find()) != nullptr)
+			{
+				delete current;
+			}
+			for (job * pending : m_main)
+			{
+				delete pending;
+			}
+		}
+
+	private:
+		struct job
+		{
+			job_fn fn;
+			job_counter * counter;
+		};
+
+		// chase-lev deque with fixed capacity, owner pushes and pops bottom, thieves take top
+		class work_deque
+		{
+		public:
+			bool push(job * item) noexcept
+			{
+				int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+				int64_t top = m_top.load(std::memory_order_acquire);
+				if (bottom - top >= capacity)
+				{
+					return false;
+				}
+				m_items[bottom & mask].store(item, std::memory_order_relaxed);
+				m_bottom.store(bottom + 1, std::memory_order_release); // publishes item to thieves
+				return true;
+			}
+			job * pop() noexcept
+			{
+				int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+				m_bottom.store(bottom, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t top = m_top.load(std::memory_order_relaxed);
+
+				if (top > bottom)
+				{
+					m_bottom.store(bottom + 1, std::memory_order_relaxed); // empty
+					return nullptr;
+				}
+
+				job * item = m_items[bottom & mask].load(std::memory_order_relaxed);
+				if (top == bottom)
+				{
+					// last item, race against thieves
+					if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					{
+						item = nullptr;
+					}
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				}
+				return item;
+			}
+			job * steal() noexcept
+			{
+				int64_t top = m_top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t bottom = m_bottom.load(std::memory_order_acquire);
+				if (top >= bottom)
+				{
+					return nullptr;
+				}
+
+				job * item = m_items[top & mask].load(std::memory_order_relaxed);
+				if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					return nullptr; // lost race
+				}
+				return item;
+			}
+
+		public:
+			work_deque()
+				: m_top(0)
+				, m_bottom(0)
+				, m_items(new std::atomic<job*>[capacity])
+			{
+			}
+
+		private:
+			static const int64_t capacity = 4096;
+			static const int64_t mask = capacity - 1;
+
+		private:
+			std::atomic<int64_t> m_top;
+			std::atomic<int64_t> m_bottom;
+			std::unique_ptr<std::atomic<job*>[]> m_items;
+		};
+
+	private:
+		void submit(job * item)
+		{
+			int index = thread_index();
+			if (index < 0 || !m_queues[index]->push(item))
+			{
+				std::lock_guard<std::mutex> lock(m_injection_mutex);
+				m_injection.push_back(item);
+			}
+			if (m_sleeping.load(std::memory_order_acquire) > 0)
+			{
+				m_wake.notify_one();
+			}
+		}
+		void execute(job * current)
+		{
+			PX_PROFILE_ZONE("job");
+			try
+			{
+				current->fn();
+			}
+			catch (...)
+			{
+				fail(current->counter, std::current_exception());
+			}
+			finish(current->counter);
+			delete current;
+		}
+		// escaping exception would terminate worker, so it is handed to waiter of counter
+		static void fail(job_counter * counter, std::exception_ptr error)
+		{
+			if (!counter)
+			{
+				try
+				{
+					std::rethrow_exception(error);
+				}
+				catch (std::exception const& exception)
+				{
+					std::cout << "px::job_system - job failed, " << exception.what() << std::endl;
+				}
+				catch (...)
+				{
+					std::cout << "px::job_system - job failed with unknown exception" << std::endl;
+				}
+				return;
+			}
+			std::lock_guard<std::mutex> lock(counter->m_mutex);
+			if (!counter->m_error)
+			{
+				counter->m_error = error;
+			}
+		}
+		void finish(job_counter * counter)
+		{
+			if (!counter)
+			{
+				return;
+			}
+
+			int value = counter->m_value.load(std::memory_order_acquire);
+			while (value != 1)
+			{
+				if (counter->m_value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel))
+				{
+					return;
+				}
+			}
+
+			// last job, continuations are taken before reaching zero, waiter may destroy counter right after
+			std::vector<job_fn> continuations;
+			{
+				std::lock_guard<std::mutex> lock(counter->m_mutex);
+				counter->m_closed.store(true, std::memory_order_relaxed);
+				continuations.swap(counter->m_continuations);
+			}
+			counter->m_value.fetch_sub(1, std::memory_order_acq_rel);
+
+			for (auto & continuation : continuations)
+			{
+				continuation();
+			}
+		}
+		static void increment(job_counter * counter) noexcept
+		{
+			if (counter && counter->m_value.fetch_add(1, std::memory_order_acq_rel) == 0)
+			{
+				counter->m_closed.store(false, std::memory_order_relaxed);
+			}
+		}
+
+		// own deque first, then injection queue, then stealing from others
+		job * find()
+		{
+			int index = thread_index();
+			job * found = index >= 0 ? m_queues[index]->pop() : nullptr;
+			if (found)
+			{
+				return found;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_injection_mutex);
+				if (!m_injection.empty())
+				{
+					found = m_injection.front();
+					m_injection.pop_front();
+					return found;
+				}
+			}
+
+			size_t size = m_queues.size();
+			size_t start = index >= 0 ? static_cast<size_t>(index) + 1 : 0;
+			for (size_t i = 0; i != size && !found; ++i)
+			{
+				size_t victim = (start + i) % size;
+				if (static_cast<int>(victim) != index)
+				{
+					found = m_queues[victim]->steal();
+				}
+			}
+			return found;
+		}
+		void work(unsigned int index)
+		{
+			worker_index() = static_cast<int>(index);
+			worker_owner() = this;
+			PX_PROFILE_THREAD("worker " + std::to_string(index));
+
+			unsigned int idle = 0;
+			while (!m_stop.load(std::memory_order_acquire))
+			{
+				job * current = find();
+				if (current)
+				{
+					execute(current);
+					idle = 0;
+				}
+				else if (++idle < 64)
+				{
+					std::this_thread::yield();
+				}
+				else
+				{
+					// sleep with timeout, thieves have no notification about items pushed by other workers
+					std::unique_lock<std::mutex> lock(m_sleep_mutex);
+					++m_sleeping;
+					m_wake.wait_for(lock, std::chrono::milliseconds(1), [this]() { return m_stop.load(); });
+					--m_sleeping;
+					idle = 0;
+				}
+			}
+		}
+
+		// index of deque owned by calling thread in this system, -1 for foreign threads
+		int thread_index() const noexcept
+		{
+			if (worker_owner() == this)
+			{
+				return worker_index();
+			}
+			return std::this_thread::get_id() == m_main_thread ? 0 : -1;
+		}
+		static int & worker_index() noexcept
+		{
+			static thread_local int index = -1;
+			return index;
+		}
+		static job_system const*& worker_owner() noexcept
+		{
+			static thread_local job_system const* owner = nullptr;
+			return owner;
+		}
+
+	private:
+		std::vector<std::unique_ptr<work_deque>> m_queues; // zero is main thread
+		std::vector<std::thread> m_threads;
+		std::atomic<bool> m_stop;
+
+		std::mutex m_injection_mutex;
+		std::deque<job*> m_injection;
+
+		std::mutex m_main_mutex;
+		std::deque<job*> m_main;
+		std::thread::id m_main_thread;
+
+		std::mutex m_sleep_mutex;
+		std::condition_variable m_wake;
+		std::atomic<int> m_sleeping;
+	};
+}
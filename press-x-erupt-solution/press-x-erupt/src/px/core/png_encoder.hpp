@@ -0,0 +1,161 @@
+#pragma once
+
+// png encoding of 8 bit four channel pixels, as frames read back from device are written
+// alpha is dropped, frames are opaque and alpha of render target holds no meaning
+// deflate stream consists of stored blocks, so encoding costs a copy and checksums and no compression time
+// output is about size of rgb pixels, every row gets filter byte and every 64 kb block five bytes
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	namespace png
+	{
+		inline uint32_t crc(uint32_t crc, uint8_t const* data, size_t size) noexcept
+		{
+			struct table_data
+			{
+				uint32_t entries[256];
+				table_data() noexcept
+				{
+					for (uint32_t i = 0; i != 256; ++i)
+					{
+						uint32_t value = i;
+						for (int bit = 0; bit != 8; ++bit)
+						{
+							value = (value & 1) != 0 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+						}
+						entries[i] = value;
+					}
+				}
+			};
+			static const table_data table;
+
+			crc = ~crc;
+			for (size_t i = 0; i != size; ++i)
+			{
+				crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+			}
+			return ~crc;
+		}
+		// running sums of zlib stream
+		struct adler
+		{
+			uint32_t a = 1;
+			uint32_t b = 0;
+
+			void update(uint8_t const* data, size_t size) noexcept
+			{
+				// 5552 bytes is the longest run sums can not overflow in
+				while (size != 0)
+				{
+					size_t run = size < 5552 ? size : 5552;
+					size -= run;
+					for (size_t i = 0; i != run; ++i)
+					{
+						a += data[i];
+						b += a;
+					}
+					data += run;
+					a %= 65521;
+					b %= 65521;
+				}
+			}
+			uint32_t value() const noexcept
+			{
+				return b << 16 | a;
+			}
+		};
+
+		inline void put32(std::vector<uint8_t> & output, uint32_t value)
+		{
+			output.push_back(static_cast<uint8_t>(value >> 24));
+			output.push_back(static_cast<uint8_t>(value >> 16));
+			output.push_back(static_cast<uint8_t>(value >> 8));
+			output.push_back(static_cast<uint8_t>(value));
+		}
+		inline void chunk(std::vector<uint8_t> & output, const char * type, uint8_t const* data, size_t size)
+		{
+			put32(output, static_cast<uint32_t>(size));
+			size_t start = output.size();
+			output.insert(output.end(), type, type + 4);
+			output.insert(output.end(), data, data + size);
+			put32(output, crc(0, output.data() + start, size + 4));
+		}
+
+		// pixels are rows of stride bytes, four per pixel in rgba order or bgra if bgra is set
+		inline std::vector<uint8_t> encode(uint8_t const* pixels, uint32_t width, uint32_t height, size_t stride, bool bgra)
+		{
+			static const size_t block = 65535; // largest stored block
+
+			// filtered rows, filter type none
+			size_t row = size_t{ width } * 3 + 1;
+			std::vector<uint8_t> raw(row * height);
+			int red = bgra ? 2 : 0;
+			int blue = bgra ? 0 : 2;
+			for (uint32_t y = 0; y != height; ++y)
+			{
+				uint8_t const* source = pixels + y * stride;
+				uint8_t * target = raw.data() + y * row;
+				*target++ = 0;
+				for (uint32_t x = 0; x != width; ++x, source += 4, target += 3)
+				{
+					target[0] = source[red];
+					target[1] = source[1];
+					target[2] = source[blue];
+				}
+			}
+
+			std::vector<uint8_t> stream;
+			stream.reserve(raw.size() + (raw.size() / block + 1) * 5 + 6);
+			stream.push_back(0x78); // deflate, 32 kb window
+			stream.push_back(0x01); // no preset dictionary, fastest level, check bits
+			size_t offset = 0;
+			do
+			{
+				size_t size = std::min(block, raw.size() - offset);
+				bool last = offset + size == raw.size();
+				stream.push_back(last ? 1 : 0);
+				stream.push_back(static_cast<uint8_t>(size));
+				stream.push_back(static_cast<uint8_t>(size >> 8));
+				stream.push_back(static_cast<uint8_t>(~size));
+				stream.push_back(static_cast<uint8_t>(~size >> 8));
+				stream.insert(stream.end(), raw.begin() + offset, raw.begin() + offset + size);
+				offset += size;
+			} while (offset != raw.size());
+			adler checksum;
+			checksum.update(raw.data(), raw.size());
+			put32(stream, checksum.value());
+
+			std::vector<uint8_t> header;
+			put32(header, width);
+			put32(header, height);
+			header.push_back(8); // bit depth
+			header.push_back(2); // truecolor
+			header.push_back(0); // deflate
+			header.push_back(0); // adaptive filtering
+			header.push_back(0); // no interlace
+
+			static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+			std::vector<uint8_t> output(std::begin(signature), std::end(signature));
+			output.reserve(stream.size() + 64);
+			chunk(output, "IHDR", header.data(), header.size());
+			chunk(output, "IDAT", stream.data(), stream.size());
+			chunk(output, "IEND", nullptr, 0);
+			return output;
+		}
+		inline bool save(std::string const& path, uint8_t const* pixels, uint32_t width, uint32_t height, size_t stride, bool bgra)
+		{
+			std::vector<uint8_t> data = encode(pixels, width, height, stride, bgra);
+			std::ofstream file(path, std::ios::binary);
+			file.write(reinterpret_cast<char const*>(data.data()), data.size());
+			return static_cast<bool>(file);
+		}
+	}
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+// cpu zones per thread and gpu zones of renderer, exported as chrome trace json (chrome://tracing, perfetto)
+// every thread writes only its own event buffer and publishes count with release store, so recording takes no lock
+// buffer is registered on first event of thread, buffers live as long as profiler, so events of finished threads are exported too
+// disabled capture costs relaxed atomic load per zone, PX_PROFILE 0 compiles zones out entirely
+// zone names have to outlive capture, string literals and __FUNCTION__ do
+// gpu zones are placed on cpu timeline by offset estimated from submissions, gpu can not start work before it was submitted
+
+#ifndef PX_PROFILE
+#define PX_PROFILE 1
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class profiler final
+	{
+	public:
+		typedef std::chrono::steady_clock clock;
+
+	public:
+		static profiler & global()
+		{
+			static profiler instance;
+			return instance;
+		}
+		// nanoseconds since profiler creation
+		uint64_t now() const noexcept
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_epoch).count());
+		}
+		bool enabled() const noexcept
+		{
+			return m_enabled.load(std::memory_order_relaxed);
+		}
+
+		// new capture, events of previous one are dropped by each thread on its next event
+		// waits for write in progress, it reads buffers the new capture resets
+		void start()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_generation.fetch_add(1, std::memory_order_release); // thread seeing it resets buffer after write is done with it
+			m_enabled.store(true, std::memory_order_release);
+		}
+		void stop() noexcept
+		{
+			m_enabled.store(false, std::memory_order_release);
+		}
+
+		// zone of calling thread, dropped if capture stopped meanwhile
+		void record(const char * name, uint64_t begin, uint64_t end)
+		{
+			if (!enabled())
+			{
+				return;
+			}
+			thread_buffer * buffer = local();
+			buffer->push({ name, begin, end });
+		}
+		// zone of gpu timeline in nanoseconds of device clock, from one thread at a time
+		// submitted is profiler time of submission containing the zone
+		void gpu(const char * name, uint64_t submitted, uint64_t begin, uint64_t end)
+		{
+			if (!enabled())
+			{
+				return;
+			}
+			// tightest lower bound of offset seen in this capture
+			int64_t offset = static_cast<int64_t>(submitted) - static_cast<int64_t>(begin);
+			uint32_t generation = m_generation.load(std::memory_order_relaxed);
+			if (m_calibrated != generation || offset > m_gpu_offset)
+			{
+				m_gpu_offset = offset;
+				m_calibrated = generation;
+			}
+			m_gpu.push({ name, static_cast<uint64_t>(static_cast<int64_t>(begin) + m_gpu_offset), static_cast<uint64_t>(static_cast<int64_t>(end) + m_gpu_offset) });
+		}
+		// shown as track name, call on the named thread
+		void thread_name(std::string name)
+		{
+			thread_buffer * buffer = local();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			buffer->name = std::move(name);
+		}
+
+		// chrome trace event format, call after stop
+		void write(std::ostream & stream) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			uint32_t generation = m_generation.load(std::memory_order_relaxed);
+			stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			bool first = true;
+			auto track = [&](thread_buffer const& buffer, uint32_t id) {
+				if (buffer.generation.load(std::memory_order_acquire) != generation)
+				{
+					return;
+				}
+				size_t count = buffer.count.load(std::memory_order_acquire);
+				stream << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << id << ",\"args\":{\"name\":";
+				quote(stream, buffer.name.c_str());
+				stream << "}}";
+				first = false;
+				for (size_t i = 0; i != count; ++i)
+				{
+					event const& current = buffer.events[i];
+					stream << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << id << ",\"ts\":" << current.begin / 1000 << "." << digits(current.begin % 1000)
+						<< ",\"dur\":" << (current.end - current.begin) / 1000 << "." << digits((current.end - current.begin) % 1000) << ",\"name\":";
+					quote(stream, current.name);
+					stream << "}";
+				}
+				if (buffer.dropped.load(std::memory_order_relaxed) != 0)
+				{
+					stream << ",\n{\"name\":\"dropped\",\"ph\":\"M\",\"pid\":1,\"tid\":" << id << ",\"args\":{\"events\":" << buffer.dropped.load(std::memory_order_relaxed) << "}}";
+				}
+			};
+			for (size_t i = 0; i != m_buffers.size(); ++i)
+			{
+				track(*m_buffers[i], static_cast<uint32_t>(i + 1));
+			}
+			track(m_gpu, 0);
+			stream << "\n]}\n";
+		}
+		bool save(std::string const& path) const
+		{
+			std::ofstream file(path, std::ios::binary);
+			write(file);
+			return static_cast<bool>(file);
+		}
+
+	public:
+		profiler(profiler const&) = delete;
+		profiler& operator=(profiler const&) = delete;
+
+	private:
+		struct event
+		{
+			const char * name;
+			uint64_t begin; // nanoseconds
+			uint64_t end;
+		};
+		// single writer, readers see events below published count
+		struct thread_buffer
+		{
+			std::unique_ptr<event[]> events;
+			std::atomic<size_t> count;
+			std::atomic<size_t> dropped;
+			std::atomic<uint32_t> generation; // capture events belong to
+			std::string name;
+			profiler * owner;
+
+			void push(event const& item)
+			{
+				uint32_t current = owner->m_generation.load(std::memory_order_acquire);
+				size_t index = count.load(std::memory_order_relaxed);
+				if (generation.load(std::memory_order_relaxed) != current)
+				{
+					index = 0;
+					count.store(0, std::memory_order_relaxed);
+					dropped.store(0, std::memory_order_relaxed);
+					generation.store(current, std::memory_order_release);
+				}
+				if (index == capacity)
+				{
+					dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				if (!events)
+				{
+					events.reset(new event[capacity]);
+				}
+				events[index] = item;
+				count.store(index + 1, std::memory_order_release);
+			}
+		};
+
+	private:
+		static const size_t capacity = 1 << 16; // events per thread and capture
+
+	private:
+		profiler()
+			: m_epoch(clock::now())
+			, m_enabled(false)
+			, m_generation(0)
+			, m_gpu_offset(0)
+			, m_calibrated(0)
+		{
+			init(m_gpu, "gpu");
+		}
+
+		void init(thread_buffer & buffer, std::string name)
+		{
+			buffer.count = 0;
+			buffer.dropped = 0;
+			buffer.generation = 0;
+			buffer.name = std::move(name);
+			buffer.owner = this;
+		}
+		thread_buffer * local()
+		{
+			static thread_local thread_buffer * buffer = nullptr;
+			if (buffer == nullptr)
+			{
+				std::unique_ptr<thread_buffer> created(new thread_buffer);
+				std::lock_guard<std::mutex> lock(m_mutex);
+				init(*created, "thread " + std::to_string(m_buffers.size() + 1));
+				m_buffers.push_back(std::move(created));
+				buffer = m_buffers.back().get();
+			}
+			return buffer;
+		}
+
+		static void quote(std::ostream & stream, const char * text)
+		{
+			stream << '"';
+			for (; *text != 0; ++text)
+			{
+				if (*text == '"' || *text == '\\')
+				{
+					stream << '\\';
+				}
+				stream << *text;
+			}
+			stream << '"';
+		}
+		// fraction of microsecond with leading zeroes
+		static std::string digits(uint64_t nanoseconds)
+		{
+			std::string result = std::to_string(nanoseconds);
+			return std::string(3 - result.size(), '0') + result;
+		}
+
+	private:
+		clock::time_point m_epoch;
+		std::atomic<bool> m_enabled;
+		std::atomic<uint32_t> m_generation;
+
+		mutable std::mutex m_mutex; // registration and export
+		std::vector<std::unique_ptr<thread_buffer>> m_buffers;
+
+		thread_buffer m_gpu;
+		int64_t m_gpu_offset; // added to gpu nanoseconds, written by gpu() only
+		uint32_t m_calibrated; // capture offset belongs to
+	};
+
+	// records zone from construction to destruction if capture was running when it began
+	class profile_zone final
+	{
+	public:
+		explicit profile_zone(const char * name)
+			: m_name(profiler::global().enabled() ? name : nullptr)
+			, m_begin(m_name != nullptr ? profiler::global().now() : 0)
+		{
+		}
+		profile_zone(profile_zone const&) = delete;
+		profile_zone& operator=(profile_zone const&) = delete;
+		~profile_zone()
+		{
+			if (m_name != nullptr)
+			{
+				profiler & instance = profiler::global();
+				instance.record(m_name, m_begin, instance.now());
+			}
+		}
+
+	private:
+		const char * m_name; // null if not recorded
+		uint64_t m_begin;
+	};
+}
+
+#define PX_PROFILE_JOIN_IMPL(a, b) a##b
+#define PX_PROFILE_JOIN(a, b) PX_PROFILE_JOIN_IMPL(a, b)
+#if PX_PROFILE
+#define PX_PROFILE_ZONE(name) ::px::profile_zone PX_PROFILE_JOIN(px_profile_zone_, __LINE__)(name)
+#define PX_PROFILE_FUNCTION() PX_PROFILE_ZONE(__FUNCTION__)
+#define PX_PROFILE_THREAD(name) ::px::profiler::global().thread_name(name)
+#else
+#define PX_PROFILE_ZONE(name) ((void)0)
+#define PX_PROFILE_FUNCTION() ((void)0)
+#define PX_PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+// render scale controller holding measured frame time at budget
+// cost is assumed proportional to pixel count, so scale moves with square root of budget ratio
+// measurements are smoothed and several frames are skipped after each change while new resolution reaches timings
+// small corrections are ignored, so resolution does not flicker around the budget
+
+#include <algorithm>
+#include <cmath>
+
+namespace px
+{
+	class resolution_scaler final
+	{
+	public:
+		// milliseconds per frame, zero disables scaling
+		void budget(double milliseconds) noexcept
+		{
+			m_budget = milliseconds;
+			if (m_budget <= 0)
+			{
+				m_scale = m_maximum;
+			}
+		}
+		double budget() const noexcept
+		{
+			return m_budget;
+		}
+		void range(double minimum, double maximum) noexcept
+		{
+			m_minimum = std::max(0.1, std::min(minimum, maximum));
+			m_maximum = std::min(1.0, std::max(minimum, maximum));
+			m_scale = std::max(m_minimum, std::min(m_scale, m_maximum));
+		}
+		double scale() const noexcept
+		{
+			return m_scale;
+		}
+		// smoothed measurement in milliseconds
+		double time() const noexcept
+		{
+			return m_time;
+		}
+
+		// feeds one measured frame, returns scale for next frame
+		double update(double milliseconds) noexcept
+		{
+			m_time = m_time == 0 ? milliseconds : m_time * (1.0 - smoothing) + milliseconds * smoothing;
+			if (m_budget <= 0 || ++m_frames < settle_frames)
+			{
+				return m_scale;
+			}
+
+			// grow only with clear headroom, shrink as soon as budget is exceeded
+			if (m_time > m_budget || m_time < m_budget * headroom)
+			{
+				double target = m_scale * std::sqrt(m_budget * (m_time > m_budget ? 1.0 : headroom) / m_time);
+				double next = std::max(m_minimum, std::min(m_scale + (target - m_scale) * 0.5, m_maximum));
+				if (std::abs(next - m_scale) >= threshold)
+				{
+					m_scale = next;
+					m_frames = 0;
+				}
+			}
+			return m_scale;
+		}
+
+	public:
+		resolution_scaler() noexcept
+			: m_budget(0)
+			, m_minimum(0.5)
+			, m_maximum(1.0)
+			, m_scale(1.0)
+			, m_time(0)
+			, m_frames(0)
+		{
+		}
+
+	private:
+		static constexpr double smoothing = 0.1;
+		static constexpr double headroom = 0.85;
+		static constexpr double threshold = 0.02;
+		static const unsigned int settle_frames = 8;
+
+	private:
+		double m_budget; // milliseconds
+		double m_minimum;
+		double m_maximum;
+		double m_scale; // fraction of full resolution per axis
+		double m_time; // milliseconds
+		unsigned int m_frames; // since last change
+	};
+}
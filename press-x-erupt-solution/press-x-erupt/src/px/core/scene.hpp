@@ -0,0 +1,279 @@
+#pragma once
+
+// renderable objects as structure of arrays, every component in its own dense array
+// handles stay valid while objects are destroyed around them, slot table maps handle to dense index and back
+// destruction moves last object into the hole, so bulk passes run over contiguous arrays without gaps
+// visibility is answered by spatial grid keyed by slot, gather writes visible objects directly into instance memory
+
+#include "job_system.hpp"
+#include "simd_kernels.hpp"
+#include "spatial_grid.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	class scene final
+	{
+	public:
+		struct handle
+		{
+			uint32_t slot;
+			uint32_t generation;
+
+			bool operator==(handle const& other) const noexcept
+			{
+				return slot == other.slot && generation == other.generation;
+			}
+			bool operator!=(handle const& other) const noexcept
+			{
+				return !operator==(other);
+			}
+		};
+		// per instance vertex data of sprite pipeline
+		struct instance
+		{
+			float position[2]; // center
+			float extent[2]; // half size
+			uint32_t color; // rgba8
+			uint32_t texture;
+		};
+		// consecutive gathered instances sharing texture
+		struct batch
+		{
+			uint32_t texture;
+			uint32_t first;
+			uint32_t count;
+		};
+
+	public:
+		size_t size() const noexcept
+		{
+			return m_slot.size();
+		}
+		bool alive(handle object) const noexcept
+		{
+			return object.slot < m_slots.size() && m_slots[object.slot].generation == object.generation && m_slots[object.slot].dense != none;
+		}
+
+		handle create(float x, float y, float half_width, float half_height, uint32_t color, uint32_t texture)
+		{
+			uint32_t slot;
+			if (m_free.empty())
+			{
+				slot = static_cast<uint32_t>(m_slots.size());
+				m_slots.push_back(slot_data{ none, 0 });
+			}
+			else
+			{
+				slot = m_free.back();
+				m_free.pop_back();
+			}
+			m_slots[slot].dense = static_cast<uint32_t>(m_slot.size());
+
+			m_x.push_back(x);
+			m_y.push_back(y);
+			m_half_width.push_back(half_width);
+			m_half_height.push_back(half_height);
+			m_velocity_x.push_back(0);
+			m_velocity_y.push_back(0);
+			m_color.push_back(color);
+			m_texture.push_back(texture);
+			m_slot.push_back(slot);
+
+			m_grid.insert(slot, box(m_slots[slot].dense));
+			return{ slot, m_slots[slot].generation };
+		}
+		void destroy(handle object)
+		{
+			if (!alive(object))
+			{
+				return;
+			}
+			uint32_t dense = m_slots[object.slot].dense;
+			uint32_t last = static_cast<uint32_t>(m_slot.size() - 1);
+			m_grid.erase(object.slot);
+
+			m_x[dense] = m_x[last];
+			m_y[dense] = m_y[last];
+			m_half_width[dense] = m_half_width[last];
+			m_half_height[dense] = m_half_height[last];
+			m_velocity_x[dense] = m_velocity_x[last];
+			m_velocity_y[dense] = m_velocity_y[last];
+			m_color[dense] = m_color[last];
+			m_texture[dense] = m_texture[last];
+			m_slot[dense] = m_slot[last];
+			m_slots[m_slot[dense]].dense = dense;
+
+			m_x.pop_back();
+			m_y.pop_back();
+			m_half_width.pop_back();
+			m_half_height.pop_back();
+			m_velocity_x.pop_back();
+			m_velocity_y.pop_back();
+			m_color.pop_back();
+			m_texture.pop_back();
+			m_slot.pop_back();
+
+			m_slots[object.slot].dense = none;
+			++m_slots[object.slot].generation; // stale handles stop matching
+			m_free.push_back(object.slot);
+		}
+
+		void position(handle object, float x, float y)
+		{
+			uint32_t dense = index(object);
+			m_x[dense] = x;
+			m_y[dense] = y;
+			m_grid.move(object.slot, box(dense));
+		}
+		void extent(handle object, float half_width, float half_height)
+		{
+			uint32_t dense = index(object);
+			m_half_width[dense] = half_width;
+			m_half_height[dense] = half_height;
+			m_grid.move(object.slot, box(dense));
+		}
+		void velocity(handle object, float x, float y)
+		{
+			uint32_t dense = index(object);
+			m_velocity_x[dense] = x;
+			m_velocity_y[dense] = y;
+		}
+		void color(handle object, uint32_t rgba)
+		{
+			m_color[index(object)] = rgba;
+		}
+		void texture(handle object, uint32_t texture)
+		{
+			m_texture[index(object)] = texture;
+		}
+
+		// dense component arrays, valid until next create or destroy
+		float const* x() const noexcept
+		{
+			return m_x.data();
+		}
+		float const* y() const noexcept
+		{
+			return m_y.data();
+		}
+		uint32_t const* colors() const noexcept
+		{
+			return m_color.data();
+		}
+		uint32_t const* textures() const noexcept
+		{
+			return m_texture.data();
+		}
+
+		// moves objects by their velocity, positions in parallel blocks, grid afterwards for moving objects only
+		void integrate(float delta, job_system & jobs)
+		{
+			uint32_t count = static_cast<uint32_t>(m_slot.size());
+			simd_kernels const& kernels = simd_dispatch();
+			jobs.parallel_for<uint32_t>(0, count, integrate_grain, [this, delta, &kernels](uint32_t first, uint32_t last) {
+				kernels.advance(last - first, m_x.data() + first, m_y.data() + first, m_velocity_x.data() + first, m_velocity_y.data() + first, delta);
+			});
+			for (uint32_t i = 0; i != count; ++i)
+			{
+				if (m_velocity_x[i] != 0 || m_velocity_y[i] != 0)
+				{
+					m_grid.move(m_slot[i], box(i));
+				}
+			}
+		}
+
+		// writes objects intersecting view into instance memory grouped by texture, returns instances written
+		// output is written sequentially, so it may be write combined mapped memory
+		uint32_t gather(aabb const& view, instance * output, uint32_t capacity, std::vector<batch> & batches)
+		{
+			batches.clear();
+			m_visible.clear();
+			m_grid.query(view, m_visible);
+
+			// texture in high half keeps batches contiguous, dense index in low half keeps array walks forward
+			m_keys.resize(m_visible.size());
+			for (size_t i = 0, size = m_visible.size(); i != size; ++i)
+			{
+				uint32_t dense = m_slots[m_visible[i]].dense;
+				m_keys[i] = (uint64_t{ m_texture[dense] } << 32) | dense;
+			}
+			std::sort(std::begin(m_keys), std::end(m_keys));
+
+			uint32_t written = std::min(capacity, static_cast<uint32_t>(m_keys.size()));
+			for (uint32_t i = 0; i != written; ++i)
+			{
+				uint32_t dense = static_cast<uint32_t>(m_keys[i]);
+				instance & target = output[i];
+				target.position[0] = m_x[dense];
+				target.position[1] = m_y[dense];
+				target.extent[0] = m_half_width[dense];
+				target.extent[1] = m_half_height[dense];
+				target.color = m_color[dense];
+				target.texture = m_texture[dense];
+
+				if (batches.empty() || batches.back().texture != target.texture)
+				{
+					batches.push_back({ target.texture, i, 0 });
+				}
+				++batches.back().count;
+			}
+			return written;
+		}
+
+	public:
+		// bounds and cell size of visibility grid, cells about the size of common objects work best
+		scene(aabb const& bounds, float cell_size)
+			: m_grid(bounds, cell_size)
+		{
+		}
+
+	private:
+		struct slot_data
+		{
+			uint32_t dense; // none if free
+			uint32_t generation;
+		};
+
+	private:
+		enum : uint32_t { none = 0xffffffff };
+		static const uint32_t integrate_grain = 4096;
+
+	private:
+		uint32_t index(handle object) const
+		{
+			if (!alive(object))
+			{
+				throw std::runtime_error("px::scene::index() - stale handle");
+			}
+			return m_slots[object.slot].dense;
+		}
+		aabb box(uint32_t dense) const noexcept
+		{
+			return{ m_x[dense] - m_half_width[dense], m_y[dense] - m_half_height[dense], m_x[dense] + m_half_width[dense], m_y[dense] + m_half_height[dense] };
+		}
+
+	private:
+		// components by dense index
+		std::vector<float> m_x;
+		std::vector<float> m_y;
+		std::vector<float> m_half_width;
+		std::vector<float> m_half_height;
+		std::vector<float> m_velocity_x;
+		std::vector<float> m_velocity_y;
+		std::vector<uint32_t> m_color;
+		std::vector<uint32_t> m_texture;
+		std::vector<uint32_t> m_slot; // owning slot
+
+		std::vector<slot_data> m_slots; // by handle slot
+		std::vector<uint32_t> m_free; // slots
+
+		spatial_grid m_grid; // keyed by slot
+		std::vector<uint32_t> m_visible; // query scratch, slots
+		std::vector<uint64_t> m_keys; // sort scratch
+	};
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// micro-benchmark and self check of simd kernels
+// every level supported by cpu runs the same batches, results are compared to scalar level and timed
+// vector kernels do the same arithmetic in the same order, so any difference is reported as mismatch
+
+#include "simd_kernels.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <vector>
+
+namespace px
+{
+	// returns false if any level differs from scalar
+	inline bool benchmark_simd(std::ostream & stream, size_t elements = (1 << 16) + 3, unsigned int repeats = 64)
+	{
+		typedef std::chrono::high_resolution_clock clock;
+
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> channel(-0.25f, 1.25f); // includes values to clamp
+		std::vector<float> x(elements), y(elements), u(elements), v(elements);
+		for (size_t i = 0; i != elements; ++i)
+		{
+			x[i] = coordinate(random);
+			y[i] = coordinate(random);
+			u[i] = channel(random);
+			v[i] = channel(random);
+		}
+		affine2 matrix{ 0.8f, -0.6f, 10.0f, 0.6f, 0.8f, -5.0f };
+
+		struct result
+		{
+			std::vector<float> out_x, out_y, moved_x, moved_y, corners;
+			std::vector<uint32_t> colors;
+			double times[4];
+		};
+		auto run = [&](simd_kernels const& kernels) {
+			result r;
+			r.out_x.resize(elements);
+			r.out_y.resize(elements);
+			r.corners.resize(elements * 8);
+			r.colors.resize(elements);
+			auto time = [&](auto fn) {
+				auto start = clock::now();
+				for (unsigned int i = 0; i != repeats; ++i)
+				{
+					fn();
+				}
+				return std::chrono::duration<double, std::milli>(clock::now() - start).count() / repeats;
+			};
+			r.times[0] = time([&]() { kernels.transform(elements, x.data(), y.data(), matrix, r.out_x.data(), r.out_y.data()); });
+			r.moved_x = x;
+			r.moved_y = y;
+			r.times[1] = time([&]() { kernels.advance(elements, r.moved_x.data(), r.moved_y.data(), u.data(), v.data(), 0.01f); });
+			r.times[2] = time([&]() { kernels.corners(elements, x.data(), y.data(), u.data(), v.data(), r.corners.data()); });
+			r.times[3] = time([&]() { kernels.pack(elements, u.data(), v.data(), u.data(), v.data(), r.colors.data()); });
+			return r;
+		};
+		auto same = [](auto const& a, auto const& b) {
+			return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0;
+		};
+
+		simd_level supported = detect_simd();
+		stream << "px::benchmark_simd - " << elements << " elements, " << repeats << " repeats, cpu supports " << to_string(supported) << std::endl;
+		stream << "             transform           advance           corners              pack" << std::endl;
+		stream << std::fixed << std::setprecision(3);
+
+		bool valid = true;
+		result reference = run(make_simd_kernels(simd_level::scalar));
+		for (int level = static_cast<int>(simd_level::scalar); level <= static_cast<int>(supported); ++level)
+		{
+			simd_kernels kernels = make_simd_kernels(static_cast<simd_level>(level));
+			result current = level == 0 ? reference : run(kernels);
+			bool match = same(current.out_x, reference.out_x) && same(current.out_y, reference.out_y)
+				&& same(current.moved_x, reference.moved_x) && same(current.moved_y, reference.moved_y)
+				&& same(current.corners, reference.corners) && same(current.colors, reference.colors);
+			valid &= match;
+
+			stream << "  " << std::setw(6) << to_string(kernels.level);
+			for (int k = 0; k != 4; ++k)
+			{
+				stream << std::setw(9) << current.times[k] << "ms" << std::setprecision(1) << std::setw(5) << reference.times[k] / current.times[k] << "x" << std::setprecision(3);
+			}
+			stream << (match ? "" : "  mismatch") << std::endl;
+		}
+		return valid;
+	}
+}
@@ -0,0 +1,342 @@
+#pragma once
+
+// batch kernels over structure of arrays object data: affine transform, integration, quad corners and color packing
+// every kernel has scalar, sse2 and avx2 variant, table of the widest one supported by cpu and os is picked once at startup
+// vector variants are compiled with target attributes, so the rest of the build keeps its baseline instruction set
+// arrays need no alignment, tails shorter than a register are finished by scalar code
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PX_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PX_TARGET_SSE2
+#define PX_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define PX_TARGET_SSE2 __attribute__((target("sse2")))
+#define PX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace px
+{
+	enum class simd_level : int
+	{
+		scalar,
+		sse2,
+		avx2
+	};
+
+	inline const char * to_string(simd_level level) noexcept
+	{
+		switch (level)
+		{
+		case simd_level::sse2: return "sse2";
+		case simd_level::avx2: return "avx2";
+		default: return "scalar";
+		}
+	}
+
+	// row major 2x3 matrix, x' = xx * x + xy * y + tx
+	struct affine2
+	{
+		float xx, xy, tx;
+		float yx, yy, ty;
+	};
+
+	struct simd_kernels
+	{
+		// out may alias input
+		void(*transform)(size_t count, float const* x, float const* y, affine2 const& matrix, float * out_x, float * out_y);
+		// position += velocity * delta, in place
+		void(*advance)(size_t count, float * x, float * y, float const* velocity_x, float const* velocity_y, float delta);
+		// four corners per object as x, y pairs, clockwise from min corner, eight floats per object
+		void(*corners)(size_t count, float const* x, float const* y, float const* half_width, float const* half_height, float * out);
+		// unit range channels to rgba8, red in lowest byte, values are clamped
+		void(*pack)(size_t count, float const* r, float const* g, float const* b, float const* a, uint32_t * out);
+		simd_level level;
+	};
+
+	namespace simd
+	{
+		// scalar reference, also tails of vector variants
+
+		inline void transform_scalar(size_t count, float const* x, float const* y, affine2 const& m, float * out_x, float * out_y)
+		{
+			for (size_t i = 0; i != count; ++i)
+			{
+				float px = x[i], py = y[i];
+				out_x[i] = m.xx * px + m.xy * py + m.tx;
+				out_y[i] = m.yx * px + m.yy * py + m.ty;
+			}
+		}
+		inline void advance_scalar(size_t count, float * x, float * y, float const* velocity_x, float const* velocity_y, float delta)
+		{
+			for (size_t i = 0; i != count; ++i)
+			{
+				x[i] += velocity_x[i] * delta;
+				y[i] += velocity_y[i] * delta;
+			}
+		}
+		inline void corners_scalar(size_t count, float const* x, float const* y, float const* half_width, float const* half_height, float * out)
+		{
+			for (size_t i = 0; i != count; ++i)
+			{
+				float left = x[i] - half_width[i], right = x[i] + half_width[i];
+				float top = y[i] - half_height[i], bottom = y[i] + half_height[i];
+				float * corner = out + i * 8;
+				corner[0] = left; corner[1] = top;
+				corner[2] = right; corner[3] = top;
+				corner[4] = right; corner[5] = bottom;
+				corner[6] = left; corner[7] = bottom;
+			}
+		}
+		inline uint32_t pack_channel(float value) noexcept
+		{
+			return static_cast<uint32_t>(static_cast<int>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f));
+		}
+		inline void pack_scalar(size_t count, float const* r, float const* g, float const* b, float const* a, uint32_t * out)
+		{
+			for (size_t i = 0; i != count; ++i)
+			{
+				out[i] = pack_channel(r[i]) | pack_channel(g[i]) << 8 | pack_channel(b[i]) << 16 | pack_channel(a[i]) << 24;
+			}
+		}
+
+#ifdef PX_SIMD_X86
+		// sse2
+
+		PX_TARGET_SSE2 inline void transform_sse2(size_t count, float const* x, float const* y, affine2 const& m, float * out_x, float * out_y)
+		{
+			__m128 xx = _mm_set1_ps(m.xx), xy = _mm_set1_ps(m.xy), tx = _mm_set1_ps(m.tx);
+			__m128 yx = _mm_set1_ps(m.yx), yy = _mm_set1_ps(m.yy), ty = _mm_set1_ps(m.ty);
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+				_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, px), _mm_mul_ps(xy, py)), tx));
+				_mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(yx, px), _mm_mul_ps(yy, py)), ty));
+			}
+			transform_scalar(count - i, x + i, y + i, m, out_x + i, out_y + i);
+		}
+		PX_TARGET_SSE2 inline void advance_sse2(size_t count, float * x, float * y, float const* velocity_x, float const* velocity_y, float delta)
+		{
+			__m128 d = _mm_set1_ps(delta);
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(velocity_x + i), d)));
+				_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(velocity_y + i), d)));
+			}
+			advance_scalar(count - i, x + i, y + i, velocity_x + i, velocity_y + i, delta);
+		}
+		// four objects from edges in lanes to interleaved corners
+		PX_TARGET_SSE2 inline void store_corners(__m128 left, __m128 top, __m128 right, __m128 bottom, float * out)
+		{
+			__m128 lt_low = _mm_unpacklo_ps(left, top), lt_high = _mm_unpackhi_ps(left, top); // l0 t0 l1 t1, l2 t2 l3 t3
+			__m128 rt_low = _mm_unpacklo_ps(right, top), rt_high = _mm_unpackhi_ps(right, top);
+			__m128 rb_low = _mm_unpacklo_ps(right, bottom), rb_high = _mm_unpackhi_ps(right, bottom);
+			__m128 lb_low = _mm_unpacklo_ps(left, bottom), lb_high = _mm_unpackhi_ps(left, bottom);
+			_mm_storeu_ps(out + 0, _mm_movelh_ps(lt_low, rt_low));
+			_mm_storeu_ps(out + 4, _mm_movelh_ps(rb_low, lb_low));
+			_mm_storeu_ps(out + 8, _mm_movehl_ps(rt_low, lt_low));
+			_mm_storeu_ps(out + 12, _mm_movehl_ps(lb_low, rb_low));
+			_mm_storeu_ps(out + 16, _mm_movelh_ps(lt_high, rt_high));
+			_mm_storeu_ps(out + 20, _mm_movelh_ps(rb_high, lb_high));
+			_mm_storeu_ps(out + 24, _mm_movehl_ps(rt_high, lt_high));
+			_mm_storeu_ps(out + 28, _mm_movehl_ps(lb_high, rb_high));
+		}
+		PX_TARGET_SSE2 inline void corners_sse2(size_t count, float const* x, float const* y, float const* half_width, float const* half_height, float * out)
+		{
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+				__m128 w = _mm_loadu_ps(half_width + i), h = _mm_loadu_ps(half_height + i);
+				store_corners(_mm_sub_ps(px, w), _mm_sub_ps(py, h), _mm_add_ps(px, w), _mm_add_ps(py, h), out + i * 8);
+			}
+			corners_scalar(count - i, x + i, y + i, half_width + i, half_height + i, out + i * 8);
+		}
+		PX_TARGET_SSE2 inline __m128i pack_channel_sse2(__m128 value, __m128 zero, __m128 one, __m128 scale)
+		{
+			return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(value, zero), one), scale), _mm_set1_ps(0.5f)));
+		}
+		PX_TARGET_SSE2 inline void pack_sse2(size_t count, float const* r, float const* g, float const* b, float const* a, uint32_t * out)
+		{
+			__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i packed = pack_channel_sse2(_mm_loadu_ps(r + i), zero, one, scale);
+				packed = _mm_or_si128(packed, _mm_slli_epi32(pack_channel_sse2(_mm_loadu_ps(g + i), zero, one, scale), 8));
+				packed = _mm_or_si128(packed, _mm_slli_epi32(pack_channel_sse2(_mm_loadu_ps(b + i), zero, one, scale), 16));
+				packed = _mm_or_si128(packed, _mm_slli_epi32(pack_channel_sse2(_mm_loadu_ps(a + i), zero, one, scale), 24));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+			}
+			pack_scalar(count - i, r + i, g + i, b + i, a + i, out + i);
+		}
+
+		// avx2, fma is not used so results match scalar and sse2 bit for bit
+
+		PX_TARGET_AVX2 inline void transform_avx2(size_t count, float const* x, float const* y, affine2 const& m, float * out_x, float * out_y)
+		{
+			__m256 xx = _mm256_set1_ps(m.xx), xy = _mm256_set1_ps(m.xy), tx = _mm256_set1_ps(m.tx);
+			__m256 yx = _mm256_set1_ps(m.yx), yy = _mm256_set1_ps(m.yy), ty = _mm256_set1_ps(m.ty);
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+				_mm256_storeu_ps(out_x + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(xx, px), _mm256_mul_ps(xy, py)), tx));
+				_mm256_storeu_ps(out_y + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(yx, px), _mm256_mul_ps(yy, py)), ty));
+			}
+			transform_scalar(count - i, x + i, y + i, m, out_x + i, out_y + i);
+		}
+		PX_TARGET_AVX2 inline void advance_avx2(size_t count, float * x, float * y, float const* velocity_x, float const* velocity_y, float delta)
+		{
+			__m256 d = _mm256_set1_ps(delta);
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				_mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(velocity_x + i), d)));
+				_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(velocity_y + i), d)));
+			}
+			advance_scalar(count - i, x + i, y + i, velocity_x + i, velocity_y + i, delta);
+		}
+		PX_TARGET_AVX2 inline void corners_avx2(size_t count, float const* x, float const* y, float const* half_width, float const* half_height, float * out)
+		{
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+				__m256 w = _mm256_loadu_ps(half_width + i), h = _mm256_loadu_ps(half_height + i);
+				__m256 left = _mm256_sub_ps(px, w), right = _mm256_add_ps(px, w);
+				__m256 top = _mm256_sub_ps(py, h), bottom = _mm256_add_ps(py, h);
+
+				// unpacks work within 128 bit halves, so lanes 0-1 and 4-5 come from low unpacks
+				__m256 lt_low = _mm256_unpacklo_ps(left, top), lt_high = _mm256_unpackhi_ps(left, top);
+				__m256 rt_low = _mm256_unpacklo_ps(right, top), rt_high = _mm256_unpackhi_ps(right, top);
+				__m256 rb_low = _mm256_unpacklo_ps(right, bottom), rb_high = _mm256_unpackhi_ps(right, bottom);
+				__m256 lb_low = _mm256_unpacklo_ps(left, bottom), lb_high = _mm256_unpackhi_ps(left, bottom);
+
+				// per half: object 0 and 1 of low unpacks, 2 and 3 of high ones
+				__m256 first_top = _mm256_shuffle_ps(lt_low, rt_low, _MM_SHUFFLE(1, 0, 1, 0)); // l0 t0 r0 t0 | l4 t4 r4 t4
+				__m256 first_bottom = _mm256_shuffle_ps(rb_low, lb_low, _MM_SHUFFLE(1, 0, 1, 0));
+				__m256 second_top = _mm256_shuffle_ps(lt_low, rt_low, _MM_SHUFFLE(3, 2, 3, 2));
+				__m256 second_bottom = _mm256_shuffle_ps(rb_low, lb_low, _MM_SHUFFLE(3, 2, 3, 2));
+				__m256 third_top = _mm256_shuffle_ps(lt_high, rt_high, _MM_SHUFFLE(1, 0, 1, 0));
+				__m256 third_bottom = _mm256_shuffle_ps(rb_high, lb_high, _MM_SHUFFLE(1, 0, 1, 0));
+				__m256 fourth_top = _mm256_shuffle_ps(lt_high, rt_high, _MM_SHUFFLE(3, 2, 3, 2));
+				__m256 fourth_bottom = _mm256_shuffle_ps(rb_high, lb_high, _MM_SHUFFLE(3, 2, 3, 2));
+
+				float * o = out + i * 8;
+				_mm256_storeu_ps(o + 0, _mm256_permute2f128_ps(first_top, first_bottom, 0x20));
+				_mm256_storeu_ps(o + 8, _mm256_permute2f128_ps(second_top, second_bottom, 0x20));
+				_mm256_storeu_ps(o + 16, _mm256_permute2f128_ps(third_top, third_bottom, 0x20));
+				_mm256_storeu_ps(o + 24, _mm256_permute2f128_ps(fourth_top, fourth_bottom, 0x20));
+				_mm256_storeu_ps(o + 32, _mm256_permute2f128_ps(first_top, first_bottom, 0x31));
+				_mm256_storeu_ps(o + 40, _mm256_permute2f128_ps(second_top, second_bottom, 0x31));
+				_mm256_storeu_ps(o + 48, _mm256_permute2f128_ps(third_top, third_bottom, 0x31));
+				_mm256_storeu_ps(o + 56, _mm256_permute2f128_ps(fourth_top, fourth_bottom, 0x31));
+			}
+			corners_scalar(count - i, x + i, y + i, half_width + i, half_height + i, out + i * 8);
+		}
+		PX_TARGET_AVX2 inline __m256i pack_channel_avx2(__m256 value, __m256 zero, __m256 one, __m256 scale)
+		{
+			return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(value, zero), one), scale), _mm256_set1_ps(0.5f)));
+		}
+		PX_TARGET_AVX2 inline void pack_avx2(size_t count, float const* r, float const* g, float const* b, float const* a, uint32_t * out)
+		{
+			__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(255.0f);
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256i packed = pack_channel_avx2(_mm256_loadu_ps(r + i), zero, one, scale);
+				packed = _mm256_or_si256(packed, _mm256_slli_epi32(pack_channel_avx2(_mm256_loadu_ps(g + i), zero, one, scale), 8));
+				packed = _mm256_or_si256(packed, _mm256_slli_epi32(pack_channel_avx2(_mm256_loadu_ps(b + i), zero, one, scale), 16));
+				packed = _mm256_or_si256(packed, _mm256_slli_epi32(pack_channel_avx2(_mm256_loadu_ps(a + i), zero, one, scale), 24));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+			}
+			pack_scalar(count - i, r + i, g + i, b + i, a + i, out + i);
+		}
+
+		// cpuid leaf 1 for sse2 and os saved ymm state, leaf 7 for avx2
+		inline void cpuid(int leaf, int registers[4]) noexcept
+		{
+#if defined(_MSC_VER)
+			__cpuidex(registers, leaf, 0);
+#else
+			unsigned int a = 0, b = 0, c = 0, d = 0;
+			__cpuid_count(leaf, 0, a, b, c, d);
+			registers[0] = static_cast<int>(a);
+			registers[1] = static_cast<int>(b);
+			registers[2] = static_cast<int>(c);
+			registers[3] = static_cast<int>(d);
+#endif
+		}
+		inline uint64_t enabled_state() noexcept
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			unsigned int low, high;
+			__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+			return (uint64_t{ high } << 32) | low;
+#endif
+		}
+#endif
+	}
+
+	inline simd_level detect_simd() noexcept
+	{
+#ifdef PX_SIMD_X86
+		int registers[4];
+		simd::cpuid(0, registers);
+		int leaves = registers[0];
+		simd::cpuid(1, registers);
+		bool sse2 = (registers[3] & (1 << 26)) != 0;
+		bool osxsave = (registers[2] & (1 << 27)) != 0;
+		bool avx = (registers[2] & (1 << 28)) != 0;
+		if (!sse2)
+		{
+			return simd_level::scalar;
+		}
+		if (leaves >= 7 && osxsave && avx && (simd::enabled_state() & 0x6) == 0x6) // xmm and ymm saved on context switch
+		{
+			simd::cpuid(7, registers);
+			if ((registers[1] & (1 << 5)) != 0)
+			{
+				return simd_level::avx2;
+			}
+		}
+		return simd_level::sse2;
+#else
+		return simd_level::scalar;
+#endif
+	}
+
+	// kernels of level, clamped to what cpu supports
+	inline simd_kernels make_simd_kernels(simd_level level) noexcept
+	{
+		level = static_cast<simd_level>(std::min(static_cast<int>(level), static_cast<int>(detect_simd())));
+		switch (level)
+		{
+#ifdef PX_SIMD_X86
+		case simd_level::avx2: return{ simd::transform_avx2, simd::advance_avx2, simd::corners_avx2, simd::pack_avx2, level };
+		case simd_level::sse2: return{ simd::transform_sse2, simd::advance_sse2, simd::corners_sse2, simd::pack_sse2, level };
+#endif
+		default: return{ simd::transform_scalar, simd::advance_scalar, simd::corners_scalar, simd::pack_scalar, simd_level::scalar };
+		}
+	}
+
+	// widest kernels supported, detected on first call
+	inline simd_kernels const& simd_dispatch() noexcept
+	{
+		static const simd_kernels kernels = make_simd_kernels(simd_level::avx2);
+		return kernels;
+	}
+}
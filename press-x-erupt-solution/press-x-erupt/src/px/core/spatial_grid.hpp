@@ -0,0 +1,276 @@
+#pragma once
+
+// loose uniform grid of 2d boxes for visibility queries
+// object lives in the single cell containing its center, query widens view by one cell size to reach overlapping neighbours
+// objects over two cells wide are kept in separate list tested on every query, so widening stays bounded
+// move within the same cell only rewrites the box, crossing cells is a swap removal and an append
+// cells keep boxes as separate coordinate arrays, query tests four boxes per sse compare
+// query cost follows cells covering the view and objects in them, not total object count
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PX_SPATIAL_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace px
+{
+	struct aabb
+	{
+		float min_x;
+		float min_y;
+		float max_x;
+		float max_y;
+
+		bool intersects(aabb const& other) const noexcept
+		{
+			return min_x <= other.max_x && max_x >= other.min_x && min_y <= other.max_y && max_y >= other.min_y;
+		}
+	};
+
+	class spatial_grid final
+	{
+	public:
+		// objects by identifier
+		size_t size() const noexcept
+		{
+			return m_size;
+		}
+		bool contains(uint32_t id) const noexcept
+		{
+			return id < m_records.size() && m_records[id].cell != none;
+		}
+		aabb const& bounds() const noexcept
+		{
+			return m_bounds;
+		}
+		float cell_size() const noexcept
+		{
+			return m_cell;
+		}
+
+		// identifier is chosen by caller, like index of object in its own storage, and must not be present
+		void insert(uint32_t id, aabb const& box)
+		{
+			if (contains(id))
+			{
+				throw std::runtime_error("px::spatial_grid::insert() - identifier already present");
+			}
+			if (id >= m_records.size())
+			{
+				m_records.resize(id + 1, record{ none, 0 });
+			}
+			append(id, cell_of(box), box);
+			++m_size;
+		}
+		void erase(uint32_t id)
+		{
+			if (!contains(id))
+			{
+				return;
+			}
+			remove(id);
+			m_records[id].cell = none;
+			--m_size;
+		}
+		// incremental update of moved or resized object
+		void move(uint32_t id, aabb const& box)
+		{
+			if (!contains(id))
+			{
+				throw std::runtime_error("px::spatial_grid::move() - identifier not present");
+			}
+			record const& current = m_records[id];
+			uint32_t target = cell_of(box);
+			if (target == current.cell)
+			{
+				m_cells[target].assign(current.index, box);
+			}
+			else
+			{
+				remove(id);
+				append(id, target, box);
+			}
+		}
+		void clear() noexcept
+		{
+			for (auto & current : m_cells)
+			{
+				current.clear();
+			}
+			m_records.clear();
+			m_size = 0;
+		}
+
+		// appends identifiers of objects intersecting view
+		void query(aabb const& view, std::vector<uint32_t> & visible) const
+		{
+			// objects reach at most one cell out of their center cell
+			uint32_t x0 = column(view.min_x - m_cell);
+			uint32_t y0 = row(view.min_y - m_cell);
+			uint32_t x1 = column(view.max_x + m_cell);
+			uint32_t y1 = row(view.max_y + m_cell);
+			for (uint32_t y = y0; y <= y1; ++y)
+			{
+				for (uint32_t x = x0; x <= x1; ++x)
+				{
+					m_cells[y * m_columns + x].query(view, visible);
+				}
+			}
+			m_cells.back().query(view, visible);
+		}
+
+	public:
+		// bounds cover usual extent of the world, objects outside are clamped into border cells and still found
+		spatial_grid(aabb const& bounds, float cell_size)
+			: m_bounds(bounds)
+			, m_cell(cell_size)
+			, m_size(0)
+		{
+			if (cell_size <= 0 || bounds.max_x <= bounds.min_x || bounds.max_y <= bounds.min_y)
+			{
+				throw std::runtime_error("px::spatial_grid::spatial_grid() - invalid bounds or cell size");
+			}
+			m_columns = std::max(1u, static_cast<uint32_t>(std::ceil((bounds.max_x - bounds.min_x) / cell_size)));
+			m_rows = std::max(1u, static_cast<uint32_t>(std::ceil((bounds.max_y - bounds.min_y) / cell_size)));
+			m_cells.resize(size_t{ m_columns } * m_rows + 1); // last one holds wide objects
+		}
+
+	private:
+		// boxes stored by coordinate, swap removal keeps arrays dense
+		struct cell
+		{
+			std::vector<float> min_x;
+			std::vector<float> min_y;
+			std::vector<float> max_x;
+			std::vector<float> max_y;
+			std::vector<uint32_t> ids;
+
+			void push(uint32_t id, aabb const& box)
+			{
+				min_x.push_back(box.min_x);
+				min_y.push_back(box.min_y);
+				max_x.push_back(box.max_x);
+				max_y.push_back(box.max_y);
+				ids.push_back(id);
+			}
+			void assign(uint32_t index, aabb const& box) noexcept
+			{
+				min_x[index] = box.min_x;
+				min_y[index] = box.min_y;
+				max_x[index] = box.max_x;
+				max_y[index] = box.max_y;
+			}
+			// returns identifier moved into removed place
+			uint32_t remove(uint32_t index) noexcept
+			{
+				size_t last = ids.size() - 1;
+				min_x[index] = min_x[last];
+				min_y[index] = min_y[last];
+				max_x[index] = max_x[last];
+				max_y[index] = max_y[last];
+				ids[index] = ids[last];
+				min_x.pop_back();
+				min_y.pop_back();
+				max_x.pop_back();
+				max_y.pop_back();
+				ids.pop_back();
+				return index == last ? none : ids[index];
+			}
+			void clear() noexcept
+			{
+				min_x.clear();
+				min_y.clear();
+				max_x.clear();
+				max_y.clear();
+				ids.clear();
+			}
+			void query(aabb const& view, std::vector<uint32_t> & visible) const
+			{
+				size_t count = ids.size();
+				size_t i = 0;
+#ifdef PX_SPATIAL_SSE
+				__m128 view_min_x = _mm_set1_ps(view.min_x);
+				__m128 view_min_y = _mm_set1_ps(view.min_y);
+				__m128 view_max_x = _mm_set1_ps(view.max_x);
+				__m128 view_max_y = _mm_set1_ps(view.max_y);
+				for (; i + 4 <= count; i += 4)
+				{
+					__m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&min_x[i]), view_max_x), _mm_cmpge_ps(_mm_loadu_ps(&max_x[i]), view_min_x));
+					__m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&min_y[i]), view_max_y), _mm_cmpge_ps(_mm_loadu_ps(&max_y[i]), view_min_y));
+					int mask = _mm_movemask_ps(_mm_and_ps(x, y));
+					for (; mask != 0; mask &= mask - 1)
+					{
+						int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+						visible.push_back(ids[i + lane]);
+					}
+				}
+#endif
+				for (; i != count; ++i)
+				{
+					if (min_x[i] <= view.max_x && max_x[i] >= view.min_x && min_y[i] <= view.max_y && max_y[i] >= view.min_y)
+					{
+						visible.push_back(ids[i]);
+					}
+				}
+			}
+		};
+		struct record
+		{
+			uint32_t cell; // none if absent
+			uint32_t index; // within cell arrays
+		};
+
+	private:
+		enum : uint32_t { none = 0xffffffff }; // absent object or no moved object
+
+	private:
+		uint32_t column(float x) const noexcept
+		{
+			float offset = std::floor((x - m_bounds.min_x) / m_cell);
+			return static_cast<uint32_t>(std::min(std::max(offset, 0.0f), static_cast<float>(m_columns - 1)));
+		}
+		uint32_t row(float y) const noexcept
+		{
+			float offset = std::floor((y - m_bounds.min_y) / m_cell);
+			return static_cast<uint32_t>(std::min(std::max(offset, 0.0f), static_cast<float>(m_rows - 1)));
+		}
+		uint32_t cell_of(aabb const& box) const noexcept
+		{
+			if (box.max_x - box.min_x > m_cell * 2 || box.max_y - box.min_y > m_cell * 2)
+			{
+				return static_cast<uint32_t>(m_cells.size() - 1);
+			}
+			return row((box.min_y + box.max_y) * 0.5f) * m_columns + column((box.min_x + box.max_x) * 0.5f);
+		}
+		void append(uint32_t id, uint32_t target, aabb const& box)
+		{
+			cell & destination = m_cells[target];
+			m_records[id] = record{ target, static_cast<uint32_t>(destination.ids.size()) };
+			destination.push(id, box);
+		}
+		void remove(uint32_t id) noexcept
+		{
+			record const& current = m_records[id];
+			uint32_t moved = m_cells[current.cell].remove(current.index);
+			if (moved != none)
+			{
+				m_records[moved].index = current.index;
+			}
+		}
+
+	private:
+		aabb m_bounds;
+		float m_cell;
+		uint32_t m_columns;
+		uint32_t m_rows;
+		std::vector<cell> m_cells; // row major, then wide objects
+		std::vector<record> m_records; // by identifier
+		size_t m_size;
+	};
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+// graph of named steps with dependencies
+// independent steps run concurrently as jobs, calling thread participates
+// start and finish of each step are recorded relative to start of run
+// first exception cancels steps not started yet and is rethrown from run()
+
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class task_graph final
+	{
+	public:
+		typedef size_t task_id;
+		struct timing
+		{
+			std::string name;
+			double start; // milliseconds since run started
+			double finish;
+		};
+
+	public:
+		task_id add(std::string name, std::function<void()> fn, std::vector<task_id> dependencies = {})
+		{
+			task_id id = m_tasks.size();
+			m_tasks.push_back({ name, fn, dependencies, {}, 0, 0.0, 0.0 });
+			for (task_id dependency : dependencies)
+			{
+				m_tasks[dependency].dependents.push_back(id);
+			}
+			return id;
+		}
+		void run(job_system & jobs)
+		{
+			m_error = nullptr;
+			for (auto & current : m_tasks)
+			{
+				current.remaining = current.dependencies.size();
+				current.start = 0.0;
+				current.finish = 0.0;
+			}
+
+			m_start = clock::now();
+
+			job_counter counter;
+			for (task_id i = 0, size = m_tasks.size(); i != size; ++i)
+			{
+				if (m_tasks[i].remaining == 0)
+				{
+					schedule(jobs, counter, i);
+				}
+			}
+			jobs.wait(counter);
+
+			m_duration = milliseconds(clock::now());
+
+			if (m_error)
+			{
+				std::rethrow_exception(m_error);
+			}
+		}
+		std::vector<timing> timings() const
+		{
+			std::vector<timing> result;
+			for (auto const& current : m_tasks)
+			{
+				result.push_back({ current.name, current.start, current.finish });
+			}
+			std::sort(std::begin(result), std::end(result), [](timing const& a, timing const& b) { return a.start < b.start; });
+			return result;
+		}
+		double duration() const noexcept
+		{
+			return m_duration;
+		}
+		void report(std::ostream & stream) const
+		{
+			stream << std::fixed << std::setprecision(2);
+			for (auto const& current : timings())
+			{
+				stream << "  " << std::setw(24) << std::left << current.name << std::right
+					<< std::setw(10) << current.start << " ms" << std::setw(10) << current.finish - current.start << " ms" << std::endl;
+			}
+			stream << "  total " << m_duration << " ms" << std::endl;
+		}
+
+	public:
+		task_graph() noexcept
+			: m_duration(0)
+		{
+		}
+		task_graph(task_graph const&) = delete;
+		task_graph& operator=(task_graph const&) = delete;
+
+	private:
+		typedef std::chrono::high_resolution_clock clock;
+		struct task
+		{
+			std::string name;
+			std::function<void()> fn;
+			std::vector<task_id> dependencies;
+			std::vector<task_id> dependents;
+			size_t remaining;
+			double start;
+			double finish;
+		};
+
+	private:
+		void schedule(job_system & jobs, job_counter & counter, task_id id)
+		{
+			jobs.run([this, &jobs, &counter, id]() { execute(jobs, counter, id); }, &counter);
+		}
+		void execute(job_system & jobs, job_counter & counter, task_id id)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_error)
+				{
+					return; // cancelled
+				}
+			}
+
+			task & current = m_tasks[id];
+			current.start = milliseconds(clock::now());
+			std::exception_ptr error;
+			try
+			{
+				current.fn();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			current.finish = milliseconds(clock::now());
+
+			std::vector<task_id> ready;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (error && !m_error)
+				{
+					m_error = error;
+				}
+				if (!m_error)
+				{
+					for (task_id dependent : current.dependents)
+					{
+						if (--m_tasks[dependent].remaining == 0)
+						{
+							ready.push_back(dependent);
+						}
+					}
+				}
+			}
+
+			// scheduled before this job is counted as finished, so counter never reaches zero early
+			for (task_id dependent : ready)
+			{
+				schedule(jobs, counter, dependent);
+			}
+		}
+
+		double milliseconds(clock::time_point time) const noexcept
+		{
+			return std::chrono::duration<double, std::milli>(time - m_start).count();
+		}
+
+	private:
+		std::vector<task> m_tasks;
+		std::exception_ptr m_error; // first failure, cancels steps not started
+		std::mutex m_mutex;
+		clock::time_point m_start;
+		double m_duration;
+	};
+}
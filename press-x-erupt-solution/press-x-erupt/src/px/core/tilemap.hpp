@@ -0,0 +1,191 @@
+#pragma once
+
+// 2d grid of tiles stored by fixed size chunks, chunk data is laid out exactly as instance data for drawing
+// every chunk remembers range of tiles changed since its last upload, so uploads are limited to that range
+// lookups of chunks covering rectangle cost by rectangle area, independent of map size
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	// atlas cell and flips, four bytes per instance
+	struct tile
+	{
+		static const uint16_t empty = 0xffff;
+		static const uint16_t flip_x = 1;
+		static const uint16_t flip_y = 2;
+
+		uint16_t cell = empty;
+		uint16_t flags = 0;
+
+		bool operator==(tile const& other) const noexcept
+		{
+			return cell == other.cell && flags == other.flags;
+		}
+		bool operator!=(tile const& other) const noexcept
+		{
+			return !operator==(other);
+		}
+	};
+
+	class tilemap final
+	{
+	public:
+		static const uint32_t chunk_size = 32; // tiles per side
+		static const uint32_t chunk_tiles = chunk_size * chunk_size;
+
+		struct chunk
+		{
+			std::vector<tile> tiles; // row major within chunk
+			uint32_t dirty_begin; // changed tile range [begin, end) since last upload, empty if equal
+			uint32_t dirty_end;
+			uint32_t filled; // non empty tiles, empty chunks are not drawn
+		};
+		// chunk coordinates of rectangle, end exclusive
+		struct chunk_range
+		{
+			uint32_t x0, y0, x1, y1;
+		};
+
+	public:
+		uint32_t width() const noexcept
+		{
+			return m_width;
+		}
+		uint32_t height() const noexcept
+		{
+			return m_height;
+		}
+		uint32_t chunks_x() const noexcept
+		{
+			return m_chunks_x;
+		}
+		uint32_t chunks_y() const noexcept
+		{
+			return m_chunks_y;
+		}
+
+		tile get(uint32_t x, uint32_t y) const
+		{
+			check(x, y);
+			return at(x / chunk_size, y / chunk_size).tiles[local(x, y)];
+		}
+		void set(uint32_t x, uint32_t y, tile value)
+		{
+			check(x, y);
+			chunk & target = edit(x / chunk_size, y / chunk_size);
+			uint32_t index = local(x, y);
+			tile & current = target.tiles[index];
+			if (current == value)
+			{
+				return;
+			}
+			target.filled += (current.cell == tile::empty ? 1 : 0) - (value.cell == tile::empty ? 1 : 0);
+			current = value;
+			if (target.dirty_begin == target.dirty_end)
+			{
+				target.dirty_begin = index;
+				target.dirty_end = index + 1;
+			}
+			else
+			{
+				target.dirty_begin = std::min(target.dirty_begin, index);
+				target.dirty_end = std::max(target.dirty_end, index + 1);
+			}
+		}
+		// every tile of map, chunks are invalidated whole instead of growing dirty range tile by tile
+		void fill(tile value)
+		{
+			for (uint32_t y = 0; y != m_height; ++y)
+			{
+				for (uint32_t x = 0; x != m_width; ++x)
+				{
+					chunk & target = edit(x / chunk_size, y / chunk_size);
+					tile & current = target.tiles[local(x, y)];
+					target.filled += (current.cell == tile::empty ? 1 : 0) - (value.cell == tile::empty ? 1 : 0);
+					current = value;
+				}
+			}
+			for (uint32_t chunk_y = 0; chunk_y != m_chunks_y; ++chunk_y)
+			{
+				for (uint32_t chunk_x = 0; chunk_x != m_chunks_x; ++chunk_x)
+				{
+					invalidate(chunk_x, chunk_y);
+				}
+			}
+		}
+
+		chunk const& at(uint32_t chunk_x, uint32_t chunk_y) const
+		{
+			return m_chunks[chunk_y * m_chunks_x + chunk_x];
+		}
+		// chunks intersecting rectangle in tile units, clipped to map
+		chunk_range covering(float x, float y, float width, float height) const noexcept
+		{
+			auto clip = [](float value, uint32_t count) {
+				return static_cast<uint32_t>(std::min(std::max(value / chunk_size, 0.0f), static_cast<float>(count)));
+			};
+			chunk_range range;
+			range.x0 = clip(std::floor(x), m_chunks_x);
+			range.y0 = clip(std::floor(y), m_chunks_y);
+			range.x1 = clip(std::ceil(x + width) + chunk_size - 1, m_chunks_x);
+			range.y1 = clip(std::ceil(y + height) + chunk_size - 1, m_chunks_y);
+			return range;
+		}
+
+		// returns changed range and considers it uploaded
+		void take_dirty(uint32_t chunk_x, uint32_t chunk_y, uint32_t & begin, uint32_t & end) noexcept
+		{
+			chunk & target = edit(chunk_x, chunk_y);
+			begin = target.dirty_begin;
+			end = target.dirty_end;
+			target.dirty_begin = target.dirty_end = 0;
+		}
+		// whole chunk has to be uploaded, like after its gpu copy was evicted
+		void invalidate(uint32_t chunk_x, uint32_t chunk_y) noexcept
+		{
+			chunk & target = edit(chunk_x, chunk_y);
+			target.dirty_begin = 0;
+			target.dirty_end = chunk_tiles;
+		}
+
+	public:
+		tilemap(uint32_t width, uint32_t height)
+			: m_width(width)
+			, m_height(height)
+			, m_chunks_x((width + chunk_size - 1) / chunk_size)
+			, m_chunks_y((height + chunk_size - 1) / chunk_size)
+		{
+			chunk initial{ std::vector<tile>(chunk_tiles), 0, chunk_tiles, 0 };
+			m_chunks.assign(size_t{ m_chunks_x } * m_chunks_y, initial);
+		}
+
+	private:
+		void check(uint32_t x, uint32_t y) const
+		{
+			if (x >= m_width || y >= m_height)
+			{
+				throw std::out_of_range("px::tilemap::check() - tile out of map");
+			}
+		}
+		static uint32_t local(uint32_t x, uint32_t y) noexcept
+		{
+			return (y % chunk_size) * chunk_size + x % chunk_size;
+		}
+		chunk & edit(uint32_t chunk_x, uint32_t chunk_y)
+		{
+			return m_chunks[chunk_y * m_chunks_x + chunk_x];
+		}
+
+	private:
+		uint32_t m_width;
+		uint32_t m_height;
+		uint32_t m_chunks_x;
+		uint32_t m_chunks_y;
+		std::vector<chunk> m_chunks;
+	};
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// lock-free single producer, single consumer exchange of latest value
+// producer fills write buffer and publishes it, consumer picks up most recent published buffer
+// neither side ever waits, values published while consumer is busy are dropped in favour of newer ones
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace px
+{
+	template <typename T>
+	class triple_buffer final
+	{
+	public:
+		// producer side
+		T & write_buffer() noexcept
+		{
+			return m_buffers[m_write];
+		}
+		void publish() noexcept
+		{
+			m_write = m_middle.exchange(static_cast<uint8_t>(m_write | dirty_bit), std::memory_order_acq_rel) & index_mask;
+		}
+
+		// consumer side, returns true if newer value was published since last update
+		bool update() noexcept
+		{
+			if ((m_middle.load(std::memory_order_relaxed) & dirty_bit) == 0)
+			{
+				return false;
+			}
+			m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & index_mask;
+			return true;
+		}
+		T const& read_buffer() const noexcept
+		{
+			return m_buffers[m_read];
+		}
+
+	public:
+		triple_buffer()
+			: m_buffers{} // read before first publish sees value initialized state
+			, m_middle(1)
+			, m_write(0)
+			, m_read(2)
+		{
+		}
+		triple_buffer(triple_buffer const&) = delete;
+		triple_buffer& operator=(triple_buffer const&) = delete;
+
+	private:
+		static const uint8_t index_mask = 0x3;
+		static const uint8_t dirty_bit = 0x4;
+
+	private:
+		std::array<T, 3> m_buffers;
+		std::atomic<uint8_t> m_middle; // index of shared buffer and dirty flag
+		uint8_t m_write;
+		uint8_t m_read;
+	};
+}
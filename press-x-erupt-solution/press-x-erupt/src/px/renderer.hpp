@@ -1,8 +1,27 @@
 #pragma once
 
 #include <px/core/basic_application.hpp>
+#include <px/core/png_encoder.hpp>
+#include <px/core/profiler.hpp>
+#include <px/core/resolution_scaler.hpp>
+#include <px/core/task_graph.hpp>
+#include <px/vk_async_compute.hpp>
+#include <px/vk_capture.hpp>
+#include <px/vk_defragmenter.hpp>
 #include <px/vk_instance.hpp>
 #include <px/vk_device.hpp>
+#include <px/vk_device_profile.hpp>
+#include <px/vk_device_ranking.hpp>
+#include <px/vk_host_allocator.hpp>
+#include <px/vk_memory.hpp>
+#include <px/vk_pipeline_registry.hpp>
+#include <px/vk_present_policy.hpp>
+#include <px/vk_quad_animation.hpp>
+#include <px/vk_readback.hpp>
+#include <px/vk_texture_cache.hpp>
+#include <px/vk_sprite_layer.hpp>
+#include <px/vk_texture_table.hpp>
+#include <px/vk_tilemap_layer.hpp>
 
 #pragma warning(push)	// disable for this header only & restore original warning level
 #pragma warning(disable:4201) // unions for rgba and xyzw
@@ -11,9 +30,12 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstring>
-#include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -24,29 +46,8 @@ namespace px
 	class renderer
 	{
 	public:
-		struct queues
-		{
-			int graphics;
-			int presentation;
-			explicit operator bool() const noexcept
-			{
-				return graphics >= 0 && presentation >= 0;
-			}
-			bool match() const noexcept
-			{
-				return graphics == presentation;
-			}
-		};
-		struct swapchain_details
-		{
-			VkSurfaceCapabilitiesKHR capabilities;
-			std::vector<VkSurfaceFormatKHR> formats;
-			std::vector<VkPresentModeKHR> presentation_modes;
-			explicit operator bool() const noexcept
-			{
-				return !formats.empty() && !presentation_modes.empty();
-			}
-		};
+		static const uint32_t frames_in_flight = 2;
+
 		struct vertex
 		{
 			glm::vec2 position;
@@ -64,36 +65,91 @@ namespace px
 			}
 		};
 
+		// presents to window of application
 		renderer(basic_application & application)
-			: m_physical_device(VK_NULL_HANDLE)
+			: renderer(application.jobs(), application.window(), application.width(), application.height())
+		{
+		}
+		// without window renders headless, scene goes to offscreen target only and frames are not presented
+		renderer(job_system & jobs, GLFWwindow * window, uint32_t width, uint32_t height)
+			: m_jobs(jobs)
+			, m_policy(present_policy::low_latency)
+			, m_requested_policy(present_policy::low_latency)
+			, m_latency(0)
+			, m_budget(1000.0 / 60.0)
+			, m_scale(1.0)
+			, m_pinned_scale(0)
+			, m_gpu_time(0)
+			, m_width(width)
+			, m_height(height)
+			, m_surface(VK_NULL_HANDLE)
+			, m_texture_budget(0)
+			, m_view{ -1.0f, -1.0f, 1.0f, 1.0f }
+			, m_bindless(false)
+			, m_indexing{}
 			, m_swapchain(VK_NULL_HANDLE)
-			, m_pipeline_layout(VK_NULL_HANDLE)
-			, m_pipeline(VK_NULL_HANDLE)
+			, m_target{}
+			, m_color{}
+			, m_depth{}
+			, m_depth_format(VK_FORMAT_UNDEFINED)
+			, m_samples(VK_SAMPLE_COUNT_1_BIT)
+			, m_applied_samples(VK_SAMPLE_COUNT_1_BIT)
+			, m_requested_samples(VK_SAMPLE_COUNT_1_BIT)
+			, m_framebuffer(VK_NULL_HANDLE)
+			, m_blit(false)
+			, m_filter(VK_FILTER_NEAREST)
 			, m_renderpass(VK_NULL_HANDLE)
-			, m_width(application.width())
-			, m_height(application.height())
+			, m_pipeline_layout(VK_NULL_HANDLE)
+			, m_pipeline(std::numeric_limits<uint32_t>::max())
+			, m_tilemap_pipeline(std::numeric_limits<uint32_t>::max())
+			, m_sprite_pipeline(std::numeric_limits<uint32_t>::max())
+			, m_frame(0)
+			, m_timestamps(VK_NULL_HANDLE)
+			, m_timestamp_period(0)
+			, m_timestamp_mask(0)
 		{
 
-			uint32_t count = 0;
-			const char** extensions;
-			extensions = glfwGetRequiredInstanceExtensions(&count);
-			m_instance.create(count, extensions, validate);
-			if (glfwCreateWindowSurface(m_instance, application.window(), nullptr, &m_surface) != VK_SUCCESS)
-			{
-				throw std::runtime_error("failed to create window surface!");
-			}
-
-			select_physical_device();
-			create_logical_device();
-			create_swapchain();
-			create_image_views();
-			create_renderpass();
-			create_pipeline();
-			create_framebuffers();
-			create_command_pool();
-			create_buffers();
-			create_command_buffers();
-			create_semaphores();
+			// independent steps run concurrently, shader i/o overlaps device and swapchain creation
+			task_graph startup;
+			auto instance = startup.add("instance", [this, window]() {
+				uint32_t count = 0;
+				const char** extensions = window != nullptr ? glfwGetRequiredInstanceExtensions(&count) : nullptr;
+				m_instance.create(count, extensions, validate, m_host_allocator.callbacks());
+			});
+			auto surface = startup.add("surface", [this, window]() {
+				if (window != nullptr && glfwCreateWindowSurface(m_instance, window, m_host_allocator.callbacks(), &m_surface) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create window surface!");
+				}
+			}, { instance });
+			auto physical = startup.add("physical device", [this]() { select_physical_device(); }, { surface });
+			auto logical = startup.add("logical device", [this]() { create_logical_device(); }, { physical });
+			startup.add("async compute", [this]() { create_compute(); }, { logical });
+			auto textures = startup.add("textures", [this]() {
+				m_textures.create(m_device, m_profile, m_device_memory, m_jobs, 16 * 1024 * 1024, frames_in_flight, m_host_allocator.callbacks());
+				m_table.create(m_device, m_profile, m_bindless, frames_in_flight, m_host_allocator.callbacks());
+				m_tilemap.create(m_device, m_device_memory, 256, 256 * 1024, frames_in_flight, m_host_allocator.callbacks());
+				m_sprites.create(m_device, m_device_memory, 128 * 1024, frames_in_flight, m_host_allocator.callbacks());
+				m_readback.create(m_device, m_device_memory, m_jobs, frames_in_flight, m_host_allocator.callbacks());
+				m_device_memory.subscribe([this](uint32_t heap, VkDeviceSize excess, VkDeviceSize headroom) { relieve(heap, excess, headroom); });
+			}, { logical });
+			auto shaders = startup.add("shader i/o", [this]() { m_pipelines.preload(default_pipeline_state()); });
+			auto swapchain = startup.add("swapchain", [this]() {
+				create_swapchain();
+				create_image_sync();
+			}, { logical });
+			auto target = startup.add("attachments", [this]() { create_attachments(); }, { swapchain });
+			auto renderpass = startup.add("render pass", [this]() { create_renderpass(); }, { target });
+			startup.add("pipeline", [this]() { create_pipeline(); }, { renderpass, shaders, textures }); // layout includes texture table
+			startup.add("framebuffers", [this]() { create_framebuffers(); }, { renderpass, target });
+			auto pool = startup.add("command pool", [this]() { create_command_pool(); }, { logical });
+			auto buffers = startup.add("buffers", [this]() { create_buffers(); }, { pool });
+			startup.add("frames", [this]() { create_frames(); }, { buffers }); // pool is externally synchronized, so after buffer uploads
+
+			startup.run(m_jobs);
+
+			std::cout << "px::renderer - startup" << std::endl;
+			startup.report(std::cout);
 		}
 
 		renderer(renderer const&) = delete;
@@ -102,38 +158,78 @@ namespace px
 		{
 			vkDeviceWaitIdle(m_device);
 
-			vkDestroySemaphore(m_device, m_image_available, nullptr);
-			vkDestroySemaphore(m_device, m_rendering_finished, nullptr);
-
-			vkFreeMemory(m_device, m_index_memory, nullptr);
-			vkFreeMemory(m_device, m_memory, nullptr);
-			vkDestroyBuffer(m_device, m_index_buffer, nullptr);
-			vkDestroyBuffer(m_device, m_buffer, nullptr);
-
-			vkDestroyCommandPool(m_device, m_command_pool, nullptr);
-
-			for (auto const& framebuffer : m_swapchain_framebuffers)
+			for (auto const& current : m_frames)
 			{
-				vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+				vkDestroySemaphore(m_device, current.image_available, m_host_allocator.callbacks());
+				vkDestroyFence(m_device, current.fence, m_host_allocator.callbacks());
+			}
+			for (auto const& semaphore : m_image_finished)
+			{
+				vkDestroySemaphore(m_device, semaphore, m_host_allocator.callbacks());
+			}
+			if (m_timestamps != VK_NULL_HANDLE)
+			{
+				vkDestroyQueryPool(m_device, m_timestamps, m_host_allocator.callbacks());
 			}
 
-			vkDestroyPipeline(m_device, m_pipeline, nullptr);
-			vkDestroyRenderPass(m_device, m_renderpass, nullptr);
-			vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
-
-			for (auto const& image_view : m_image_views)
+			m_defragmenter.release();
+			vkDestroyBuffer(m_device, m_index_buffer, m_host_allocator.callbacks());
+			vkDestroyBuffer(m_device, m_buffer, m_host_allocator.callbacks());
+			m_device_memory.free(m_index_memory);
+			m_device_memory.free(m_memory);
+
+			vkDestroyCommandPool(m_device, m_command_pool, m_host_allocator.callbacks());
+			m_compute.release();
+			m_animation.release();
+			m_tilemap.release();
+			m_sprites.release();
+			m_readback.release();
+			m_table.release();
+			m_textures.release();
+
+			vkDestroyFramebuffer(m_device, m_framebuffer, m_host_allocator.callbacks());
+			destroy_attachments();
+
+			m_pipelines.release();
+			vkDestroyRenderPass(m_device, m_renderpass, m_host_allocator.callbacks());
+			vkDestroyPipelineLayout(m_device, m_pipeline_layout, m_host_allocator.callbacks());
+
+			if (m_swapchain != VK_NULL_HANDLE)
 			{
-				vkDestroyImageView(m_device, image_view, nullptr);
+				vkDestroySwapchainKHR(m_device, m_swapchain, m_host_allocator.callbacks()); // extension is not enabled headless
 			}
-			vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+			m_device_memory.release();
 			m_device.release();
-			vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+			if (m_surface != VK_NULL_HANDLE)
+			{
+				vkDestroySurfaceKHR(m_instance, m_surface, m_host_allocator.callbacks());
+			}
 			m_instance.release();
 		}
 		void draw_frame()
 		{
-			uint32_t image_index;
-			VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, std::numeric_limits<uint64_t>::max(), m_image_available, VK_NULL_HANDLE, &image_index);
+			PX_PROFILE_FUNCTION();
+			if (m_requested_policy.load() != m_policy || m_requested_samples.load() != m_applied_samples)
+			{
+				reset_swapchain();
+			}
+
+			// slot is reused after its previous submission finished, so its timestamps are available
+			frame & current = m_frames[m_frame];
+			{
+				PX_PROFILE_ZONE("wait frame fence");
+				vkWaitForFences(m_device, 1, &current.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			}
+			scale_resolution(current);
+
+			auto acquire_start = std::chrono::high_resolution_clock::now();
+			uint32_t image_index = 0;
+			VkResult result = VK_SUCCESS;
+			if (!headless())
+			{
+				PX_PROFILE_ZONE("acquire image");
+				result = vkAcquireNextImageKHR(m_device, m_swapchain, std::numeric_limits<uint64_t>::max(), current.image_available, VK_NULL_HANDLE, &image_index);
+			}
 
 			if (result == VK_ERROR_OUT_OF_DATE_KHR)
 			{
@@ -145,23 +241,58 @@ namespace px
 				throw std::runtime_error("failed to acquire swap chain image!");
 			}
 
-			VkSemaphore wait_semaphores[] = { m_image_available };
-			VkSemaphore signal_semaphores[] = { m_rendering_finished };
-			VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+			// image may be still presented from slot other than current one
+			if (!headless())
+			{
+				if (m_image_fences[image_index] != VK_NULL_HANDLE && m_image_fences[image_index] != current.fence)
+				{
+					PX_PROFILE_ZONE("wait image fence");
+					vkWaitForFences(m_device, 1, &m_image_fences[image_index], VK_TRUE, std::numeric_limits<uint64_t>::max());
+				}
+				m_image_fences[image_index] = current.fence;
+			}
+			vkResetFences(m_device, 1, &current.fence);
+
+			// compute of this frame runs on its own queue while graphics of previous frame still executes
+			VkSemaphore computed = m_compute.submit(m_frame);
+			record(current, image_index);
+
+			// headless frame waits for compute only and signals nothing besides its fence
+			VkSemaphore wait_semaphores[2];
+			VkPipelineStageFlags wait_stages[2];
+			uint32_t wait_count = 0;
+			if (!headless())
+			{
+				wait_semaphores[wait_count] = current.image_available;
+				wait_stages[wait_count++] = VK_PIPELINE_STAGE_TRANSFER_BIT; // swapchain image is only written by blit
+			}
+			if (computed != VK_NULL_HANDLE)
+			{
+				wait_semaphores[wait_count] = computed;
+				wait_stages[wait_count++] = m_compute.wait_stages(m_frame);
+			}
+			VkSemaphore signal_semaphores[] = { headless() ? VK_NULL_HANDLE : m_image_finished[image_index] };
 			VkSubmitInfo submit_info = {};
 			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-			submit_info.waitSemaphoreCount = 1;
+			submit_info.waitSemaphoreCount = wait_count;
 			submit_info.pWaitSemaphores = wait_semaphores;
 			submit_info.pWaitDstStageMask = wait_stages;
 			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &m_command_buffers[image_index];
-			submit_info.signalSemaphoreCount = 1;
+			submit_info.pCommandBuffers = &current.commands;
+			submit_info.signalSemaphoreCount = headless() ? 0 : 1;
 			submit_info.pSignalSemaphores = signal_semaphores;
 
-			if (vkQueueSubmit(m_graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+			current.submitted = profiler::global().now();
+			if (vkQueueSubmit(m_graphics_queue, 1, &submit_info, current.fence) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to submit draw command buffer!");
 			}
+			current.timed = m_timestamps != VK_NULL_HANDLE;
+			m_frame = (m_frame + 1) % frames_in_flight;
+			if (headless())
+			{
+				return;
+			}
 
 			// submitting the result back to the swap chain to have it eventually show up on the screen
 			VkPresentInfoKHR presentInfo = {};
@@ -175,7 +306,14 @@ namespace px
 			presentInfo.pImageIndices = &image_index;
 			presentInfo.pResults = nullptr;
 
-			result = vkQueuePresentKHR(m_presentation_queue, &presentInfo);
+			{
+				PX_PROFILE_ZONE("present");
+				result = vkQueuePresentKHR(m_presentation_queue, &presentInfo);
+			}
+
+			double latency = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - acquire_start).count();
+			double average = m_latency.load();
+			m_latency = average == 0 ? latency : average * 0.95 + latency * 0.05;
 
 			if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
 			{
@@ -193,58 +331,364 @@ namespace px
 			reset_swapchain();
 		}
 
-	private:
-		void select_physical_device()
+		// mode and swapchain depth, applied by swapchain recreation on next frame, safe to call from any thread
+		void present(present_policy policy) noexcept
+		{
+			m_requested_policy = policy;
+		}
+		present_policy present() const noexcept
+		{
+			return m_requested_policy.load();
+		}
+		// milliseconds from acquire call to return of present call, moving average over recent frames
+		double present_latency() const noexcept
 		{
-			uint32_t device_count = 0;
-			vkEnumeratePhysicalDevices(m_instance, &device_count, nullptr);
-			if (device_count == 0)
+			return m_latency.load();
+		}
+
+		// gpu milliseconds per frame the render resolution is scaled to hit, zero renders at full resolution
+		// safe to call from any thread
+		void resolution_budget(double milliseconds) noexcept
+		{
+			m_budget = milliseconds;
+		}
+		double resolution_budget() const noexcept
+		{
+			return m_budget.load();
+		}
+		// fraction of swapchain extent per axis the scene is rendered with
+		double resolution_scale() const noexcept
+		{
+			return m_scale.load();
+		}
+		// fixes render scale regardless of budget, zero returns it to budget control, safe to call from any thread
+		void resolution_scale(double scale) noexcept
+		{
+			m_pinned_scale = scale;
+		}
+		// smoothed gpu milliseconds of scene rendering, zero if device has no timestamps
+		double gpu_time() const noexcept
+		{
+			return m_gpu_time.load();
+		}
+
+		// multisampling of scene pass, rounded down to count supported for color and depth, applied on next frame
+		// safe to call from any thread
+		void samples(VkSampleCountFlagBits count) noexcept
+		{
+			m_requested_samples = count;
+		}
+		// effective sample count
+		VkSampleCountFlagBits samples() const noexcept
+		{
+			return m_samples;
+		}
+
+		// compute pass recorded every frame before graphics of the same frame, render thread only
+		// buffers the pass writes for graphics are declared with recorder::share
+		void compute(vk_async_compute::pass_fn pass)
+		{
+			m_compute.add(pass);
+		}
+		// default quad is rotated by compute pass instead of drawn from static vertex buffer, render thread only
+		void animate_quad()
+		{
+			if (m_animation.created())
 			{
-				throw std::runtime_error("failed to find GPUs with Vulkan support!");
+				return;
 			}
+			m_animation.create(m_device, m_device_memory, frames_in_flight, "data/shaders/quad.comp.spv", m_host_allocator.callbacks());
+			auto start = std::chrono::steady_clock::now();
+			m_compute.add([this, start](vk_async_compute::recorder & context) {
+				std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+				m_animation.record(context, elapsed.count()); // radian per second
+			});
+		}
+		// dedicated compute queue family is used
+		bool async_compute() const noexcept
+		{
+			return m_compute.async();
+		}
+
+		// driver host memory by allocation scope, safe to call from any thread
+		vk_host_allocator const& host_allocator() const noexcept
+		{
+			return m_host_allocator;
+		}
+
+		// device memory by heap and category, safe to call from any thread
+		vk_memory const& device_memory() const noexcept
+		{
+			return m_device_memory;
+		}
+
+		vk_defragmenter const& defragmenter() const noexcept
+		{
+			return m_defragmenter;
+		}
+
+		// streamed textures, render thread only, views are valid for the frame they are fetched in
+		vk_texture_cache & textures() noexcept
+		{
+			return m_textures;
+		}
+
+		// descriptors of loaded textures, bindless array if device has descriptor indexing
+		vk_texture_table const& texture_table() const noexcept
+		{
+			return m_table;
+		}
 
-			std::vector<VkPhysicalDevice> devices(device_count);
-			vkEnumeratePhysicalDevices(m_instance, &device_count, devices.data());
-			for (auto const& current : devices)
+		// map drawn under the scene from chunks covering the view, atlas texture is split to columns by rows cells
+		// map is edited on render thread only, null detaches
+		void tilemap(px::tilemap * map, uint32_t atlas, uint32_t columns, uint32_t rows)
+		{
+			m_tilemap.attach(map, atlas, columns, rows);
+			if (map != nullptr)
 			{
-				if (suitable(current))
-				{
-					m_physical_device = current;
-					break;
-				}
+				m_tilemap_pipeline = m_pipelines.request(tilemap_pipeline_state());
 			}
-
-			if (m_physical_device == VK_NULL_HANDLE)
+		}
+		// objects culled against the view and drawn over the map, world units are tiles
+		// scene is edited on render thread only, null detaches
+		void objects(px::scene * objects)
+		{
+			m_sprites.attach(objects);
+			if (objects != nullptr)
 			{
-				throw std::runtime_error("failed to find a suitable GPU!");
+				m_sprite_pipeline = m_pipelines.request(sprite_pipeline_state());
 			}
 		}
+		// instances drawn as they are every frame in place of scene, used by replay of captured frames, render thread only
+		void objects(std::vector<scene::instance> instances, std::vector<scene::batch> batches)
+		{
+			m_sprites.feed(std::move(instances), std::move(batches));
+			m_sprite_pipeline = m_pipelines.request(sprite_pipeline_state());
+		}
+		// rectangle of the world shown, in tiles, render thread only
+		void view(float x, float y, float width, float height) noexcept
+		{
+			m_tilemap.view(x, y, width, height);
+			m_view = { x, y, x + width, y + height };
+		}
+
+		// next frames with resources they use written to file for replay, ignored while capture runs
+		// safe to call from any thread
+		void capture(std::string path, uint32_t frames)
+		{
+			m_capture.request(std::move(path), frames);
+		}
+		bool capturing() const noexcept
+		{
+			return m_capture.active();
+		}
+		// pixels of next recorded frame at render resolution, ready after device finished it, safe to call from any thread
+		std::future<vk_readback::image> readback()
+		{
+			return m_readback.request();
+		}
+		// next frame encoded and written by worker, frame loop does not wait for either, safe to call from any thread
+		void screenshot(std::string path)
+		{
+			m_readback.request([path](vk_readback::image && frame) {
+				PX_PROFILE_ZONE("png encode");
+				if (png::save(path, frame.pixels.data(), frame.width, frame.height, size_t{ frame.width } * 4, frame.bgra))
+				{
+					std::cout << "px::renderer - screenshot saved to " << path << std::endl;
+				}
+				else
+				{
+					std::cout << "px::renderer - failed to write screenshot " << path << std::endl;
+				}
+			});
+		}
+		// no window, frames are not presented
+		bool headless() const noexcept
+		{
+			return m_surface == VK_NULL_HANDLE;
+		}
+
+		// pipeline variant identifier, compiled in background and substituted with fallback until ready
+		uint32_t request_pipeline(pipeline_state const& state)
+		{
+			return m_pipelines.request(state);
+		}
+		pipeline_state default_pipeline_state() const
+		{
+			auto attributes = vertex::attribute_descriptions();
+
+			pipeline_state state;
+			state.vertex_shader = "data/shaders/triangle.vert.spv";
+			state.fragment_shader = "data/shaders/triangle.frag.spv";
+			state.bindings = { vertex::binding_description() };
+			state.attributes.assign(std::begin(attributes), std::end(attributes));
+			state.layout = m_pipeline_layout;
+			return state;
+		}
+		// default vertices with texture index per instance in binding 1
+		pipeline_state textured_pipeline_state() const
+		{
+			pipeline_state state = default_pipeline_state();
+			state.vertex_shader = "data/shaders/textured.vert.spv";
+			state.fragment_shader = m_table.bindless() ? "data/shaders/textured_bindless.frag.spv" : "data/shaders/textured.frag.spv";
+			state.bindings.push_back({ 1, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE });
+			state.attributes.push_back({ 2, 1, VK_FORMAT_R32_UINT, 0 });
+			return state;
+		}
+		// quad per tile from vertex index, tile instances in binding 0, chunk placement in push constants
+		pipeline_state tilemap_pipeline_state() const
+		{
+			pipeline_state state = textured_pipeline_state();
+			state.vertex_shader = "data/shaders/tilemap.vert.spv";
+			state.bindings = { vk_tilemap_layer::binding_description() };
+			state.attributes = { vk_tilemap_layer::attribute_description() };
+			return state;
+		}
+		// quad per object from vertex index, gathered scene instances in binding 0, alpha blended
+		pipeline_state sprite_pipeline_state() const
+		{
+			auto attributes = vk_sprite_layer::attribute_descriptions();
+
+			pipeline_state state = textured_pipeline_state();
+			state.vertex_shader = "data/shaders/sprite.vert.spv";
+			state.bindings = { vk_sprite_layer::binding_description() };
+			state.attributes.assign(std::begin(attributes), std::end(attributes));
+			state.blend = blend_mode::alpha;
+			return state;
+		}
+
+	private:
+		struct render_image
+		{
+			VkImage image;
+			vk_memory::allocation memory;
+			VkImageView view;
+		};
+		struct frame
+		{
+			VkCommandBuffer commands;
+			VkFence fence; // signaled when submission finished
+			VkSemaphore image_available;
+			bool timed; // timestamps written by last submission
+			uint64_t submitted; // profiler time of last submission
+		};
+
+	private:
+		void select_physical_device()
+		{
+			PX_PROFILE_FUNCTION();
+			vk_device_ranking ranking;
+			m_profile = ranking.select(m_instance, m_surface, [this](vk_device_profile const& profile) { return suitable(profile); });
+		}
 		void create_logical_device()
 		{
-			queues queue_indices = find_queues(m_physical_device);
+			PX_PROFILE_FUNCTION();
+			auto const& queues = m_profile.queues();
+
+			// bindless textures need descriptor indexing, chained into creation with its extension if not core
+			std::vector<const char*> extensions = headless() ? std::vector<const char*>{} : device_extensions;
+			m_bindless = vk_texture_table::supported(m_instance, m_profile, m_indexing, extensions);
+			std::cout << "px::renderer - textures " << (m_bindless ? "bindless" : "per draw sets") << std::endl;
+			bool budget = vk_memory::budget_supported(m_instance, m_profile, extensions);
+			std::cout << "px::renderer - memory budget " << (budget ? "reported by driver" : "estimated") << std::endl;
+
+			// compressed texture formats are usable only with their feature enabled
+			VkPhysicalDeviceFeatures const& available = m_profile.features();
+			VkPhysicalDeviceFeatures features{};
+			features.textureCompressionBC = available.textureCompressionBC;
+			features.textureCompressionETC2 = available.textureCompressionETC2;
+			features.textureCompressionASTC_LDR = available.textureCompressionASTC_LDR;
 
-			m_device.create(m_physical_device, { queue_indices.graphics, queue_indices.presentation }, m_instance.layer_count(), m_instance.layers(), static_cast<uint32_t>(device_extensions.size()), device_extensions.data());
+			m_device.create(m_profile, { queues.graphics, presentation_family(), compute_family() }, m_instance.layer_count(), m_instance.layers(), static_cast<uint32_t>(extensions.size()), extensions.data(), features, m_bindless ? &m_indexing : nullptr, m_host_allocator.callbacks());
 
-			vkGetDeviceQueue(m_device, queue_indices.graphics, 0, &m_graphics_queue);
-			vkGetDeviceQueue(m_device, queue_indices.presentation, 0, &m_presentation_queue);
+			m_device_memory.create(m_instance, m_profile, m_device, budget, m_host_allocator.callbacks());
+			m_defragmenter.create(m_device, m_device_memory, frames_in_flight, m_host_allocator.callbacks());
+
+			vkGetDeviceQueue(m_device, queues.graphics, 0, &m_graphics_queue);
+			vkGetDeviceQueue(m_device, presentation_family(), 0, &m_presentation_queue);
+
+			m_pipelines.create(m_device, m_jobs, m_host_allocator.callbacks());
+		}
+		// budget subscriber, streamed textures give up their share of device local heap over pressure threshold
+		// lowered budget grows back by half of headroom per notification, so heap approaches threshold without crossing it
+		void relieve(uint32_t heap, VkDeviceSize excess, VkDeviceSize headroom)
+		{
+			if ((m_profile.memory().memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0)
+			{
+				return;
+			}
+			if (excess != 0)
+			{
+				if (m_texture_budget == 0)
+				{
+					m_texture_budget = m_textures.budget();
+				}
+				VkDeviceSize usage = m_textures.usage();
+				VkDeviceSize budget = std::min<VkDeviceSize>(m_textures.budget(), usage > excess ? usage - excess : 0);
+				m_textures.budget(budget);
+				std::cout << "px::renderer - texture budget lowered to " << budget / 1024 << " kb" << std::endl;
+			}
+			else if (m_texture_budget != 0)
+			{
+				VkDeviceSize budget = std::min<VkDeviceSize>(m_texture_budget, m_textures.budget() + headroom / 2);
+				m_textures.budget(budget);
+				if (budget == m_texture_budget)
+				{
+					m_texture_budget = 0;
+				}
+				std::cout << "px::renderer - texture budget raised to " << budget / 1024 << " kb" << std::endl;
+			}
+		}
+		// headless renderer presents nothing, graphics queue stands in
+		int presentation_family() const
+		{
+			auto const& queues = m_profile.queues();
+			return headless() ? queues.graphics : queues.presentation;
+		}
+		// graphics family is used if device exposes no other compute family
+		int compute_family() const
+		{
+			auto const& queues = m_profile.queues();
+			return queues.compute >= 0 ? queues.compute : queues.graphics;
+		}
+		void create_compute()
+		{
+			PX_PROFILE_FUNCTION();
+			m_compute.create(m_device, static_cast<uint32_t>(compute_family()), static_cast<uint32_t>(m_profile.queues().graphics), frames_in_flight, m_host_allocator.callbacks());
+			std::cout << "px::renderer - compute family " << compute_family() << (m_compute.async() ? ", async" : ", shared with graphics") << std::endl;
 		}
 		void create_swapchain()
 		{
-			auto details = swapchain_support(m_physical_device);
+			PX_PROFILE_FUNCTION();
+			if (headless())
+			{
+				m_extent = { std::max(1u, m_width), std::max(1u, m_height) };
+				m_format = VK_FORMAT_B8G8R8A8_UNORM;
+				m_policy = m_requested_policy.load();
+				return;
+			}
 
-			VkSurfaceFormatKHR surface_format = choose_swapchain_format(details.formats);
-			VkPresentModeKHR mode = choose_swapchain_mode(details.presentation_modes);
-			m_extent = choose_swapchain_extent(details.capabilities, m_width, m_height);
+			auto capabilities = m_profile.surface_capabilities(); // current extent changes, so not cached
+			if ((capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0)
+			{
+				throw std::runtime_error("px::renderer::create_swapchain() - swapchain images can not be transfer destination");
+			}
+
+			VkSurfaceFormatKHR surface_format = choose_swapchain_format(m_profile.surface_formats());
+			m_extent = choose_swapchain_extent(capabilities, m_width, m_height);
 			m_format = surface_format.format;
 
-			// A value of 0 for maxImageCount means that there is no limit besides memory requirements, which is why we need to check for that.
-			uint32_t image_count = details.capabilities.minImageCount + 1;
-			if (details.capabilities.maxImageCount > 0 && image_count > details.capabilities.maxImageCount)
+			present_policy policy = m_requested_policy.load();
+			vk_present_config presentation = choose_present_config(policy, m_profile.present_modes(), capabilities);
+			uint32_t image_count = presentation.image_count;
+			if (policy != m_policy || m_swapchain == VK_NULL_HANDLE)
 			{
-				image_count = details.capabilities.maxImageCount;
+				std::cout << "px::renderer - present policy " << to_string(policy) << ", mode " << to_string(presentation.mode) << ", " << image_count << " images" << std::endl;
+				m_policy = policy;
+				m_latency = 0;
 			}
 
-			auto queues = find_queues(m_physical_device);
+			auto const& queues = m_profile.queues();
 			uint32_t queue_indices[] = { static_cast<uint32_t>(queues.graphics), static_cast<uint32_t>(queues.presentation) };
 
 			VkSwapchainCreateInfoKHR create_info = {};
@@ -255,9 +699,9 @@ namespace px
 			create_info.imageColorSpace = surface_format.colorSpace;
 			create_info.imageExtent = m_extent;
 			create_info.imageArrayLayers = 1;
-			create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			create_info.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT; // scene is blitted from render target
 
-			if (queues.match())
+			if (!queues.match())
 			{
 				create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
 				create_info.queueFamilyIndexCount = 2;
@@ -270,21 +714,21 @@ namespace px
 				create_info.pQueueFamilyIndices = nullptr;
 			}
 
-			create_info.preTransform = details.capabilities.currentTransform;
+			create_info.preTransform = capabilities.currentTransform;
 			create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-			create_info.presentMode = mode;
+			create_info.presentMode = presentation.mode;
 			create_info.clipped = VK_TRUE;
 
 			VkSwapchainKHR old = m_swapchain; // VK_NULL_HANDLE set in constructor
 			create_info.oldSwapchain = old;
 
-			if (vkCreateSwapchainKHR(m_device, &create_info, nullptr, &m_swapchain) != VK_SUCCESS)
+			if (vkCreateSwapchainKHR(m_device, &create_info, m_host_allocator.callbacks(), &m_swapchain) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create swap chain!");
 			}
 			if (old != VK_NULL_HANDLE)
 			{
-				vkDestroySwapchainKHR(m_device, old, nullptr);
+				vkDestroySwapchainKHR(m_device, old, m_host_allocator.callbacks());
 			}
 
 			// The implementation is allowed to create more images, which is why we need to explicitly query the amount again.
@@ -292,373 +736,581 @@ namespace px
 			m_swapchain_images.resize(image_count);
 			vkGetSwapchainImagesKHR(m_device, m_swapchain, &image_count, m_swapchain_images.data());
 		}
-		void create_image_views()
+		// semaphores and fences tracked per swapchain image, count may change with swapchain
+		void create_image_sync()
 		{
-			for (size_t i = 0, size = m_image_views.size(); i != size; ++i)
+			PX_PROFILE_FUNCTION();
+			for (auto const& semaphore : m_image_finished)
 			{
-				vkDestroyImageView(m_device, m_image_views[i], nullptr);
+				vkDestroySemaphore(m_device, semaphore, m_host_allocator.callbacks());
 			}
 
-			m_image_views.resize(m_swapchain_images.size());
-			for (size_t i = 0, size = m_swapchain_images.size(); i != size; ++i)
+			VkSemaphoreCreateInfo semaphore_info{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+			m_image_finished.assign(m_swapchain_images.size(), VK_NULL_HANDLE);
+			for (auto & semaphore : m_image_finished)
 			{
-				VkImageViewCreateInfo create_info = {};
-				create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-				create_info.image = m_swapchain_images[i];
-				create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-				create_info.format = m_format;
-				create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-				create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-				create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-				create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-				create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				create_info.subresourceRange.baseMipLevel = 0;
-				create_info.subresourceRange.levelCount = 1;
-				create_info.subresourceRange.baseArrayLayer = 0;
-				create_info.subresourceRange.layerCount = 1;
+				if (vkCreateSemaphore(m_device, &semaphore_info, m_host_allocator.callbacks(), &semaphore) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create semaphores!");
+				}
+			}
+			m_image_fences.assign(m_swapchain_images.size(), VK_NULL_HANDLE);
+		}
+
+		// scene is rendered to top left corner of full size target, so scale changes need no reallocation
+		// multisampled color and depth live only inside render pass, so they are transient and lazily allocated where possible
+		void create_attachments()
+		{
+			PX_PROFILE_FUNCTION();
+			destroy_attachments();
 
-				if (vkCreateImageView(m_device, &create_info, nullptr, &m_image_views[i]) != VK_SUCCESS)
+			VkSampleCountFlagBits requested = m_requested_samples.load();
+			m_applied_samples = requested;
+			m_samples = supported_samples(requested);
+			m_depth_format = choose_depth_format();
+
+			VkImageUsageFlags transient = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			m_target = create_image(m_format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+			if (m_samples != VK_SAMPLE_COUNT_1_BIT)
+			{
+				m_color = create_image(m_format, m_samples, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | transient, VK_IMAGE_ASPECT_COLOR_BIT);
+			}
+			m_depth = create_image(m_depth_format, m_samples, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | transient, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+			// without scaling blit only copy at full resolution is possible
+			VkFormatFeatureFlags features = m_profile.format_properties(m_format).optimalTilingFeatures;
+			m_blit = (features & VK_FORMAT_FEATURE_BLIT_SRC_BIT) != 0 && (features & VK_FORMAT_FEATURE_BLIT_DST_BIT) != 0;
+			m_filter = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0 ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+			if (requested != m_samples || m_samples != VK_SAMPLE_COUNT_1_BIT)
+			{
+				std::cout << "px::renderer - msaa " << m_samples << "x (requested " << requested << "x)" << std::endl;
+			}
+		}
+		void destroy_attachments()
+		{
+			destroy_image(m_target);
+			destroy_image(m_color);
+			destroy_image(m_depth);
+		}
+		// image at full swapchain extent with own memory and view
+		render_image create_image(VkFormat format, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+		{
+			render_image result{};
+
+			VkImageCreateInfo image_info{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+			image_info.imageType = VK_IMAGE_TYPE_2D;
+			image_info.format = format;
+			image_info.extent = { m_extent.width, m_extent.height, 1 };
+			image_info.mipLevels = 1;
+			image_info.arrayLayers = 1;
+			image_info.samples = samples;
+			image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			image_info.usage = usage;
+			image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(m_device, &image_info, m_host_allocator.callbacks(), &result.image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::renderer::create_image() - failed to create attachment image");
+			}
+
+			VkMemoryPropertyFlags preferred = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0 ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+			try
+			{
+				result.memory = m_device_memory.bind(result.image, vk_memory::category::image, preferred, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			}
+			catch (...)
+			{
+				vkDestroyImage(m_device, result.image, m_host_allocator.callbacks());
+				throw;
+			}
+
+			VkImageViewCreateInfo view_info{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+			view_info.image = result.image;
+			view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view_info.format = format;
+			view_info.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+			view_info.subresourceRange = { aspect, 0, 1, 0, 1 };
+			if (vkCreateImageView(m_device, &view_info, m_host_allocator.callbacks(), &result.view) != VK_SUCCESS)
+			{
+				destroy_image(result);
+				throw std::runtime_error("px::renderer::create_image() - failed to create attachment view");
+			}
+			return result;
+		}
+		void destroy_image(render_image & target)
+		{
+			vkDestroyImageView(m_device, target.view, m_host_allocator.callbacks());
+			vkDestroyImage(m_device, target.image, m_host_allocator.callbacks());
+			m_device_memory.free(target.memory);
+			target = {};
+		}
+		VkSampleCountFlagBits supported_samples(VkSampleCountFlagBits requested) const
+		{
+			VkSampleCountFlags supported = m_profile.limits().framebufferColorSampleCounts & m_profile.limits().framebufferDepthSampleCounts;
+			for (uint32_t count = requested; count > 1; count >>= 1)
+			{
+				if ((supported & count) != 0)
 				{
-					throw std::runtime_error("failed to create image views!");
+					return static_cast<VkSampleCountFlagBits>(count);
 				}
 			}
+			return VK_SAMPLE_COUNT_1_BIT;
 		}
-		void create_pipeline()
+		VkFormat choose_depth_format() const
 		{
-			if (m_pipeline != VK_NULL_HANDLE)
+			for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM })
 			{
-				vkDestroyPipeline(m_device, m_pipeline, nullptr);
+				if ((m_profile.format_properties(format).optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) != 0)
+				{
+					return format;
+				}
 			}
-			if (m_pipeline_layout != VK_NULL_HANDLE)
+			throw std::runtime_error("px::renderer::choose_depth_format() - no depth attachment format supported");
+		}
+		void create_pipeline()
+		{
+			PX_PROFILE_FUNCTION();
+			if (m_pipeline_layout == VK_NULL_HANDLE)
 			{
-				vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
+				VkDescriptorSetLayout set_layout = m_table.layout();
+				VkPushConstantRange push_range = vk_tilemap_layer::push_range();
+				VkPipelineLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+				layout_info.setLayoutCount = 1;
+				layout_info.pSetLayouts = &set_layout;
+				layout_info.pushConstantRangeCount = 1;
+				layout_info.pPushConstantRanges = &push_range;
+
+				if (vkCreatePipelineLayout(m_device, &layout_info, m_host_allocator.callbacks(), &m_pipeline_layout) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create pipeline layout!");
+				}
 			}
 
-			VkViewport viewport = {};
-			viewport.x = 0.0f;
-			viewport.y = 0.0f;
-			viewport.width = static_cast<float>(m_extent.width);
-			viewport.height = static_cast<float>(m_extent.height);
-			viewport.minDepth = 0.0f;
-			viewport.maxDepth = 1.0f;
-			VkRect2D scissor = { { 0, 0 }, m_extent };
-
-			auto vertex = create_shader(read_file("data/shaders/triangle.vert.spv"));
-			auto fragment = create_shader(read_file("data/shaders/triangle.frag.spv"));
-			VkPipelineShaderStageCreateInfo vertex_info{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-			vertex_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-			vertex_info.module = vertex;
-			vertex_info.pName = "main";
-			vertex_info.pSpecializationInfo = nullptr;
-			VkPipelineShaderStageCreateInfo fragment_info{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-			fragment_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			fragment_info.module = fragment;
-			fragment_info.pName = "main";
-			fragment_info.pSpecializationInfo = nullptr;
-			VkPipelineShaderStageCreateInfo shader_stages[] = { vertex_info, fragment_info };
-
-			auto binding_description = vertex::binding_description();
-			auto attribute_descriptions = vertex::attribute_descriptions();
-			VkPipelineVertexInputStateCreateInfo vertex_input_info = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
-			vertex_input_info.vertexBindingDescriptionCount = 1;
-			vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-			vertex_input_info.pVertexBindingDescriptions = &binding_description;
-			vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
-
-			VkPipelineInputAssemblyStateCreateInfo input_assembly_info = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
-			input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-			input_assembly_info.primitiveRestartEnable = VK_FALSE;
-
-			VkPipelineViewportStateCreateInfo viewport_info = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-			viewport_info.viewportCount = 1;
-			viewport_info.pViewports = &viewport;
-			viewport_info.scissorCount = 1;
-			viewport_info.pScissors = &scissor;
-
-			VkPipelineRasterizationStateCreateInfo rasterizer{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
-			rasterizer.depthClampEnable = VK_FALSE;
-			rasterizer.rasterizerDiscardEnable = VK_FALSE;
-			rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-			rasterizer.lineWidth = 1.0f;
-			rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-			rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-			rasterizer.depthBiasEnable = VK_FALSE;
-			rasterizer.depthBiasConstantFactor = 0.0f;
-			rasterizer.depthBiasClamp = 0.0f;
-			rasterizer.depthBiasSlopeFactor = 0.0f;
-
-			VkPipelineMultisampleStateCreateInfo multisampling{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-			multisampling.sampleShadingEnable = VK_FALSE;
-			multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-			multisampling.minSampleShading = 1.0f;
-			multisampling.pSampleMask = nullptr;
-			multisampling.alphaToCoverageEnable = VK_FALSE;
-			multisampling.alphaToOneEnable = VK_FALSE;
-
-			VkPipelineColorBlendAttachmentState blend_attachment = {};
-			blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-			blend_attachment.blendEnable = VK_FALSE;
-			blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-			blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-			blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
-			blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-			blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-			blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-			VkPipelineColorBlendStateCreateInfo blending{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
-			blending.logicOpEnable = VK_FALSE;
-			blending.attachmentCount = 1;
-			blending.pAttachments = &blend_attachment;
-			blending.blendConstants[0] = 0.0f;
-			blending.blendConstants[1] = 0.0f;
-			blending.blendConstants[2] = 0.0f;
-			blending.blendConstants[3] = 0.0f;
-
-			VkPipelineLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-			layout_info.setLayoutCount = 0;
-			layout_info.pSetLayouts = nullptr;
-			layout_info.pushConstantRangeCount = 0;
-			layout_info.pPushConstantRanges = 0;
-
-			if (vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_pipeline_layout) != VK_SUCCESS)
-			{
-				throw std::runtime_error("failed to create pipeline layout!");
-			}
-
-			VkGraphicsPipelineCreateInfo pipeline_info = {};
-			pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-			pipeline_info.stageCount = 2;
-			pipeline_info.pStages = shader_stages;
-			pipeline_info.pVertexInputState = &vertex_input_info;
-			pipeline_info.pInputAssemblyState = &input_assembly_info;
-			pipeline_info.pViewportState = &viewport_info;
-			pipeline_info.pRasterizationState = &rasterizer;
-			pipeline_info.pMultisampleState = &multisampling;
-			pipeline_info.pDepthStencilState = nullptr;
-			pipeline_info.pColorBlendState = &blending;
-			pipeline_info.pDynamicState = nullptr;
-			pipeline_info.layout = m_pipeline_layout;
-			pipeline_info.renderPass = m_renderpass;
-			pipeline_info.subpass = 0; // index of pass
-			pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-
-			if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_pipeline) != VK_SUCCESS)
-			{
-				throw std::runtime_error("failed to create graphics pipeline!");
-			}
-
-			vkDestroyShaderModule(m_device, vertex, nullptr);
-			vkDestroyShaderModule(m_device, fragment, nullptr);
+			// recompile every variant against current render pass
+			m_pipelines.renderpass(m_renderpass, m_samples);
+
+			if (!m_pipelines.ready(m_pipeline))
+			{
+				m_pipeline = m_pipelines.request(default_pipeline_state());
+				m_pipelines.fallback(m_pipeline); // compiled synchronously, first frame needs something to draw with
+			}
 		}
 		void create_renderpass()
 		{
+			PX_PROFILE_FUNCTION();
 			if (m_renderpass != VK_NULL_HANDLE)
 			{
-				vkDestroyRenderPass(m_device, m_renderpass, nullptr);
+				vkDestroyRenderPass(m_device, m_renderpass, m_host_allocator.callbacks());
 			}
 
-			VkAttachmentDescription attachment = {};
-			attachment.format = m_format;
-			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			bool multisampled = m_samples != VK_SAMPLE_COUNT_1_BIT;
+
+			// multisampled color and depth are never stored, resolve writes target within the pass
+			std::vector<VkAttachmentDescription> attachments;
+			VkAttachmentDescription color = {};
+			color.format = m_format;
+			color.samples = m_samples;
+			color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			color.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+			color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			color.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // blitted to swapchain after pass
+			attachments.push_back(color);
+
+			VkAttachmentDescription depth = color;
+			depth.format = m_depth_format;
+			depth.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			attachments.push_back(depth);
+
+			if (multisampled)
+			{
+				VkAttachmentDescription resolve = color;
+				resolve.samples = VK_SAMPLE_COUNT_1_BIT;
+				resolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				resolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				resolve.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				attachments.push_back(resolve);
+			}
 
-			VkAttachmentReference attachment_reference = {};
-			attachment_reference.attachment = 0;
-			attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			VkAttachmentReference color_reference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+			VkAttachmentReference depth_reference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+			VkAttachmentReference resolve_reference = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
 
 			VkSubpassDescription subpass = {};
 			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 			subpass.colorAttachmentCount = 1;
-			subpass.pColorAttachments = &attachment_reference;
-
-			VkSubpassDependency dependency = {};
-			dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependency.dstSubpass = 0;
-			dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependency.srcAccessMask = 0;
-			dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			subpass.pColorAttachments = &color_reference;
+			subpass.pResolveAttachments = multisampled ? &resolve_reference : nullptr;
+			subpass.pDepthStencilAttachment = &depth_reference;
+
+			// target is written after blit of previous frame finished reading, and read by blit after pass
+			std::array<VkSubpassDependency, 2> dependencies = {};
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
 			VkRenderPassCreateInfo renderpass_info = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-			renderpass_info.attachmentCount = 1;
-			renderpass_info.pAttachments = &attachment;
+			renderpass_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+			renderpass_info.pAttachments = attachments.data();
 			renderpass_info.subpassCount = 1;
 			renderpass_info.pSubpasses = &subpass;
-			renderpass_info.dependencyCount = 1;
-			renderpass_info.pDependencies = &dependency;
+			renderpass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+			renderpass_info.pDependencies = dependencies.data();
 
-			if (vkCreateRenderPass(m_device, &renderpass_info, nullptr, &m_renderpass) != VK_SUCCESS)
+			if (vkCreateRenderPass(m_device, &renderpass_info, m_host_allocator.callbacks(), &m_renderpass) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create render pass!");
 			}
 		}
 		void create_framebuffers()
 		{
-			for (size_t i = 0, size = m_swapchain_framebuffers.size(); i != size; ++i)
+			PX_PROFILE_FUNCTION();
+			vkDestroyFramebuffer(m_device, m_framebuffer, m_host_allocator.callbacks());
+
+			// same order as render pass attachments
+			std::vector<VkImageView> attachments;
+			if (m_samples != VK_SAMPLE_COUNT_1_BIT)
 			{
-				vkDestroyFramebuffer(m_device, m_swapchain_framebuffers[i], nullptr);
+				attachments = { m_color.view, m_depth.view, m_target.view };
 			}
-
-			size_t size = m_swapchain_images.size();
-			m_swapchain_framebuffers.resize(size);
-			for (size_t i = 0; i != size; ++i)
+			else
 			{
-				VkImageView attachments[] = { m_image_views[i] };
+				attachments = { m_target.view, m_depth.view };
+			}
 
-				VkFramebufferCreateInfo framebufferInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-				framebufferInfo.renderPass = m_renderpass;
-				framebufferInfo.attachmentCount = 1;
-				framebufferInfo.pAttachments = attachments;
-				framebufferInfo.width = m_extent.width;
-				framebufferInfo.height = m_extent.height;
-				framebufferInfo.layers = 1;
+			VkFramebufferCreateInfo framebufferInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+			framebufferInfo.renderPass = m_renderpass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = m_extent.width;
+			framebufferInfo.height = m_extent.height;
+			framebufferInfo.layers = 1;
 
-				if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_swapchain_framebuffers[i]) != VK_SUCCESS)
-				{
-					throw std::runtime_error("failed to create framebuffer!");
-				}
+			if (vkCreateFramebuffer(m_device, &framebufferInfo, m_host_allocator.callbacks(), &m_framebuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create framebuffer!");
 			}
 		}
 		void create_command_pool()
 		{
-			auto queues = find_queues(m_physical_device);
-
+			PX_PROFILE_FUNCTION();
 			VkCommandPoolCreateInfo pool_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
-			pool_info.queueFamilyIndex = queues.graphics;
-			pool_info.flags = 0;
+			pool_info.queueFamilyIndex = m_profile.queues().graphics;
+			pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // frame command buffers are re-recorded every frame
 
-			if (vkCreateCommandPool(m_device, &pool_info, nullptr, &m_command_pool) != VK_SUCCESS)
+			if (vkCreateCommandPool(m_device, &pool_info, m_host_allocator.callbacks(), &m_command_pool) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create command pool!");
 			}
 		}
-		void create_command_buffers()
+		// command buffer, fence and acquire semaphore for each frame in flight
+		void create_frames()
 		{
-			if (m_command_buffers.size() > 0)
+			PX_PROFILE_FUNCTION();
+			std::array<VkCommandBuffer, frames_in_flight> buffers;
+			VkCommandBufferAllocateInfo info = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			info.commandPool = m_command_pool;
+			info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			info.commandBufferCount = static_cast<uint32_t>(buffers.size());
+			if (vkAllocateCommandBuffers(m_device, &info, buffers.data()) != VK_SUCCESS)
 			{
-				vkFreeCommandBuffers(m_device, m_command_pool, static_cast<uint32_t>(m_command_buffers.size()), m_command_buffers.data());
+				throw std::runtime_error("failed to allocate command buffers!");
 			}
 
-			auto size = m_swapchain_framebuffers.size();
-			m_command_buffers.resize(size);
+			VkSemaphoreCreateInfo semaphore_info{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+			VkFenceCreateInfo fence_info{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+			fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // first wait passes
+			for (size_t i = 0; i != m_frames.size(); ++i)
+			{
+				m_frames[i].commands = buffers[i];
+				m_frames[i].timed = false;
+				m_frames[i].submitted = 0;
+				if (vkCreateSemaphore(m_device, &semaphore_info, m_host_allocator.callbacks(), &m_frames[i].image_available) != VK_SUCCESS
+					|| vkCreateFence(m_device, &fence_info, m_host_allocator.callbacks(), &m_frames[i].fence) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create semaphores!");
+				}
+			}
 
-			VkCommandBufferAllocateInfo info = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-			info.commandPool = m_command_pool;
-			info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			info.commandBufferCount = static_cast<uint32_t>(size);
+			// two timestamps per frame around scene pass, software rasterizers support them too
+			uint32_t valid_bits = m_profile.queue_families()[m_profile.queues().graphics].timestampValidBits;
+			if (valid_bits == 0)
+			{
+				std::cout << "px::renderer - no timestamp support, dynamic resolution disabled" << std::endl;
+				return;
+			}
+			m_timestamp_period = m_profile.limits().timestampPeriod;
+			m_timestamp_mask = valid_bits >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t{ 1 } << valid_bits) - 1;
 
-			if (vkAllocateCommandBuffers(m_device, &info, m_command_buffers.data()) != VK_SUCCESS)
+			VkQueryPoolCreateInfo query_info{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+			query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			query_info.queryCount = frames_in_flight * 2;
+			if (vkCreateQueryPool(m_device, &query_info, m_host_allocator.callbacks(), &m_timestamps) != VK_SUCCESS)
 			{
-				throw std::runtime_error("failed to allocate command buffers!");
+				throw std::runtime_error("px::renderer::create_frames() - failed to create timestamp query pool");
 			}
+		}
 
-			for (size_t i = 0; i != size; ++i)
+		// gpu time of last submission in this slot drives render scale of next frame
+		void scale_resolution(frame const& current)
+		{
+			double budget = m_budget.load();
+			if (budget != m_scaler.budget())
 			{
-				VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-				begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-				begin_info.pInheritanceInfo = nullptr;
+				m_scaler.budget(budget);
+			}
 
-				vkBeginCommandBuffer(m_command_buffers[i], &begin_info);
+			if (current.timed)
+			{
+				uint64_t ticks[2];
+				if (vkGetQueryPoolResults(m_device, m_timestamps, m_frame * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+				{
+					double milliseconds = static_cast<double>((ticks[1] - ticks[0]) & m_timestamp_mask) * m_timestamp_period * 1e-6;
+					uint64_t begin = static_cast<uint64_t>(static_cast<double>(ticks[0] & m_timestamp_mask) * m_timestamp_period);
+					profiler::global().gpu("scene pass", current.submitted, begin, begin + static_cast<uint64_t>(milliseconds * 1e6));
+					double previous = m_scaler.scale();
+					m_scaler.update(milliseconds);
+					m_gpu_time = m_scaler.time();
+					if (m_scaler.scale() != previous)
+					{
+						std::cout << "px::renderer - resolution scale " << m_scaler.scale() << ", gpu " << m_scaler.time() << " ms" << std::endl;
+					}
+				}
+			}
+			double pinned = m_pinned_scale.load();
+			m_scale = pinned > 0 ? std::min(pinned, 1.0) : m_scaler.scale();
+		}
+
+		// scene pass into scaled corner of render target, then upscale to swapchain image
+		void record(frame const& current, uint32_t image_index)
+		{
+			PX_PROFILE_FUNCTION();
+			double scale = m_scale.load();
+			VkExtent2D extent = m_extent;
+			if (m_blit)
+			{
+				extent.width = std::max(1u, static_cast<uint32_t>(m_extent.width * scale + 0.5));
+				extent.height = std::max(1u, static_cast<uint32_t>(m_extent.height * scale + 0.5));
+			}
 
-				VkClearValue clear_color = { 0.0f, 0.0f, 0.0f, 1.0f };
+			VkCommandBuffer commands = current.commands;
+			vkResetCommandBuffer(commands, 0);
 
-				VkRenderPassBeginInfo renderpass_info{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-				renderpass_info.renderPass = m_renderpass;
-				renderpass_info.framebuffer = m_swapchain_framebuffers[i];
-				renderpass_info.renderArea.offset = { 0, 0 }; // should match the size of the attachments
-				renderpass_info.renderArea.extent = m_extent; // for best performance.
-				renderpass_info.clearValueCount = 1;
-				renderpass_info.pClearValues = &clear_color;
+			VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commands, &begin_info);
+			if (m_capture.begin()) // before tilemap layer takes dirty ranges of chunks
+			{
+				m_capture.textures(m_textures);
+				m_capture.tilemap(m_tilemap.map(), m_tilemap.texture(), m_tilemap.columns(), m_tilemap.rows());
+				m_capture.objects(m_sprites.objects(), m_view, m_sprites.capacity());
+				m_capture.frame({ m_view, m_extent.width, m_extent.height, static_cast<float>(scale), static_cast<uint32_t>(m_samples) });
+			}
+			m_compute.acquire(commands, m_frame);
+			m_device_memory.update(); // budget subscribers lower streaming budgets before textures update
+			m_defragmenter.update(commands, m_frame); // moved buffers are rebound before anything records them
+			m_textures.update(commands, m_frame);
+			m_table.update(m_frame, m_textures);
+			m_tilemap.update(commands, m_frame);
+			m_sprites.update(m_frame, m_view);
+			m_readback.update(m_frame);
+
+			if (m_timestamps != VK_NULL_HANDLE)
+			{
+				vkCmdResetQueryPool(commands, m_timestamps, m_frame * 2, 2);
+				vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestamps, m_frame * 2);
+			}
 
-				VkBuffer buffers[] = { m_buffer };
-				VkDeviceSize offsets[] = { 0 };
+			std::array<VkClearValue, 2> clear_values = {};
+			clear_values[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+			clear_values[1].depthStencil = { 1.0f, 0 };
 
-				vkCmdBeginRenderPass(m_command_buffers[i], &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
-				vkCmdBindPipeline(m_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-				vkCmdBindVertexBuffers(m_command_buffers[i], 0, 1, buffers, offsets);
-				vkCmdBindIndexBuffer(m_command_buffers[i], m_index_buffer, 0, VK_INDEX_TYPE_UINT16);
-				vkCmdDrawIndexed(m_command_buffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-				vkCmdEndRenderPass(m_command_buffers[i]);
+			VkRenderPassBeginInfo renderpass_info{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+			renderpass_info.renderPass = m_renderpass;
+			renderpass_info.framebuffer = m_framebuffer;
+			renderpass_info.renderArea.offset = { 0, 0 };
+			renderpass_info.renderArea.extent = extent;
+			renderpass_info.clearValueCount = static_cast<uint32_t>(clear_values.size()); // resolve attachment is not cleared
+			renderpass_info.pClearValues = clear_values.data();
 
-				if (vkEndCommandBuffer(m_command_buffers[i]) != VK_SUCCESS)
+			VkBuffer buffers[] = { m_animation.created() ? m_animation.buffer(m_frame) : m_buffer };
+			VkDeviceSize offsets[] = { 0 };
+
+			VkViewport viewport = {};
+			viewport.x = 0.0f;
+			viewport.y = 0.0f;
+			viewport.width = static_cast<float>(extent.width);
+			viewport.height = static_cast<float>(extent.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+			VkRect2D scissor = { { 0, 0 }, extent };
+
+			vkCmdBeginRenderPass(commands, &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
+			if (m_table.bindless())
+			{
+				m_table.bind(commands, m_pipeline_layout, m_frame, 0); // whole array once per frame, kept across pipelines of the same layout
+			}
+			vkCmdSetViewport(commands, 0, 1, &viewport);
+			vkCmdSetScissor(commands, 0, 1, &scissor);
+			if (m_tilemap.map() != nullptr && m_pipelines.ready(m_tilemap_pipeline)) // fallback has different vertex input, so no substitution
+			{
+				vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines.get(m_tilemap_pipeline));
+				m_tilemap.draw(commands, m_pipeline_layout, m_table, m_frame);
+			}
+			if (m_sprites.attached() && m_pipelines.ready(m_sprite_pipeline))
+			{
+				vk_sprite_layer::push_block camera;
+				camera.scale[0] = 2.0f / (m_view.max_x - m_view.min_x);
+				camera.scale[1] = 2.0f / (m_view.max_y - m_view.min_y);
+				camera.offset[0] = -m_view.min_x * camera.scale[0] - 1.0f;
+				camera.offset[1] = -m_view.min_y * camera.scale[1] - 1.0f;
+				vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines.get(m_sprite_pipeline));
+				m_sprites.draw(commands, m_pipeline_layout, m_table, camera);
+			}
+			vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines.get(m_pipeline));
+			vkCmdBindVertexBuffers(commands, 0, 1, buffers, offsets);
+			vkCmdBindIndexBuffer(commands, m_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+			vkCmdDrawIndexed(commands, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+			vkCmdEndRenderPass(commands);
+
+			if (m_timestamps != VK_NULL_HANDLE)
+			{
+				vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestamps, m_frame * 2 + 1);
+			}
+			m_readback.record(commands, m_frame, m_target.image, m_format, extent);
+
+			if (headless())
+			{
+				if (vkEndCommandBuffer(commands) != VK_SUCCESS)
 				{
 					throw std::runtime_error("failed to record command buffer!");
 				}
+				return;
 			}
-		}
-		void create_semaphores()
-		{
-			VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
 
-			if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_image_available) != VK_SUCCESS ||
-				vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_rendering_finished) != VK_SUCCESS)
+			VkImage image = m_swapchain_images[image_index];
+			transition(commands, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+			VkImageSubresourceLayers layers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			if (m_blit)
+			{
+				VkImageBlit blit{};
+				blit.srcSubresource = layers;
+				blit.srcOffsets[1] = { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 };
+				blit.dstSubresource = layers;
+				blit.dstOffsets[1] = { static_cast<int32_t>(m_extent.width), static_cast<int32_t>(m_extent.height), 1 };
+				vkCmdBlitImage(commands, m_target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, m_filter);
+			}
+			else
+			{
+				VkImageCopy copy{};
+				copy.srcSubresource = layers;
+				copy.dstSubresource = layers;
+				copy.extent = { m_extent.width, m_extent.height, 1 };
+				vkCmdCopyImage(commands, m_target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+			}
+
+			transition(commands, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+
+			if (vkEndCommandBuffer(commands) != VK_SUCCESS)
 			{
-				throw std::runtime_error("failed to create semaphores!");
+				throw std::runtime_error("failed to record command buffer!");
 			}
 		}
+		static void transition(VkCommandBuffer commands, VkImage image, VkImageLayout from, VkImageLayout to, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+		{
+			VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+			barrier.srcAccessMask = src_access;
+			barrier.dstAccessMask = dst_access;
+			barrier.oldLayout = from;
+			barrier.newLayout = to;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(commands, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
 		void create_buffers()
 		{
-			void* data;
+			PX_PROFILE_FUNCTION();
 			VkBuffer staging_buffer;
-			VkDeviceMemory staging_memory;
+			vk_memory::allocation staging_memory;
 
 			// vertices
 			VkDeviceSize vertices_size = static_cast<VkDeviceSize>(sizeof(vertices[0]) * vertices.size());
 
-			create_buffer(vertices_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_memory);
-			vkMapMemory(m_device, staging_memory, 0, vertices_size, 0, &data);
-			std::memcpy(data, vertices.data(), static_cast<size_t>(vertices_size));
-			vkUnmapMemory(m_device, staging_memory);
+			create_buffer(vertices_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vk_memory::category::staging, staging_buffer, staging_memory);
+			std::memcpy(staging_memory.data, vertices.data(), static_cast<size_t>(vertices_size));
 
-			create_buffer(vertices_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_buffer, m_memory);
+			create_buffer(vertices_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_memory::category::vertex, m_buffer, m_memory);
 			copy_buffer(staging_buffer, m_buffer, vertices_size);
+			movable(m_buffer, m_memory, vertices_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 
-			vkDestroyBuffer(m_device, staging_buffer, nullptr);
-			vkFreeMemory(m_device, staging_memory, nullptr);
+			vkDestroyBuffer(m_device, staging_buffer, m_host_allocator.callbacks());
+			m_device_memory.free(staging_memory);
 
 			// indices
 			VkDeviceSize index_size = static_cast<VkDeviceSize>(sizeof(indices[0]) * indices.size());
-			create_buffer(index_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_memory);
-			vkMapMemory(m_device, staging_memory, 0, index_size, 0, &data);
-			std::memcpy(data, indices.data(), static_cast<size_t>(index_size));
-			vkUnmapMemory(m_device, staging_memory);
+			create_buffer(index_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vk_memory::category::staging, staging_buffer, staging_memory);
+			std::memcpy(staging_memory.data, indices.data(), static_cast<size_t>(index_size));
 
-			create_buffer(index_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_index_buffer, m_index_memory);
+			create_buffer(index_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_memory::category::index, m_index_buffer, m_index_memory);
 			copy_buffer(staging_buffer, m_index_buffer, index_size);
+			movable(m_index_buffer, m_index_memory, index_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 
-			vkDestroyBuffer(m_device, staging_buffer, nullptr);
-			vkFreeMemory(m_device, staging_memory, nullptr);
+			vkDestroyBuffer(m_device, staging_buffer, m_host_allocator.callbacks());
+			m_device_memory.free(staging_memory);
 		}
 
-		void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory)
+		void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, vk_memory::category kind, VkBuffer& buffer, vk_memory::allocation& memory)
 		{
 			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
 			buffer_info.size = size;
 			buffer_info.usage = usage;
 			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			if (vkCreateBuffer(m_device, &buffer_info, nullptr, &buffer) != VK_SUCCESS)
+			if (vkCreateBuffer(m_device, &buffer_info, m_host_allocator.callbacks(), &buffer) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create vertex buffer!");
 			}
-
-			VkMemoryRequirements memory_requirements;
-			vkGetBufferMemoryRequirements(m_device, buffer, &memory_requirements);
-
-			VkMemoryAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-			allocate_info.allocationSize = memory_requirements.size;
-			allocate_info.memoryTypeIndex = find_memory(memory_requirements.memoryTypeBits, properties);
-
-			if (vkAllocateMemory(m_device, &allocate_info, nullptr, &memory) != VK_SUCCESS)
+			try
 			{
-				throw std::runtime_error("failed to allocate vertex buffer memory!");
+				memory = m_device_memory.bind(buffer, kind, 0, properties);
 			}
-
-			vkBindBufferMemory(m_device, buffer, memory, 0);
+			catch (...)
+			{
+				vkDestroyBuffer(m_device, buffer, m_host_allocator.callbacks());
+				buffer = VK_NULL_HANDLE;
+				throw;
+			}
+		}
+		// defragmenter may move buffer, it is recreated at new place with the same parameters
+		void movable(VkBuffer & buffer, vk_memory::allocation & memory, VkDeviceSize size, VkBufferUsageFlags usage)
+		{
+			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			buffer_info.size = size;
+			buffer_info.usage = usage;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			m_device_memory.movable(memory, [this, &buffer, &memory, buffer_info](vk_memory::allocation const& moved) {
+				VkBuffer replaced = buffer;
+				buffer = m_device_memory.buffer(buffer_info, moved);
+				memory = moved;
+				return replaced;
+			});
 		}
 		void copy_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size)
 		{
@@ -693,14 +1345,15 @@ namespace px
 		}
 		void reset_swapchain()
 		{
+			PX_PROFILE_FUNCTION();
 			vkDeviceWaitIdle(m_device);
 
 			create_swapchain();
-			create_image_views();
+			create_image_sync();
+			create_attachments();
 			create_renderpass();
 			create_pipeline();
 			create_framebuffers();
-			create_command_buffers();
 		}
 		std::vector<const char*> required_extensions() const
 		{
@@ -722,89 +1375,17 @@ namespace px
 
 			return extensions;
 		}
-		bool suitable(VkPhysicalDevice device) const
-		{
-			VkPhysicalDeviceProperties properties;
-			VkPhysicalDeviceFeatures features;
-			vkGetPhysicalDeviceProperties(device, &properties);
-			vkGetPhysicalDeviceFeatures(device, &features);
-
-			return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
-				&& features.geometryShader
-				&& find_queues(device)
-				&& support_extensions(device)
-				&& swapchain_support(device); // query swapchain support after checking for swapchain extention support
-		}
-		bool support_extensions(VkPhysicalDevice device) const
-		{
-			uint32_t count;
-			vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
-
-			std::vector<VkExtensionProperties> available_extensions(count);
-			vkEnumerateDeviceExtensionProperties(device, nullptr, &count, available_extensions.data());
-
-			std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
-
-			for (const auto& extension : available_extensions)
-			{
-				required_extensions.erase(extension.extensionName);
-			}
-
-			return required_extensions.empty();
-		}
-		queues find_queues(VkPhysicalDevice device) const
-		{
-			uint32_t queue_family_count = 0;
-			vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
-			std::vector<VkQueueFamilyProperties> families(queue_family_count);
-			vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, families.data());
-
-			queues found{ -1, -1 };
-
-			int i = 0;
-			for (const auto& family : families)
-			{
-				VkBool32 presentation = false;
-				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentation);
-
-				if (family.queueCount > 0 && family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-				{
-					found.graphics = i;
-				}
-				if (family.queueCount > 0 && presentation)
-				{
-					found.presentation = i;
-				}
-
-				if (found) break;
-
-				++i;
-			}
-			return found;
-		}
-		swapchain_details swapchain_support(VkPhysicalDevice device) const
+		// hard requirements only, preference between suitable devices is up to ranking
+		bool suitable(vk_device_profile const& profile) const
 		{
-			swapchain_details details;
-
-			vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_surface, &details.capabilities);
-
-			uint32_t format_count;
-			vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &format_count, nullptr);
-			if (format_count != 0)
-			{
-				details.formats.resize(format_count);
-				vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &format_count, details.formats.data());
-			}
-
-			uint32_t mode_count;
-			vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface, &mode_count, nullptr);
-			if (mode_count != 0)
+			if (headless())
 			{
-				details.presentation_modes.resize(mode_count);
-				vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface, &mode_count, details.presentation_modes.data());
+				return profile.queues().graphics >= 0;
 			}
-
-			return details;
+			return profile.queues()
+				&& profile.supports(device_extensions)
+				&& !profile.surface_formats().empty() // swapchain support is queried after checking for swapchain extention support
+				&& !profile.present_modes().empty();
 		}
 		VkSurfaceFormatKHR choose_swapchain_format(std::vector<VkSurfaceFormatKHR> const& available_formats) const
 		{
@@ -823,19 +1404,6 @@ namespace px
 
 			return available_formats[0];
 		}
-		VkPresentModeKHR choose_swapchain_mode(std::vector<VkPresentModeKHR> const& modes) const
-		{
-			VkPresentModeKHR result = VK_PRESENT_MODE_FIFO_KHR;
-			for (const auto& mode : modes)
-			{
-				if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
-				{
-					result = mode;
-					break;
-				}
-			}
-			return result;
-		}
 		VkExtent2D choose_swapchain_extent(VkSurfaceCapabilitiesKHR const& capabilities, uint32_t width, uint32_t height) const
 		{
 			VkExtent2D extent{ width, height };
@@ -855,89 +1423,78 @@ namespace px
 			return extent;
 		}
 
-		static std::vector<char> read_file(std::string const& name)
-		{
-			std::ifstream file(name, std::ios::ate | std::ios::binary);
-
-			if (!file.is_open())
-			{
-				throw std::runtime_error("px::core::renderer::read_file() - failed to open file!");
-			}
-
-			size_t size = static_cast<size_t>(file.tellg());
-			std::vector<char> buffer(size);
-
-			file.seekg(0);
-			file.read(buffer.data(), size);
-
-			file.close();
-
-			return buffer;
-		}
-		VkShaderModule create_shader(std::vector<char> const& code) const
-		{
-			VkShaderModuleCreateInfo create_info = {};
-			create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-			create_info.codeSize = code.size();
-			create_info.pCode = reinterpret_cast<uint32_t const*>(code.data());
-
-			VkShaderModule shader;
-			if (vkCreateShaderModule(m_device, &create_info, nullptr, &shader) != VK_SUCCESS)
-			{
-				throw std::runtime_error("px::core::renderer::create_shader() - failed to create shader module!");
-			}
-			return shader;
-		}
-		uint32_t find_memory(uint32_t filter, VkMemoryPropertyFlags properties)
-		{
-			VkPhysicalDeviceMemoryProperties memory_properties;
-			vkGetPhysicalDeviceMemoryProperties(m_physical_device, &memory_properties);
-
-			for (uint32_t i = 0; i != memory_properties.memoryTypeCount; ++i)
-			{
-				if ((filter & (1 << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
-				{
-					return i;
-				}
-			}
-
-			throw std::runtime_error("failed to find suitable memory type!");
-		}
-
 	private:
+		job_system & m_jobs;
+		present_policy m_policy; // swapchain is created with
+		std::atomic<present_policy> m_requested_policy;
+		std::atomic<double> m_latency; // milliseconds
+		std::atomic<double> m_budget; // milliseconds, requested
+		std::atomic<double> m_scale; // reported
+		std::atomic<double> m_pinned_scale; // zero if scale follows budget
+		std::atomic<double> m_gpu_time; // milliseconds, reported
+		resolution_scaler m_scaler; // render thread
+		vk_host_allocator m_host_allocator; // outlives every vulkan object
 		uint32_t m_width;
 		uint32_t m_height;
 
 		vk_instance m_instance;
 		VkSurfaceKHR m_surface;
-		VkPhysicalDevice m_physical_device;
+		vk_device_profile m_profile;
 		vk_device m_device;
+		vk_memory m_device_memory; // every buffer and image is bound to it
+		vk_defragmenter m_defragmenter;
+		vk_async_compute m_compute;
+		vk_quad_animation m_animation; // default quad vertices written by compute, if enabled
+		vk_texture_cache m_textures;
+		VkDeviceSize m_texture_budget; // before heap pressure lowered it, zero if not lowered
+		vk_texture_table m_table;
+		vk_tilemap_layer m_tilemap;
+		vk_sprite_layer m_sprites;
+		aabb m_view; // world rectangle shown
+		vk_capture m_capture;
+		vk_readback m_readback; // frames copied to host on request
+		bool m_bindless; // descriptor indexing enabled on device
+		VkPhysicalDeviceDescriptorIndexingFeatures m_indexing; // enabled features, chained into device creation
 
 		VkQueue m_graphics_queue;
 		VkQueue m_presentation_queue;
 
 		VkBuffer m_buffer;
-		VkDeviceMemory m_memory;
+		vk_memory::allocation m_memory;
 		VkBuffer m_index_buffer;
-		VkDeviceMemory m_index_memory;
+		vk_memory::allocation m_index_memory;
 
 		VkFormat m_format;
 		VkExtent2D m_extent;
 		VkSwapchainKHR m_swapchain;
 		std::vector<VkImage> m_swapchain_images;
-		std::vector<VkImageView> m_image_views;
+		std::vector<VkSemaphore> m_image_finished; // per swapchain image, waited by presentation
+		std::vector<VkFence> m_image_fences; // fence of frame slot last rendering to image
+
+		render_image m_target; // offscreen scene color at full swapchain extent, resolve destination when multisampled
+		render_image m_color; // multisampled, transient
+		render_image m_depth; // transient
+		VkFormat m_depth_format;
+		VkSampleCountFlagBits m_samples; // effective
+		VkSampleCountFlagBits m_applied_samples; // request attachments were created with
+		std::atomic<VkSampleCountFlagBits> m_requested_samples;
+		VkFramebuffer m_framebuffer;
+		bool m_blit; // scaling blit supported, otherwise copy at full resolution
+		VkFilter m_filter;
 
 		VkRenderPass m_renderpass;
 		VkPipelineLayout m_pipeline_layout;
-		VkPipeline m_pipeline;
-
-		std::vector<VkFramebuffer> m_swapchain_framebuffers;
+		vk_pipeline_registry m_pipelines;
+		uint32_t m_pipeline; // default variant, also fallback
+		uint32_t m_tilemap_pipeline;
+		uint32_t m_sprite_pipeline;
 
 		VkCommandPool m_command_pool;
-		std::vector<VkCommandBuffer> m_command_buffers;
-
-		VkSemaphore m_image_available;
-		VkSemaphore m_rendering_finished;
+		std::array<frame, frames_in_flight> m_frames;
+		uint32_t m_frame; // slot recorded next
+		VkQueryPool m_timestamps; // null if not supported
+		double m_timestamp_period; // nanoseconds per tick
+		uint64_t m_timestamp_mask;
 
 		const std::vector<vertex> vertices = {
 			{ { -0.5f, -0.5f },{ 1.0f, 0.0f, 0.0f } },
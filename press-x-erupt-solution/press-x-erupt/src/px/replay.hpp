@@ -0,0 +1,351 @@
+#pragma once
+
+// headless playback of frames written by vk_capture, each frame is submitted as soon as its slot is free
+// renderer runs without window, so timings hold scene and upload work without presentation and vsync
+// textures are loaded by captured paths in id order, so identifiers in tiles and instances stay valid
+// tile changes are applied to own map before their frame, captured instances are fed to sprite layer in place of scene gather
+// render scale is pinned to the captured one, so dynamic resolution does not change the workload between runs
+// file is played several times, first pass streams textures and compiles pipelines and is reported separately
+
+#include <px/renderer.hpp>
+#include <px/core/job_system.hpp>
+#include <px/core/tilemap.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class replay final
+	{
+	public:
+		// reads whole capture, throws if it is not one or it is truncated
+		void open(std::string const& path)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+			{
+				throw std::runtime_error("px::replay::open() - failed to open " + path);
+			}
+			m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			m_path = path;
+			m_position = 0;
+			if (read<uint32_t>() != vk_capture::magic || read<uint32_t>() != vk_capture::version)
+			{
+				throw std::runtime_error("px::replay::open() - not a capture or unsupported version " + path);
+			}
+			m_start = m_position;
+
+			// frame count and extent of first frame, so renderer is created at captured size
+			m_frames = 0;
+			while (m_position != m_data.size())
+			{
+				vk_capture::record type = read<vk_capture::record>();
+				if (type == vk_capture::record::frame)
+				{
+					vk_capture::frame_state state = read<vk_capture::frame_state>();
+					if (m_frames++ == 0)
+					{
+						m_width = state.width;
+						m_height = state.height;
+					}
+				}
+				else
+				{
+					skip(type);
+				}
+			}
+			if (m_frames == 0)
+			{
+				throw std::runtime_error("px::replay::open() - capture has no frames " + path);
+			}
+		}
+		// plays capture passes times and writes timings of every pass
+		void run(job_system & jobs, uint32_t passes, std::ostream & report)
+		{
+			renderer target(jobs, nullptr, m_width, m_height);
+			m_rendered_width = m_width;
+			m_rendered_height = m_height;
+			report << "px::replay - " << m_path << ", " << m_frames << " frames at " << m_width << "x" << m_height << ", " << passes << " passes" << std::endl;
+			for (uint32_t pass = 0; pass != passes; ++pass)
+			{
+				play(target, jobs);
+				summary(report, pass);
+			}
+		}
+
+	public:
+		replay()
+			: m_position(0)
+			, m_start(0)
+			, m_frames(0)
+			, m_width(0)
+			, m_height(0)
+			, m_rendered_width(0)
+			, m_rendered_height(0)
+			, m_elapsed(0)
+		{
+		}
+
+	private:
+		struct timing
+		{
+			double cpu; // milliseconds from start of frame to return of draw_frame
+			double gpu; // smoothed scene pass milliseconds, zero without timestamps
+		};
+
+	private:
+		void play(renderer & target, job_system & jobs)
+		{
+			m_times.clear();
+			m_position = m_start;
+			m_elapsed = 0;
+			auto begin = std::chrono::steady_clock::now();
+			while (m_position != m_data.size())
+			{
+				vk_capture::record type = read<vk_capture::record>();
+				switch (type)
+				{
+				case vk_capture::record::texture:
+					load(target);
+					break;
+				case vk_capture::record::tilemap:
+					attach(target);
+					break;
+				case vk_capture::record::tiles:
+					tiles();
+					break;
+				case vk_capture::record::objects:
+					objects(target);
+					break;
+				case vk_capture::record::frame:
+					frame(target, read<vk_capture::frame_state>());
+					while (jobs.pump_main())
+					{
+					}
+					break;
+				default:
+					throw std::runtime_error("px::replay::play() - unknown record in " + m_path);
+				}
+			}
+			m_elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		// ids of later passes are loaded already
+		void load(renderer & target)
+		{
+			uint32_t id = read<uint32_t>();
+			std::string path = read_string();
+			if (id < target.textures().size())
+			{
+				return;
+			}
+			if (target.textures().load(path) != id)
+			{
+				throw std::runtime_error("px::replay::load() - texture identifiers diverged from capture at " + path);
+			}
+		}
+		// whole map, residency of tilemap layer starts empty like on first frame of capture
+		void attach(renderer & target)
+		{
+			uint32_t width = read<uint32_t>();
+			uint32_t height = read<uint32_t>();
+			uint32_t atlas = read<uint32_t>();
+			uint32_t columns = read<uint32_t>();
+			uint32_t rows = read<uint32_t>();
+			target.tilemap(nullptr, 0, 0, 0);
+			m_map.reset();
+			if (width == 0)
+			{
+				return;
+			}
+			m_map.reset(new tilemap(width, height));
+			for (uint32_t y = 0; y != m_map->chunks_y(); ++y)
+			{
+				for (uint32_t x = 0; x != m_map->chunks_x(); ++x)
+				{
+					write_tiles(x, y, 0, tilemap::chunk_tiles);
+				}
+			}
+			target.tilemap(m_map.get(), atlas, columns, rows);
+		}
+		void tiles()
+		{
+			uint32_t x = read<uint32_t>();
+			uint32_t y = read<uint32_t>();
+			uint32_t begin = read<uint32_t>();
+			uint32_t end = read<uint32_t>();
+			if (m_map == nullptr || x >= m_map->chunks_x() || y >= m_map->chunks_y() || begin > end || end > tilemap::chunk_tiles)
+			{
+				throw std::runtime_error("px::replay::tiles() - tiles outside of map in " + m_path);
+			}
+			write_tiles(x, y, begin, end);
+		}
+		// tiles of chunk range as captured, padding of chunks past map edge is skipped
+		void write_tiles(uint32_t chunk_x, uint32_t chunk_y, uint32_t begin, uint32_t end)
+		{
+			need((end - begin) * sizeof(tile));
+			for (uint32_t i = begin; i != end; ++i)
+			{
+				tile value = read<tile>();
+				uint32_t x = chunk_x * tilemap::chunk_size + i % tilemap::chunk_size;
+				uint32_t y = chunk_y * tilemap::chunk_size + i / tilemap::chunk_size;
+				if (x < m_map->width() && y < m_map->height())
+				{
+					m_map->set(x, y, value);
+				}
+			}
+		}
+		void objects(renderer & target)
+		{
+			uint32_t count = read<uint32_t>();
+			if (count == vk_capture::detached)
+			{
+				target.objects(nullptr);
+				return;
+			}
+			uint32_t batch_count = read<uint32_t>();
+			need(size_t{ count } * sizeof(scene::instance) + size_t{ batch_count } * sizeof(scene::batch));
+			std::vector<scene::instance> instances(count);
+			std::vector<scene::batch> batches(batch_count);
+			read_array(instances.data(), count);
+			read_array(batches.data(), batch_count);
+			target.objects(std::move(instances), std::move(batches));
+		}
+		void frame(renderer & target, vk_capture::frame_state const& state)
+		{
+			auto start = std::chrono::steady_clock::now();
+			aabb const& view = state.view;
+			target.view(view.min_x, view.min_y, view.max_x - view.min_x, view.max_y - view.min_y);
+			target.samples(static_cast<VkSampleCountFlagBits>(state.samples));
+			target.resolution_scale(state.scale);
+			if (state.width != m_rendered_width || state.height != m_rendered_height)
+			{
+				m_rendered_width = state.width;
+				m_rendered_height = state.height;
+				target.resize(state.width, state.height);
+			}
+			target.draw_frame();
+			m_times.push_back({ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), target.gpu_time() });
+		}
+
+		void summary(std::ostream & report, uint32_t pass)
+		{
+			std::vector<double> cpu;
+			double gpu = 0;
+			for (auto const& current : m_times)
+			{
+				cpu.push_back(current.cpu);
+				gpu += current.gpu;
+			}
+			std::sort(std::begin(cpu), std::end(cpu));
+			auto percentile = [&cpu](double fraction) {
+				return cpu[std::min(cpu.size() - 1, static_cast<size_t>(fraction * cpu.size()))];
+			};
+			report << std::fixed << std::setprecision(3)
+				<< "px::replay - pass " << pass + 1 << (pass == 0 ? " (cold)" : "") << ": " << m_elapsed << " ms, " << cpu.size() * 1000.0 / m_elapsed << " fps"
+				<< ", frame ms median " << percentile(0.5) << " p95 " << percentile(0.95) << " max " << cpu.back()
+				<< ", gpu ms " << gpu / cpu.size() << std::endl;
+			report.unsetf(std::ios::floatfield);
+		}
+
+		template <typename T>
+		T read()
+		{
+			T value;
+			read_array(&value, 1);
+			return value;
+		}
+		template <typename T>
+		void read_array(T * output, size_t count)
+		{
+			need(count * sizeof(T));
+			std::memcpy(output, m_data.data() + m_position, count * sizeof(T));
+			m_position += count * sizeof(T);
+		}
+		std::string read_string()
+		{
+			uint32_t size = read<uint32_t>();
+			need(size);
+			std::string result(m_data.data() + m_position, size);
+			m_position += size;
+			return result;
+		}
+		void need(size_t bytes) const
+		{
+			if (m_data.size() - m_position < bytes)
+			{
+				throw std::runtime_error("px::replay::need() - capture is truncated " + m_path);
+			}
+		}
+		// moves past record payload without applying it
+		void skip(vk_capture::record type)
+		{
+			switch (type)
+			{
+			case vk_capture::record::texture:
+				read<uint32_t>();
+				read_string();
+				break;
+			case vk_capture::record::tilemap:
+			{
+				uint32_t width = read<uint32_t>();
+				uint32_t height = read<uint32_t>();
+				read_array(m_skipped, 3); // atlas, columns, rows
+				size_t chunks = size_t{ (width + tilemap::chunk_size - 1) / tilemap::chunk_size } * ((height + tilemap::chunk_size - 1) / tilemap::chunk_size);
+				need(chunks * tilemap::chunk_tiles * sizeof(tile));
+				m_position += chunks * tilemap::chunk_tiles * sizeof(tile);
+				break;
+			}
+			case vk_capture::record::tiles:
+			{
+				read_array(m_skipped, 2); // chunk coordinates
+				uint32_t begin = read<uint32_t>();
+				uint32_t end = read<uint32_t>();
+				need((end - begin) * sizeof(tile));
+				m_position += (end - begin) * sizeof(tile);
+				break;
+			}
+			case vk_capture::record::objects:
+			{
+				uint32_t count = read<uint32_t>();
+				if (count != vk_capture::detached)
+				{
+					uint32_t batches = read<uint32_t>();
+					size_t bytes = size_t{ count } * sizeof(scene::instance) + size_t{ batches } * sizeof(scene::batch);
+					need(bytes);
+					m_position += bytes;
+				}
+				break;
+			}
+			default:
+				throw std::runtime_error("px::replay::skip() - unknown record in " + m_path);
+			}
+		}
+
+	private:
+		std::string m_path;
+		std::vector<char> m_data; // whole file
+		size_t m_position; // read offset
+		size_t m_start; // first record
+		uint32_t m_frames;
+		uint32_t m_width; // extent of first frame
+		uint32_t m_height;
+
+		std::unique_ptr<tilemap> m_map; // current map of playback
+		uint32_t m_rendered_width;
+		uint32_t m_rendered_height;
+		uint32_t m_skipped[3]; // fields read past
+		std::vector<timing> m_times; // of current pass
+		double m_elapsed; // milliseconds of current pass
+	};
+}
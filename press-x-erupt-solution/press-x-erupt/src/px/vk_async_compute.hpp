@@ -0,0 +1,282 @@
+// name: vk_async_compute
+// type: c++ header
+// desc: compute passes submitted to dedicated queue ahead of graphics
+// auth: is0urce
+
+#pragma once
+
+// every frame slot has own compute command buffer and semaphore, graphics submission of the same slot waits on it
+// compute of next frame is submitted while graphics of current frame can be still executing, so they overlap on device
+// buffers written by compute and read by graphics are shared by recorder, which emits queue family release barriers
+// graphics side emits matching acquire barriers before first use
+// ownership is not returned to compute, passes have to overwrite shared buffers fully (previous content is undefined)
+// without dedicated family the graphics queue is used, barriers are plain memory dependencies then
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	class vk_async_compute final
+	{
+	public:
+		class recorder
+		{
+		public:
+			VkCommandBuffer commands() const noexcept
+			{
+				return m_commands;
+			}
+			uint32_t slot() const noexcept
+			{
+				return m_slot;
+			}
+			// buffer range written by compute, read by graphics at given stages with given access
+			void share(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags compute_access, VkAccessFlags graphics_access, VkPipelineStageFlags graphics_stages)
+			{
+				m_shared.push_back({ buffer, offset, size, compute_access, graphics_access, graphics_stages });
+			}
+
+		public:
+			recorder(VkCommandBuffer commands, uint32_t slot) noexcept
+				: m_commands(commands)
+				, m_slot(slot)
+			{
+			}
+
+		private:
+			friend class vk_async_compute;
+			struct shared_range
+			{
+				VkBuffer buffer;
+				VkDeviceSize offset;
+				VkDeviceSize size;
+				VkAccessFlags compute_access;
+				VkAccessFlags graphics_access;
+				VkPipelineStageFlags graphics_stages;
+			};
+
+		private:
+			VkCommandBuffer m_commands;
+			uint32_t m_slot;
+			std::vector<shared_range> m_shared;
+		};
+		typedef std::function<void(recorder &)> pass_fn;
+
+	public:
+		// separate queue family, so compute runs concurrently with graphics
+		bool async() const noexcept
+		{
+			return m_compute_family != m_graphics_family;
+		}
+		VkQueue queue() const noexcept
+		{
+			return m_queue;
+		}
+
+		// passes are recorded in order every frame, add from render thread only
+		void add(pass_fn pass)
+		{
+			m_passes.push_back(pass);
+		}
+		bool empty() const noexcept
+		{
+			return m_passes.empty();
+		}
+
+		// records and submits passes of slot, slot must not be in use by device
+		// returns semaphore graphics submission of this slot has to wait on, null if there was nothing to do
+		VkSemaphore submit(uint32_t slot)
+		{
+			slot_data & current = m_slots[slot];
+			current.shared.clear();
+			current.wait_stages = 0;
+			if (m_passes.empty())
+			{
+				return VK_NULL_HANDLE;
+			}
+
+			vkResetCommandBuffer(current.commands, 0);
+			VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(current.commands, &begin_info);
+
+			recorder context(current.commands, slot);
+			for (auto & pass : m_passes)
+			{
+				pass(context);
+			}
+			current.shared = std::move(context.m_shared);
+
+			// release half of ownership transfer
+			if (async() && !current.shared.empty())
+			{
+				std::vector<VkBufferMemoryBarrier> barriers;
+				for (auto const& range : current.shared)
+				{
+					barriers.push_back(barrier(range, range.compute_access, 0));
+				}
+				vkCmdPipelineBarrier(current.commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+			}
+
+			if (vkEndCommandBuffer(current.commands) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_async_compute::submit() - failed to record compute command buffer");
+			}
+
+			VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &current.commands;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = &current.finished;
+			if (vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_async_compute::submit() - failed to submit compute command buffer");
+			}
+
+			for (auto const& range : current.shared)
+			{
+				current.wait_stages |= range.graphics_stages;
+			}
+			if (current.wait_stages == 0)
+			{
+				current.wait_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // nothing declared, so nothing graphics does may start before
+			}
+			return current.finished;
+		}
+
+		// stages graphics submission waits on compute semaphore of slot
+		VkPipelineStageFlags wait_stages(uint32_t slot) const noexcept
+		{
+			return m_slots[slot].wait_stages;
+		}
+
+		// acquire half of ownership transfer, recorded into graphics command buffer of the same slot before shared buffers are used
+		void acquire(VkCommandBuffer graphics, uint32_t slot) const
+		{
+			auto const& shared = m_slots[slot].shared;
+			if (!async() || shared.empty())
+			{
+				return; // same queue, semaphore already makes writes visible
+			}
+
+			std::vector<VkBufferMemoryBarrier> barriers;
+			VkPipelineStageFlags stages = 0;
+			for (auto const& range : shared)
+			{
+				barriers.push_back(barrier(range, 0, range.graphics_access));
+				stages |= range.graphics_stages;
+			}
+			vkCmdPipelineBarrier(graphics, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, stages, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+		}
+
+		void create(VkDevice device, uint32_t compute_family, uint32_t graphics_family, uint32_t slots, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_compute_family = compute_family;
+			m_graphics_family = graphics_family;
+			vkGetDeviceQueue(m_device, m_compute_family, 0, &m_queue);
+
+			VkCommandPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+			pool_info.queueFamilyIndex = m_compute_family;
+			pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			if (vkCreateCommandPool(m_device, &pool_info, m_allocator, &m_pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_async_compute::create() - failed to create command pool");
+			}
+
+			m_slots.resize(slots);
+			std::vector<VkCommandBuffer> buffers(slots);
+			VkCommandBufferAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			allocate_info.commandPool = m_pool;
+			allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocate_info.commandBufferCount = slots;
+			if (vkAllocateCommandBuffers(m_device, &allocate_info, buffers.data()) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_async_compute::create() - failed to allocate command buffers");
+			}
+
+			VkSemaphoreCreateInfo semaphore_info{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+			for (uint32_t i = 0; i != slots; ++i)
+			{
+				m_slots[i].commands = buffers[i];
+				if (vkCreateSemaphore(m_device, &semaphore_info, m_allocator, &m_slots[i].finished) != VK_SUCCESS)
+				{
+					throw std::runtime_error("px::vk_async_compute::create() - failed to create semaphore");
+				}
+			}
+		}
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			for (auto const& current : m_slots)
+			{
+				vkDestroySemaphore(m_device, current.finished, m_allocator);
+			}
+			m_slots.clear();
+			vkDestroyCommandPool(m_device, m_pool, m_allocator); // frees command buffers
+			m_pool = VK_NULL_HANDLE;
+			m_queue = VK_NULL_HANDLE;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_async_compute() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_queue(VK_NULL_HANDLE)
+			, m_pool(VK_NULL_HANDLE)
+			, m_compute_family(0)
+			, m_graphics_family(0)
+		{
+		}
+		vk_async_compute(vk_async_compute const&) = delete;
+		vk_async_compute& operator=(vk_async_compute const&) = delete;
+		~vk_async_compute()
+		{
+			release();
+		}
+
+	private:
+		struct slot_data
+		{
+			VkCommandBuffer commands = VK_NULL_HANDLE;
+			VkSemaphore finished = VK_NULL_HANDLE;
+			VkPipelineStageFlags wait_stages = 0;
+			std::vector<recorder::shared_range> shared; // submitted and not yet acquired by graphics
+		};
+
+	private:
+		VkBufferMemoryBarrier barrier(recorder::shared_range const& range, VkAccessFlags src_access, VkAccessFlags dst_access) const noexcept
+		{
+			VkBufferMemoryBarrier result{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+			result.srcAccessMask = src_access;
+			result.dstAccessMask = dst_access;
+			result.srcQueueFamilyIndex = m_compute_family;
+			result.dstQueueFamilyIndex = m_graphics_family;
+			result.buffer = range.buffer;
+			result.offset = range.offset;
+			result.size = range.size;
+			return result;
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		VkQueue m_queue;
+		VkCommandPool m_pool;
+		uint32_t m_compute_family;
+		uint32_t m_graphics_family;
+		std::vector<slot_data> m_slots;
+		std::vector<pass_fn> m_passes;
+	};
+}
@@ -0,0 +1,321 @@
+// name: vk_capture
+// type: c++ header
+// desc: window of frames submitted by renderer serialized into binary file for offline replay
+// auth: is0urce
+
+#pragma once
+
+// file is header and sequence of records, resources and uploads of frame go first and frame record closes it
+// resources - texture paths by id, whole tilemap when capture starts or other map is attached
+// uploads - tiles changed since previous frame, instances gathered for sprite layer when they differ from previous frame
+// draw stream - view, extent, render scale and sample count, renderer records the same commands from them on replay
+// changed tiles are found in dirty ranges of chunks compared against shadow copy, so capture does not depend on uploads of layer
+// values are written in host byte order, file is read back on machine of the same architecture
+// file is written on render thread, capture is diagnostic tool and frames it covers are slower
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_texture_cache.hpp"
+#include <px/core/scene.hpp>
+#include <px/core/tilemap.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class vk_capture final
+	{
+	public:
+		enum class record : uint32_t
+		{
+			texture = 1, // id, path
+			tilemap, // width, height, atlas, columns, rows, tiles of every chunk, zero width detaches
+			tiles, // chunk x, chunk y, begin, end, tiles of range
+			objects, // instance count, batch count, instances, batches, detached count detaches
+			frame // frame_state
+		};
+		struct frame_state
+		{
+			aabb view; // world rectangle
+			uint32_t width; // swapchain extent
+			uint32_t height;
+			float scale; // render resolution per axis
+			uint32_t samples;
+		};
+
+	public:
+		static const uint32_t magic = 0x50435850; // "PXCP"
+		static const uint32_t version = 1;
+		static const uint32_t detached = 0xffffffff;
+
+	public:
+		// capture of next frames count, starts with next frame recorded, ignored while capture runs
+		// safe to call from any thread
+		void request(std::string path, uint32_t frames)
+		{
+			bool idle = false;
+			if (frames == 0 || !m_active.compare_exchange_strong(idle, true))
+			{
+				return;
+			}
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending = std::move(path);
+			m_pending_frames = frames;
+			m_requested.store(true, std::memory_order_release);
+		}
+		// running or requested
+		bool active() const noexcept
+		{
+			return m_active.load();
+		}
+
+		// opens requested file, true if frame being recorded is captured, render thread only
+		bool begin()
+		{
+			if (m_file.is_open())
+			{
+				return true;
+			}
+			if (!m_requested.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_path = std::move(m_pending);
+				m_remaining = m_pending_frames;
+				m_requested = false;
+			}
+			m_file.open(m_path, std::ios::binary | std::ios::trunc);
+			if (!m_file)
+			{
+				std::cout << "px::vk_capture - failed to open " << m_path << std::endl;
+				m_active = false;
+				return false;
+			}
+			m_frames = 0;
+			m_textures = 0;
+			m_map = nullptr;
+			m_objects = false;
+			write(uint32_t{ magic });
+			write(uint32_t{ version });
+			std::cout << "px::vk_capture - capturing " << m_remaining << " frames to " << m_path << std::endl;
+			return true;
+		}
+		// paths of textures loaded since previous frame
+		void textures(vk_texture_cache const& cache)
+		{
+			for (; m_textures != cache.size(); ++m_textures)
+			{
+				std::string const& path = cache.path(m_textures);
+				write(record::texture);
+				write(m_textures);
+				write(static_cast<uint32_t>(path.size()));
+				m_file.write(path.data(), path.size());
+			}
+		}
+		// whole map when it changes, afterwards tiles of dirty ranges which differ from shadow copy
+		void tilemap(px::tilemap const* map, uint32_t atlas, uint32_t columns, uint32_t rows)
+		{
+			if (map == nullptr)
+			{
+				if (m_map != nullptr)
+				{
+					write(record::tilemap);
+					write_map(0, 0, 0, 0, 0);
+				}
+				m_map = nullptr;
+				return;
+			}
+			if (map != m_map || atlas != m_atlas || columns != m_columns || rows != m_rows)
+			{
+				m_map = map;
+				m_atlas = atlas;
+				m_columns = columns;
+				m_rows = rows;
+				m_shadow.clear();
+				for (uint32_t y = 0; y != map->chunks_y(); ++y)
+				{
+					for (uint32_t x = 0; x != map->chunks_x(); ++x)
+					{
+						auto const& tiles = map->at(x, y).tiles;
+						m_shadow.insert(std::end(m_shadow), std::begin(tiles), std::end(tiles));
+					}
+				}
+				write(record::tilemap);
+				write_map(map->width(), map->height(), atlas, columns, rows);
+				m_file.write(reinterpret_cast<char const*>(m_shadow.data()), m_shadow.size() * sizeof(tile));
+				return;
+			}
+			for (uint32_t y = 0; y != map->chunks_y(); ++y)
+			{
+				for (uint32_t x = 0; x != map->chunks_x(); ++x)
+				{
+					diff(*map, x, y);
+				}
+			}
+		}
+		// instances sprite layer draws in frame, gathered again into own buffer, written only if they changed
+		void objects(scene * objects, aabb const& view, uint32_t capacity)
+		{
+			if (objects == nullptr)
+			{
+				if (m_objects)
+				{
+					write(record::objects);
+					write(uint32_t{ detached });
+				}
+				m_objects = false;
+				return;
+			}
+			m_gathered.resize(capacity);
+			uint32_t count = objects->gather(view, m_gathered.data(), capacity, m_gathered_batches);
+			m_gathered.resize(count);
+			bool same = m_objects && count == m_instances.size() && m_gathered_batches.size() == m_batches.size()
+				&& std::memcmp(m_gathered.data(), m_instances.data(), count * sizeof(scene::instance)) == 0
+				&& std::memcmp(m_gathered_batches.data(), m_batches.data(), m_batches.size() * sizeof(scene::batch)) == 0;
+			m_instances.swap(m_gathered);
+			m_batches.swap(m_gathered_batches);
+			m_objects = true;
+			if (same)
+			{
+				return;
+			}
+			write(record::objects);
+			write(count);
+			write(static_cast<uint32_t>(m_batches.size()));
+			m_file.write(reinterpret_cast<char const*>(m_instances.data()), m_instances.size() * sizeof(scene::instance));
+			m_file.write(reinterpret_cast<char const*>(m_batches.data()), m_batches.size() * sizeof(scene::batch));
+		}
+		// closes frame, file is finished after requested count of frames
+		void frame(frame_state const& state)
+		{
+			write(record::frame);
+			write(state);
+			++m_frames;
+			if (--m_remaining == 0)
+			{
+				finish();
+			}
+		}
+
+	public:
+		vk_capture()
+			: m_active(false)
+			, m_requested(false)
+			, m_pending_frames(0)
+			, m_remaining(0)
+			, m_frames(0)
+			, m_textures(0)
+			, m_map(nullptr)
+			, m_atlas(0)
+			, m_columns(0)
+			, m_rows(0)
+			, m_objects(false)
+		{
+		}
+		vk_capture(vk_capture const&) = delete;
+		vk_capture& operator=(vk_capture const&) = delete;
+		~vk_capture()
+		{
+			if (m_file.is_open())
+			{
+				finish();
+			}
+		}
+
+	private:
+		template <typename T>
+		void write(T const& value)
+		{
+			m_file.write(reinterpret_cast<char const*>(&value), sizeof(T));
+		}
+		void write_map(uint32_t width, uint32_t height, uint32_t atlas, uint32_t columns, uint32_t rows)
+		{
+			write(width);
+			write(height);
+			write(atlas);
+			write(columns);
+			write(rows);
+		}
+		// narrowest range of dirty tiles differing from shadow, chunk may stay dirty for frames until layer uploads it
+		void diff(px::tilemap const& map, uint32_t x, uint32_t y)
+		{
+			px::tilemap::chunk const& current = map.at(x, y);
+			if (current.dirty_begin == current.dirty_end)
+			{
+				return;
+			}
+			tile * shadow = m_shadow.data() + (size_t{ y } * map.chunks_x() + x) * px::tilemap::chunk_tiles;
+			uint32_t begin = current.dirty_begin;
+			uint32_t end = current.dirty_end;
+			while (begin != end && shadow[begin] == current.tiles[begin])
+			{
+				++begin;
+			}
+			while (end != begin && shadow[end - 1] == current.tiles[end - 1])
+			{
+				--end;
+			}
+			if (begin == end)
+			{
+				return;
+			}
+			std::copy(std::begin(current.tiles) + begin, std::begin(current.tiles) + end, shadow + begin);
+			write(record::tiles);
+			write(x);
+			write(y);
+			write(begin);
+			write(end);
+			m_file.write(reinterpret_cast<char const*>(shadow + begin), (end - begin) * sizeof(tile));
+		}
+		void finish()
+		{
+			std::streamoff size = m_file.tellp();
+			m_file.close();
+			if (m_file.fail() || size < 0)
+			{
+				std::cout << "px::vk_capture - failed to write " << m_path << std::endl;
+			}
+			else
+			{
+				std::cout << "px::vk_capture - " << m_frames << " frames, " << size / 1024 << " kb written to " << m_path << std::endl;
+			}
+			m_file.clear();
+			m_active = false;
+		}
+
+	private:
+		std::atomic<bool> m_active; // requested or running
+		std::atomic<bool> m_requested; // pending request is set
+		std::mutex m_mutex; // pending request
+		std::string m_pending;
+		uint32_t m_pending_frames;
+
+		std::ofstream m_file; // render thread from here on
+		std::string m_path;
+		uint32_t m_remaining; // frames
+		uint32_t m_frames; // written
+		uint32_t m_textures; // paths written
+
+		px::tilemap const* m_map; // written, null if none
+		uint32_t m_atlas;
+		uint32_t m_columns;
+		uint32_t m_rows;
+		std::vector<tile> m_shadow; // tiles as written, chunk after chunk
+
+		bool m_objects; // instances written
+		std::vector<scene::instance> m_instances; // as written
+		std::vector<scene::batch> m_batches;
+		std::vector<scene::instance> m_gathered;
+		std::vector<scene::batch> m_gathered_batches;
+	};
+}
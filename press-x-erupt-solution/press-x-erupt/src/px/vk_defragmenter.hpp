@@ -0,0 +1,354 @@
+// name: vk_defragmenter
+// type: c++ header
+// desc: incremental compaction of device memory blocks by gpu copies in frame command buffers
+// auth: is0urce
+
+#pragma once
+
+// sparsest block of linear category whose allocations are all movable is drained into holes of other blocks of its pool
+// few moves per frame within byte and time budget, copies go between transfer buffers aliasing whole blocks
+// owner rebinds its buffer in relocation callback, so commands recorded later in the frame use new location
+// old allocations, replaced buffers and aliases are freed when frame slot of the move comes around, emptied block goes back to driver with last of them
+// images are not moved, texture rebuilds of streaming cache already reallocate them
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <ostream>
+#include <vector>
+
+namespace px
+{
+	class vk_defragmenter final
+	{
+	public:
+		// limits of moves recorded per frame
+		void budget(VkDeviceSize bytes, double milliseconds) noexcept
+		{
+			m_bytes = bytes;
+			m_time = milliseconds;
+		}
+		// blocks used less than fraction are drained
+		void threshold(float fraction) noexcept
+		{
+			m_threshold = fraction;
+		}
+		// counters are atomic, safe to call from any thread
+		void report(std::ostream & stream) const
+		{
+			stream << "px::vk_defragmenter - " << m_moves.load() << " moves, " << m_moved.load() / 1024 << " kb moved, " << m_drained.load() << " blocks drained" << std::endl;
+		}
+
+		// records moves into frame command buffer before anything using moved buffers, fence of slot must be waited
+		void update(VkCommandBuffer commands, uint32_t slot)
+		{
+			retire(slot);
+			++m_frame;
+			if (m_source == nullptr && m_frame % check_frames == 0)
+			{
+				pick();
+			}
+			if (m_source == nullptr)
+			{
+				return;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			VkDeviceSize bytes = 0;
+			bool recorded = false;
+			while (m_source != nullptr && bytes < m_bytes && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < m_time)
+			{
+				move current;
+				if (!plan(current))
+				{
+					break;
+				}
+				VkBuffer source = alias(*current.from.owner, slot);
+				VkBuffer target = alias(*current.to.owner, slot);
+				if (source == VK_NULL_HANDLE || target == VK_NULL_HANDLE)
+				{
+					cancel(current, slot);
+					break;
+				}
+				if (!recorded)
+				{
+					barrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+					recorded = true;
+				}
+				VkBufferCopy copy{ current.from.offset, current.to.offset, current.from.size };
+				vkCmdCopyBuffer(commands, source, target, 1, &copy);
+
+				VkBuffer replaced;
+				try
+				{
+					replaced = current.relocate(current.to);
+				}
+				catch (std::exception const& e)
+				{
+					std::cout << "px::vk_defragmenter - owner failed to rebind moved buffer, " << e.what() << std::endl;
+					cancel(current, slot);
+					break;
+				}
+				m_retired[slot].push_back({ current.from, replaced });
+				bytes += current.from.size;
+				++m_moves;
+			}
+			m_moved += bytes;
+			if (recorded)
+			{
+				barrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+			}
+		}
+
+		void create(VkDevice device, vk_memory & memory, uint32_t slots, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_memory = &memory;
+			m_retired.resize(slots);
+			m_aliases.resize(slots);
+		}
+		// device must be idle
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			for (uint32_t slot = 0; slot != m_retired.size(); ++slot)
+			{
+				retire(slot);
+			}
+			m_retired.clear();
+			m_aliases.clear();
+			m_source = nullptr;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_defragmenter() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_memory(nullptr)
+			, m_source(nullptr)
+			, m_bytes(4 * 1024 * 1024)
+			, m_time(0.5)
+			, m_threshold(0.5f)
+			, m_frame(0)
+			, m_moves(0)
+			, m_moved(0)
+			, m_drained(0)
+		{
+		}
+		vk_defragmenter(vk_defragmenter const&) = delete;
+		vk_defragmenter& operator=(vk_defragmenter const&) = delete;
+		~vk_defragmenter()
+		{
+			release();
+		}
+
+	private:
+		typedef vk_memory::block block;
+
+		struct move
+		{
+			vk_memory::allocation from;
+			vk_memory::allocation to;
+			vk_memory::relocate_fn relocate;
+		};
+		struct retired
+		{
+			vk_memory::allocation memory;
+			VkBuffer buffer; // replaced by owner
+		};
+		struct alias_buffer
+		{
+			block const* target;
+			VkBuffer buffer;
+		};
+
+	private:
+		static const uint64_t check_frames = 60; // between searches for sparse block
+
+	private:
+		// sparsest block below threshold, all of its allocations movable and fitting into free space of its pool
+		void pick()
+		{
+			std::lock_guard<std::mutex> lock(m_memory->m_mutex);
+			block * found = nullptr;
+			for (auto const& current : m_memory->m_pools)
+			{
+				VkDeviceSize free = 0;
+				for (auto const& candidate : current.blocks)
+				{
+					free += candidate->dedicated ? 0 : candidate->size - candidate->used;
+				}
+				for (auto const& candidate : current.blocks)
+				{
+					block & tested = *candidate;
+					bool sparse = tested.used < tested.size * m_threshold;
+					bool movable = tested.allocations != 0 && tested.movables.size() == tested.allocations;
+					bool room = free - (tested.size - tested.used) >= tested.used;
+					if (!tested.dedicated && current.blocks.size() > 1 && sparse && movable && room
+						&& (found == nullptr || tested.used * found->size < found->used * tested.size))
+					{
+						found = &tested;
+					}
+				}
+			}
+			if (found != nullptr)
+			{
+				found->draining = true;
+				m_source = found;
+				std::cout << "px::vk_defragmenter - draining " << vk_memory::name(found->kind) << " block, " << found->used / 1024 << " of " << found->size / 1024 << " kb used" << std::endl;
+			}
+		}
+		// takes last movable allocation of source and room for it elsewhere, source is done when nothing is left
+		bool plan(move & result)
+		{
+			std::lock_guard<std::mutex> lock(m_memory->m_mutex);
+			if (!alive())
+			{
+				m_source = nullptr; // owners freed everything, block is gone
+				return false;
+			}
+			if (m_source->movables.empty())
+			{
+				finish(false);
+				return false;
+			}
+			block::movable & last = m_source->movables.back();
+			result.from = { m_source->memory, last.offset, last.size, last.alignment, m_source->data != nullptr ? m_source->data + last.offset : nullptr, m_source };
+			if (!m_memory->place(*m_source, last.size, last.alignment, result.to))
+			{
+				finish(true);
+				return false;
+			}
+			result.relocate = std::move(last.relocate);
+			m_source->movables.pop_back();
+			result.to.owner->movables.push_back({ result.to.offset, result.to.size, result.to.alignment, result.relocate });
+			return true;
+		}
+		// undoes planned move which could not be recorded or rebound, allocation stays at source
+		// target is retired with slot, copy into it may be recorded already
+		void cancel(move & planned, uint32_t slot)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_memory->m_mutex);
+				auto & targets = planned.to.owner->movables;
+				targets.erase(std::remove_if(std::begin(targets), std::end(targets), [&planned](block::movable const& current) { return current.offset == planned.to.offset; }), std::end(targets));
+				m_source->movables.push_back({ planned.from.offset, planned.from.size, planned.from.alignment, std::move(planned.relocate) });
+				finish(true);
+			}
+			m_retired[slot].push_back({ planned.to, VK_NULL_HANDLE });
+		}
+		// drained block stays closed for allocations until last retired allocation frees it
+		void finish(bool failed)
+		{
+			if (failed)
+			{
+				m_source->draining = false;
+			}
+			else
+			{
+				++m_drained;
+			}
+			m_source = nullptr;
+		}
+		// address of destroyed block may be reused, but new block is not draining
+		bool alive() const noexcept
+		{
+			for (auto const& current : m_memory->m_pools)
+			{
+				for (auto const& candidate : current.blocks)
+				{
+					if (candidate.get() == m_source)
+					{
+						return m_source->draining;
+					}
+				}
+			}
+			return false;
+		}
+
+		// transfer buffer over whole block, created once per slot and block
+		VkBuffer alias(block const& target, uint32_t slot)
+		{
+			for (auto const& current : m_aliases[slot])
+			{
+				if (current.target == &target)
+				{
+					return current.buffer;
+				}
+			}
+
+			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			buffer_info.size = target.size;
+			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VkBuffer result;
+			if (vkCreateBuffer(m_device, &buffer_info, m_allocator, &result) != VK_SUCCESS)
+			{
+				return VK_NULL_HANDLE;
+			}
+			VkMemoryRequirements requirements;
+			vkGetBufferMemoryRequirements(m_device, result, &requirements);
+			if ((requirements.memoryTypeBits & (1 << target.type)) == 0 || requirements.size > target.size || vkBindBufferMemory(m_device, result, target.memory, 0) != VK_SUCCESS)
+			{
+				vkDestroyBuffer(m_device, result, m_allocator);
+				std::cout << "px::vk_defragmenter - block can not be aliased for transfer" << std::endl;
+				return VK_NULL_HANDLE;
+			}
+			m_aliases[slot].push_back({ &target, result });
+			return result;
+		}
+		static void barrier(VkCommandBuffer commands, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkAccessFlags dst_access)
+		{
+			VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+			barrier.srcAccessMask = src_access;
+			barrier.dstAccessMask = dst_access;
+			vkCmdPipelineBarrier(commands, src_stage, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+		// aliases go first, freeing last old allocation may free their block
+		void retire(uint32_t slot) noexcept
+		{
+			for (auto const& current : m_aliases[slot])
+			{
+				vkDestroyBuffer(m_device, current.buffer, m_allocator);
+			}
+			m_aliases[slot].clear();
+			for (auto & current : m_retired[slot])
+			{
+				vkDestroyBuffer(m_device, current.buffer, m_allocator);
+				m_memory->free(current.memory);
+			}
+			m_retired[slot].clear();
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_memory * m_memory;
+
+		block * m_source; // being drained, null if none
+		std::vector<std::vector<retired>> m_retired; // per frame slot
+		std::vector<std::vector<alias_buffer>> m_aliases; // per frame slot
+
+		VkDeviceSize m_bytes; // per frame
+		double m_time; // milliseconds per frame
+		float m_threshold;
+		uint64_t m_frame;
+		std::atomic<uint64_t> m_moves;
+		std::atomic<uint64_t> m_moved; // bytes
+		std::atomic<uint64_t> m_drained; // blocks
+	};
+}
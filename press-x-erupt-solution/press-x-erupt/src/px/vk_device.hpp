@@ -20,17 +20,25 @@ namespace px
 		{
 			return m_device;
 		}
+		// host allocator device was created with, null for default
+		VkAllocationCallbacks const* allocator() const noexcept
+		{
+			return m_allocator;
+		}
 		void release() noexcept
 		{
 			if (m_device != VK_NULL_HANDLE)
 			{
-				vkDestroyDevice(m_device, nullptr);
+				vkDestroyDevice(m_device, m_allocator);
 				m_device = VK_NULL_HANDLE;
 			}
 		}
-		void create(VkPhysicalDevice physical, std::vector<int> const& queues, uint32_t layer_count, const char* const* layers, uint32_t extension_count, const char* const* extensions)
+		// features must be subset of supported ones, next chains feature structures of extensions
+		// allocator receives host memory of device, has to outlive it
+		void create(VkPhysicalDevice physical, std::vector<int> const& queues, uint32_t layer_count, const char* const* layers, uint32_t extension_count, const char* const* extensions, VkPhysicalDeviceFeatures const& features = {}, void const* next = nullptr, VkAllocationCallbacks const* allocator = nullptr)
 		{
 			release();
+			m_allocator = allocator;
 
 			std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 			float queue_priority = 1.0f;
@@ -44,18 +52,17 @@ namespace px
 				queue_create_infos.push_back(queue_create_info);
 			}
 
-			VkPhysicalDeviceFeatures device_features{}; // request no additional features
-
 			VkDeviceCreateInfo create_info{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+			create_info.pNext = next;
 			create_info.pQueueCreateInfos = queue_create_infos.data();
 			create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
-			create_info.pEnabledFeatures = &device_features;
+			create_info.pEnabledFeatures = &features;
 			create_info.enabledLayerCount = layer_count;
 			create_info.ppEnabledLayerNames = layers;
 			create_info.enabledExtensionCount = extension_count;
 			create_info.ppEnabledExtensionNames = extensions;
 
-			if (vkCreateDevice(physical, &create_info, nullptr, &m_device) != VK_SUCCESS)
+			if (vkCreateDevice(physical, &create_info, m_allocator, &m_device) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create logical device!");
 			}
@@ -64,6 +71,7 @@ namespace px
 	public:
 		vk_device() noexcept
 			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
 		{
 		}
 		vk_device(VkPhysicalDevice physical, std::vector<int> const& queues, uint32_t layer_count, const char* const* layers, uint32_t extension_count, const char* const* extensions)
@@ -77,10 +85,12 @@ namespace px
 			: vk_device()
 		{
 			std::swap(m_device, device.m_device);
+			std::swap(m_allocator, device.m_allocator);
 		}
 		vk_device& operator=(vk_device && device) noexcept
 		{
 			std::swap(m_device, device.m_device);
+			std::swap(m_allocator, device.m_allocator);
 			return *this;
 		}
 		~vk_device()
@@ -90,5 +100,6 @@ namespace px
 
 	private:
 		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // null for default
 	};
 }
\ No newline at end of file
@@ -0,0 +1,304 @@
+// name: vk_device_profile
+// type: c++ header
+// desc: capabilities of physical device queried once
+// auth: is0urce
+
+#pragma once
+
+// properties, features, memory types, queue families, extensions and surface formats are queried on creation
+// surface capabilities are the exception, current extent changes with window and have to be queried on each swapchain creation
+// format properties are queried lazily and cached
+// queue families prefer dedicated hardware: compute without graphics, transfer without graphics and compute, presentation on graphics family
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class vk_device_profile final
+	{
+	public:
+		struct families
+		{
+			int graphics;
+			int compute;
+			int transfer;
+			int presentation;
+
+			explicit operator bool() const noexcept
+			{
+				return graphics >= 0 && presentation >= 0;
+			}
+			bool match() const noexcept
+			{
+				return graphics == presentation;
+			}
+		};
+
+	public:
+		operator VkPhysicalDevice() const noexcept
+		{
+			return m_device;
+		}
+		VkPhysicalDevice device() const noexcept
+		{
+			return m_device;
+		}
+		VkPhysicalDeviceProperties const& properties() const noexcept
+		{
+			return m_properties;
+		}
+		VkPhysicalDeviceLimits const& limits() const noexcept
+		{
+			return m_properties.limits;
+		}
+		VkPhysicalDeviceFeatures const& features() const noexcept
+		{
+			return m_features;
+		}
+		VkPhysicalDeviceMemoryProperties const& memory() const noexcept
+		{
+			return m_memory;
+		}
+		std::vector<VkQueueFamilyProperties> const& queue_families() const noexcept
+		{
+			return m_queue_families;
+		}
+		families const& queues() const noexcept
+		{
+			return m_families;
+		}
+		std::vector<VkExtensionProperties> const& extensions() const noexcept
+		{
+			return m_extensions;
+		}
+		bool supports(const char* extension) const
+		{
+			return std::any_of(std::begin(m_extensions), std::end(m_extensions), [extension](VkExtensionProperties const& available) { return std::strcmp(available.extensionName, extension) == 0; });
+		}
+		bool supports(std::vector<const char*> const& extensions) const
+		{
+			return std::all_of(std::begin(extensions), std::end(extensions), [this](const char* extension) { return supports(extension); });
+		}
+		std::vector<VkSurfaceFormatKHR> const& surface_formats() const noexcept
+		{
+			return m_surface_formats;
+		}
+		std::vector<VkPresentModeKHR> const& present_modes() const noexcept
+		{
+			return m_present_modes;
+		}
+		VkSurfaceCapabilitiesKHR surface_capabilities() const
+		{
+			VkSurfaceCapabilitiesKHR capabilities{};
+			if (m_surface != VK_NULL_HANDLE)
+			{
+				vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_device, m_surface, &capabilities);
+			}
+			return capabilities;
+		}
+		VkFormatProperties format_properties(VkFormat format) const
+		{
+			std::lock_guard<std::mutex> lock(m_format_mutex);
+			auto found = m_formats.find(format);
+			if (found == m_formats.end())
+			{
+				VkFormatProperties properties{};
+				vkGetPhysicalDeviceFormatProperties(m_device, format, &properties);
+				found = m_formats.emplace(format, properties).first;
+			}
+			return found->second;
+		}
+
+		// index of first memory type matching filter and properties
+		uint32_t find_memory(uint32_t filter, VkMemoryPropertyFlags properties) const
+		{
+			for (uint32_t i = 0; i != m_memory.memoryTypeCount; ++i)
+			{
+				if ((filter & (1 << i)) && (m_memory.memoryTypes[i].propertyFlags & properties) == properties)
+				{
+					return i;
+				}
+			}
+
+			throw std::runtime_error("px::vk_device_profile::find_memory() - failed to find suitable memory type!");
+		}
+		// preferred properties if any type has them (like lazily allocated), required otherwise
+		uint32_t find_memory(uint32_t filter, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required) const
+		{
+			for (uint32_t i = 0; i != m_memory.memoryTypeCount; ++i)
+			{
+				if ((filter & (1 << i)) && (m_memory.memoryTypes[i].propertyFlags & (preferred | required)) == (preferred | required))
+				{
+					return i;
+				}
+			}
+			return find_memory(filter, required);
+		}
+		void create(VkPhysicalDevice device, VkSurfaceKHR surface)
+		{
+			m_device = device;
+			m_surface = surface;
+
+			vkGetPhysicalDeviceProperties(m_device, &m_properties);
+			vkGetPhysicalDeviceFeatures(m_device, &m_features);
+			vkGetPhysicalDeviceMemoryProperties(m_device, &m_memory);
+
+			uint32_t count = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(m_device, &count, nullptr);
+			m_queue_families.resize(count);
+			vkGetPhysicalDeviceQueueFamilyProperties(m_device, &count, m_queue_families.data());
+
+			m_presentation.assign(count, VK_FALSE);
+			for (uint32_t i = 0; i != count && m_surface != VK_NULL_HANDLE; ++i)
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(m_device, i, m_surface, &m_presentation[i]);
+			}
+
+			count = 0;
+			vkEnumerateDeviceExtensionProperties(m_device, nullptr, &count, nullptr);
+			m_extensions.resize(count);
+			vkEnumerateDeviceExtensionProperties(m_device, nullptr, &count, m_extensions.data());
+
+			m_surface_formats.clear();
+			m_present_modes.clear();
+			if (m_surface != VK_NULL_HANDLE && supports(VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+			{
+				count = 0;
+				vkGetPhysicalDeviceSurfaceFormatsKHR(m_device, m_surface, &count, nullptr);
+				m_surface_formats.resize(count);
+				vkGetPhysicalDeviceSurfaceFormatsKHR(m_device, m_surface, &count, m_surface_formats.data());
+
+				count = 0;
+				vkGetPhysicalDeviceSurfacePresentModesKHR(m_device, m_surface, &count, nullptr);
+				m_present_modes.resize(count);
+				vkGetPhysicalDeviceSurfacePresentModesKHR(m_device, m_surface, &count, m_present_modes.data());
+			}
+
+			m_families = select_families();
+
+			std::lock_guard<std::mutex> lock(m_format_mutex);
+			m_formats.clear();
+		}
+
+	public:
+		vk_device_profile() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_surface(VK_NULL_HANDLE)
+			, m_properties{}
+			, m_features{}
+			, m_memory{}
+			, m_families{ -1, -1, -1, -1 }
+		{
+		}
+		vk_device_profile(VkPhysicalDevice device, VkSurfaceKHR surface)
+			: vk_device_profile()
+		{
+			create(device, surface);
+		}
+		vk_device_profile(vk_device_profile const& other)
+			: vk_device_profile()
+		{
+			*this = other;
+		}
+		vk_device_profile& operator=(vk_device_profile const& other)
+		{
+			if (this != &other)
+			{
+				m_device = other.m_device;
+				m_surface = other.m_surface;
+				m_properties = other.m_properties;
+				m_features = other.m_features;
+				m_memory = other.m_memory;
+				m_queue_families = other.m_queue_families;
+				m_presentation = other.m_presentation;
+				m_families = other.m_families;
+				m_extensions = other.m_extensions;
+				m_surface_formats = other.m_surface_formats;
+				m_present_modes = other.m_present_modes;
+
+				std::lock_guard<std::mutex> lock(other.m_format_mutex);
+				m_formats = other.m_formats;
+			}
+			return *this;
+		}
+
+	private:
+		families select_families() const noexcept
+		{
+			families found{ -1, -1, -1, -1 };
+
+			auto pick = [this](VkQueueFlags required, VkQueueFlags excluded) {
+				for (int i = 0, size = static_cast<int>(m_queue_families.size()); i != size; ++i)
+				{
+					auto const& family = m_queue_families[i];
+					if (family.queueCount > 0 && (family.queueFlags & required) == required && (family.queueFlags & excluded) == 0)
+					{
+						return i;
+					}
+				}
+				return -1;
+			};
+
+			// presentation from graphics family avoids ownership transfer of swapchain images
+			for (int i = 0, size = static_cast<int>(m_queue_families.size()); i != size; ++i)
+			{
+				if (m_queue_families[i].queueCount > 0 && (m_queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && m_presentation[i])
+				{
+					found.graphics = i;
+					found.presentation = i;
+					break;
+				}
+			}
+			if (found.graphics < 0)
+			{
+				found.graphics = pick(VK_QUEUE_GRAPHICS_BIT, 0);
+				for (int i = 0, size = static_cast<int>(m_queue_families.size()); i != size && found.presentation < 0; ++i)
+				{
+					if (m_queue_families[i].queueCount > 0 && m_presentation[i])
+					{
+						found.presentation = i;
+					}
+				}
+			}
+
+			found.compute = pick(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+			if (found.compute < 0)
+			{
+				found.compute = pick(VK_QUEUE_COMPUTE_BIT, 0);
+			}
+
+			// graphics and compute families support transfer implicitly
+			found.transfer = pick(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+			if (found.transfer < 0)
+			{
+				found.transfer = found.compute >= 0 ? found.compute : found.graphics;
+			}
+
+			return found;
+		}
+
+	private:
+		VkPhysicalDevice m_device;
+		VkSurfaceKHR m_surface;
+		VkPhysicalDeviceProperties m_properties;
+		VkPhysicalDeviceFeatures m_features;
+		VkPhysicalDeviceMemoryProperties m_memory;
+		std::vector<VkQueueFamilyProperties> m_queue_families;
+		std::vector<VkBool32> m_presentation; // surface support per family
+		families m_families;
+		std::vector<VkExtensionProperties> m_extensions;
+		std::vector<VkSurfaceFormatKHR> m_surface_formats;
+		std::vector<VkPresentModeKHR> m_present_modes;
+
+		mutable std::mutex m_format_mutex;
+		mutable std::map<VkFormat, VkFormatProperties> m_formats;
+	};
+}
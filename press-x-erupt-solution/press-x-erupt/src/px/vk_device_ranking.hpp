@@ -0,0 +1,262 @@
+// name: vk_device_ranking
+// type: c++ header
+// desc: physical device selection by performance score
+// auth: is0urce
+
+#pragma once
+
+// devices failing hard requirements (user predicate and required features) are rejected
+// remaining devices are scored by type, device-local memory, limits and optional features
+// PX_DEVICE environment variable (or prefer() call) overrides choice by index or name substring
+// decision is logged with every candidate and its score
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_device_profile.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class vk_device_ranking final
+	{
+	public:
+		struct candidate
+		{
+			vk_device_profile profile;
+			bool suitable;
+			long long score;
+		};
+		typedef std::function<bool(vk_device_profile const&)> requirement_fn;
+
+	public:
+		// every feature enabled in argument is a hard requirement
+		void require(VkPhysicalDeviceFeatures const& features) noexcept
+		{
+			m_required = features;
+		}
+
+		// index in enumeration order or case-insensitive part of device name, empty string to disable
+		void prefer(std::string selector)
+		{
+			m_preferred = selector;
+		}
+
+		// all devices, best first, unsuitable devices at the end
+		// every device is profiled once, selected profile is returned to caller
+		std::vector<candidate> rank(VkInstance instance, VkSurfaceKHR surface, requirement_fn suitable) const
+		{
+			uint32_t device_count = 0;
+			vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+			std::vector<VkPhysicalDevice> devices(device_count);
+			vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+
+			std::vector<candidate> candidates;
+			for (auto device : devices)
+			{
+				candidate current{ vk_device_profile(device, surface), false, -1 };
+				current.suitable = supports(current.profile.features()) && (!suitable || suitable(current.profile));
+				current.score = current.suitable ? score(current) : -1;
+				candidates.push_back(current);
+			}
+
+			std::stable_sort(std::begin(candidates), std::end(candidates), [](candidate const& a, candidate const& b) { return a.score > b.score; });
+			return candidates;
+		}
+
+		vk_device_profile select(VkInstance instance, VkSurfaceKHR surface, requirement_fn suitable) const
+		{
+			auto candidates = rank(instance, surface, suitable);
+			if (candidates.empty())
+			{
+				throw std::runtime_error("px::vk_device_ranking::select() - failed to find GPUs with Vulkan support!");
+			}
+
+			candidate const* selected = candidates[0].suitable ? &candidates[0] : nullptr;
+			bool overridden = false;
+			if (!m_preferred.empty())
+			{
+				candidate const* preferred = find_preferred(instance, candidates);
+				if (preferred && preferred->suitable)
+				{
+					overridden = preferred != selected;
+					selected = preferred;
+				}
+				else
+				{
+					std::cerr << "px::vk_device_ranking - preferred device '" << m_preferred << "' not found or not suitable, using ranking" << std::endl;
+				}
+			}
+
+			for (auto const& current : candidates)
+			{
+				std::cout << "px::vk_device_ranking - " << (&current == selected ? "* " : "  ") << current.profile.properties().deviceName << " (" << type_name(current.profile.properties().deviceType) << ") ";
+				if (current.suitable)
+				{
+					std::cout << "score " << current.score;
+				}
+				else
+				{
+					std::cout << "unsuitable";
+				}
+				std::cout << std::endl;
+			}
+
+			if (!selected)
+			{
+				throw std::runtime_error("px::vk_device_ranking::select() - failed to find a suitable GPU!");
+			}
+			std::cout << "px::vk_device_ranking - selected " << selected->profile.properties().deviceName << (overridden ? " by override" : "") << std::endl;
+			return selected->profile;
+		}
+
+	public:
+		vk_device_ranking()
+			: m_required{}
+		{
+#pragma warning(suppress:4996) // getenv is fine for reading configuration once
+			const char* selector = std::getenv("PX_DEVICE");
+			if (selector)
+			{
+				m_preferred = selector;
+			}
+		}
+
+	private:
+		bool supports(VkPhysicalDeviceFeatures const& features) const noexcept
+		{
+			// VkPhysicalDeviceFeatures is a plain sequence of VkBool32
+			auto required = reinterpret_cast<VkBool32 const*>(&m_required);
+			auto available = reinterpret_cast<VkBool32 const*>(&features);
+			for (size_t i = 0, size = sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); i != size; ++i)
+			{
+				if (required[i] && !available[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		candidate const* find_preferred(VkInstance instance, std::vector<candidate> const& candidates) const
+		{
+			// numeric selector is an index in enumeration order, not in ranking order
+			if (m_preferred.size() < 10 && std::all_of(std::begin(m_preferred), std::end(m_preferred), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+			{
+				uint32_t device_count = 0;
+				vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+				std::vector<VkPhysicalDevice> devices(device_count);
+				vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+
+				size_t index = std::stoul(m_preferred);
+				if (index < devices.size())
+				{
+					for (auto const& current : candidates)
+					{
+						if (current.profile.device() == devices[index])
+						{
+							return &current;
+						}
+					}
+				}
+				return nullptr;
+			}
+
+			std::string selector = lowercase(m_preferred);
+			for (auto const& current : candidates)
+			{
+				if (lowercase(current.profile.properties().deviceName).find(selector) != std::string::npos)
+				{
+					return &current;
+				}
+			}
+			return nullptr;
+		}
+		static long long score(candidate const& current) noexcept
+		{
+			long long result = 0;
+
+			// type dominates, software rasterizers still win over nothing
+			auto const& properties = current.profile.properties();
+			auto const& memory = current.profile.memory();
+			auto const& features = current.profile.features();
+
+			switch (properties.deviceType)
+			{
+			case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+				result += 100000;
+				break;
+			case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+				result += 50000;
+				break;
+			case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+				result += 25000;
+				break;
+			case VK_PHYSICAL_DEVICE_TYPE_CPU:
+				result += 10000;
+				break;
+			default:
+				result += 1000;
+				break;
+			}
+
+			// largest device-local heap, one point per 16 megabytes
+			VkDeviceSize local = 0;
+			for (uint32_t i = 0; i != memory.memoryHeapCount; ++i)
+			{
+				if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				{
+					local = std::max(local, memory.memoryHeaps[i].size);
+				}
+			}
+			result += std::min<long long>(static_cast<long long>(local >> 24), 20000);
+
+			// limits
+			auto const& limits = properties.limits;
+			result += limits.maxImageDimension2D / 256;
+			result += limits.maxPushConstantsSize / 32;
+			for (VkSampleCountFlags samples = limits.framebufferColorSampleCounts; samples > 1; samples >>= 1)
+			{
+				result += 10;
+			}
+
+			// optional features we take advantage of
+			result += features.samplerAnisotropy ? 50 : 0;
+			result += features.textureCompressionBC ? 50 : 0;
+			result += features.multiDrawIndirect ? 25 : 0;
+
+			return result;
+		}
+		static std::string lowercase(std::string text)
+		{
+			std::transform(std::begin(text), std::end(text), std::begin(text), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+			return text;
+		}
+		static const char* type_name(VkPhysicalDeviceType type) noexcept
+		{
+			switch (type)
+			{
+			case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+				return "discrete";
+			case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+				return "integrated";
+			case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+				return "virtual";
+			case VK_PHYSICAL_DEVICE_TYPE_CPU:
+				return "cpu";
+			default:
+				return "other";
+			}
+		}
+
+	private:
+		VkPhysicalDeviceFeatures m_required;
+		std::string m_preferred;
+	};
+}
@@ -0,0 +1,331 @@
+// name: vk_host_allocator
+// type: c++ header
+// desc: host memory of vulkan driver served by size class pools, accounted per allocation scope
+// auth: is0urce
+
+#pragma once
+
+// requests up to largest class are rounded to power of two blocks carved from arena chunks, freed blocks go to class free list
+// each class has own lock, so threads compiling pipelines and recording frames rarely meet
+// chunks are returned only with allocator, driver churn is recycled instead of reaching system heap
+// bigger requests go to system heap, every block keeps small header with class, scope and size for accounting
+// allocator has to outlive instance and every object created with its callbacks
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace px
+{
+	class vk_host_allocator final
+	{
+	public:
+		static const size_t scope_count = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+		// snapshot of one allocation scope
+		struct scope_stats
+		{
+			uint64_t bytes; // live, requested sizes
+			uint64_t peak_bytes;
+			uint64_t count; // live allocations
+			uint64_t allocations; // total, reallocations included
+			uint64_t frees;
+			uint64_t internal_bytes; // reported by driver for its own allocations
+		};
+
+	public:
+		VkAllocationCallbacks const* callbacks() const noexcept
+		{
+			return &m_callbacks;
+		}
+		scope_stats stats(VkSystemAllocationScope scope) const noexcept
+		{
+			scope_data const& data = m_scopes[scope];
+			return{ data.bytes.load(), data.peak_bytes.load(), data.count.load(), data.allocations.load(), data.frees.load(), data.internal_bytes.load() };
+		}
+		// bytes held in arena chunks, used and free
+		uint64_t reserved() const noexcept
+		{
+			return m_reserved.load();
+		}
+		void report(std::ostream & stream) const
+		{
+			static const char * names[scope_count] = { "command", "object", "cache", "device", "instance" };
+			stream << "px::vk_host_allocator - " << m_reserved.load() / 1024 << " kb in pools" << std::endl;
+			for (size_t i = 0; i != scope_count; ++i)
+			{
+				scope_stats current = stats(static_cast<VkSystemAllocationScope>(i));
+				stream << "  " << std::setw(8) << names[i]
+					<< std::setw(10) << current.bytes / 1024 << " kb live"
+					<< std::setw(10) << current.peak_bytes / 1024 << " kb peak"
+					<< std::setw(8) << current.count << " live"
+					<< std::setw(10) << current.allocations << " allocated"
+					<< std::setw(10) << current.frees << " freed"
+					<< std::setw(8) << current.internal_bytes / 1024 << " kb internal" << std::endl;
+			}
+		}
+
+	public:
+		vk_host_allocator() noexcept
+		{
+			m_callbacks.pUserData = this;
+			m_callbacks.pfnAllocation = &allocation;
+			m_callbacks.pfnReallocation = &reallocation;
+			m_callbacks.pfnFree = &deallocation;
+			m_callbacks.pfnInternalAllocation = &internal_allocation;
+			m_callbacks.pfnInternalFree = &internal_free;
+			for (auto & current : m_scopes)
+			{
+				current.bytes = 0;
+				current.peak_bytes = 0;
+				current.count = 0;
+				current.allocations = 0;
+				current.frees = 0;
+				current.internal_bytes = 0;
+			}
+			for (auto & current : m_classes)
+			{
+				current.free = nullptr;
+				current.cursor = nullptr;
+				current.end = nullptr;
+			}
+			m_reserved = 0;
+		}
+		vk_host_allocator(vk_host_allocator const&) = delete;
+		vk_host_allocator& operator=(vk_host_allocator const&) = delete;
+		~vk_host_allocator()
+		{
+			for (auto & current : m_classes)
+			{
+				for (void * chunk : current.chunks)
+				{
+					std::free(chunk);
+				}
+			}
+		}
+
+	private:
+		// precedes every block, keeps block start aligned to 16
+		struct header
+		{
+			uint32_t size_class; // large if past last class
+			uint16_t offset; // from block start to user memory
+			uint16_t scope;
+			uint64_t size; // requested
+		};
+		struct scope_data
+		{
+			std::atomic<uint64_t> bytes;
+			std::atomic<uint64_t> peak_bytes;
+			std::atomic<uint64_t> count;
+			std::atomic<uint64_t> allocations;
+			std::atomic<uint64_t> frees;
+			std::atomic<uint64_t> internal_bytes;
+		};
+		struct free_block
+		{
+			free_block * next;
+		};
+		struct class_data
+		{
+			std::mutex mutex;
+			free_block * free; // recycled blocks
+			char * cursor; // uncarved part of newest chunk
+			char * end;
+			std::vector<void*> chunks;
+		};
+
+	private:
+		static const size_t min_class_shift = 5; // 32 bytes, header included
+		static const size_t class_count = 8; // up to 4 kb
+		static const size_t large = class_count;
+		static const size_t chunk_size = 64 * 1024;
+		static const size_t max_block = size_t{ 1 } << (class_count - 1 + min_class_shift);
+		static const size_t base_alignment = 16; // malloc guarantee on supported targets
+
+	private:
+		static VKAPI_ATTR void * VKAPI_CALL allocation(void * user, size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			return static_cast<vk_host_allocator*>(user)->allocate(size, alignment, scope);
+		}
+		static VKAPI_ATTR void * VKAPI_CALL reallocation(void * user, void * original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			return static_cast<vk_host_allocator*>(user)->reallocate(original, size, alignment, scope);
+		}
+		static VKAPI_ATTR void VKAPI_CALL deallocation(void * user, void * memory)
+		{
+			static_cast<vk_host_allocator*>(user)->release(memory);
+		}
+		static VKAPI_ATTR void VKAPI_CALL internal_allocation(void * user, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+		{
+			static_cast<vk_host_allocator*>(user)->m_scopes[scope].internal_bytes += size;
+		}
+		static VKAPI_ATTR void VKAPI_CALL internal_free(void * user, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+		{
+			static_cast<vk_host_allocator*>(user)->m_scopes[scope].internal_bytes -= size;
+		}
+
+		// block holds header and user memory at alignment, worst case padding included
+		static size_t block_size(size_t size, size_t alignment) noexcept
+		{
+			return size + std::max(alignment, sizeof(header));
+		}
+		static size_t class_of(size_t block) noexcept
+		{
+			size_t index = 0;
+			while (index != class_count && (size_t{ 1 } << (index + min_class_shift)) < block)
+			{
+				++index;
+			}
+			return index;
+		}
+		static header * header_of(void * memory) noexcept
+		{
+			return reinterpret_cast<header*>(memory) - 1;
+		}
+		static size_t capacity(header const* block) noexcept
+		{
+			return (size_t{ 1 } << (block->size_class + min_class_shift)) - block->offset;
+		}
+
+		void * allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			if (size == 0)
+			{
+				return nullptr;
+			}
+			alignment = alignment < base_alignment ? base_alignment : alignment;
+			size_t bytes = block_size(size, alignment);
+			size_t index = class_of(bytes);
+			char * block = static_cast<char*>(index == large ? std::malloc(bytes) : take(index));
+			if (block == nullptr)
+			{
+				return nullptr;
+			}
+
+			// pool blocks are aligned to their power of two size, system blocks to base alignment
+			uintptr_t address = reinterpret_cast<uintptr_t>(block) + sizeof(header);
+			address = (address + alignment - 1) & ~uintptr_t(alignment - 1);
+			header * info = reinterpret_cast<header*>(address) - 1;
+			info->size_class = static_cast<uint32_t>(index);
+			info->offset = static_cast<uint16_t>(address - reinterpret_cast<uintptr_t>(block));
+			info->scope = static_cast<uint16_t>(scope);
+			info->size = size;
+
+			scope_data & data = m_scopes[scope];
+			grow(data, size);
+			++data.count;
+			++data.allocations;
+			return reinterpret_cast<void*>(address);
+		}
+		void * reallocate(void * original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			if (original == nullptr)
+			{
+				return allocate(size, alignment, scope);
+			}
+			if (size == 0)
+			{
+				release(original);
+				return nullptr;
+			}
+
+			// growing within block keeps memory in place, alignment stays as it was requested originally
+			header * info = header_of(original);
+			if (info->size_class != large && size <= capacity(info) && (reinterpret_cast<uintptr_t>(original) & (alignment - 1)) == 0 && info->scope == scope)
+			{
+				scope_data & data = m_scopes[scope];
+				grow(data, size);
+				data.bytes -= info->size;
+				++data.allocations;
+				info->size = size;
+				return original;
+			}
+
+			void * moved = allocate(size, alignment, scope);
+			if (moved != nullptr)
+			{
+				std::memcpy(moved, original, static_cast<size_t>(std::min<uint64_t>(size, info->size)));
+				release(original);
+			}
+			return moved;
+		}
+		void release(void * memory)
+		{
+			if (memory == nullptr)
+			{
+				return;
+			}
+			header * info = header_of(memory);
+			scope_data & data = m_scopes[info->scope];
+			data.bytes -= info->size;
+			--data.count;
+			++data.frees;
+
+			char * block = static_cast<char*>(memory) - info->offset;
+			if (info->size_class == large)
+			{
+				std::free(block);
+				return;
+			}
+			class_data & pool = m_classes[info->size_class];
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			free_block * recycled = reinterpret_cast<free_block*>(block);
+			recycled->next = pool.free;
+			pool.free = recycled;
+		}
+
+		static void grow(scope_data & data, uint64_t size) noexcept
+		{
+			uint64_t live = data.bytes += size;
+			uint64_t peak = data.peak_bytes.load(std::memory_order_relaxed);
+			while (live > peak && !data.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+			{
+			}
+		}
+		// block of class from free list or newest chunk, chunk start is aligned to largest block, so blocks to their size
+		void * take(size_t index)
+		{
+			class_data & pool = m_classes[index];
+			size_t size = size_t{ 1 } << (index + min_class_shift);
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if (pool.free != nullptr)
+			{
+				free_block * block = pool.free;
+				pool.free = block->next;
+				return block;
+			}
+			if (pool.cursor == pool.end)
+			{
+				void * chunk = std::malloc(chunk_size + max_block);
+				if (chunk == nullptr)
+				{
+					return nullptr;
+				}
+				pool.chunks.push_back(chunk);
+				uintptr_t start = (reinterpret_cast<uintptr_t>(chunk) + max_block - 1) & ~uintptr_t(max_block - 1);
+				pool.cursor = reinterpret_cast<char*>(start);
+				pool.end = pool.cursor + chunk_size;
+				m_reserved += chunk_size + max_block;
+			}
+			void * block = pool.cursor;
+			pool.cursor += size;
+			return block;
+		}
+
+	private:
+		VkAllocationCallbacks m_callbacks;
+		std::array<scope_data, scope_count> m_scopes;
+		std::array<class_data, class_count> m_classes;
+		std::atomic<uint64_t> m_reserved;
+	};
+}
@@ -7,6 +7,7 @@
 
 // move assignable and supports implicit cast to VkInstance
 // default construction not creates handle
+// api version is the highest of 1.0, 1.1 and 1.2 the loader supports, devices may still report lower versions
 
 #include <vulkan/vulkan.hpp>
 
@@ -33,9 +34,21 @@ namespace px
 		{
 			return m_layers.size() != 0 ? m_layers.data() : nullptr;
 		}
-		void create(uint32_t count, const char** extension_names, bool enable_debug)
+		// host allocator instance was created with, null for default
+		VkAllocationCallbacks const* allocator() const noexcept
+		{
+			return m_allocator;
+		}
+		// api version instance was created with
+		uint32_t version() const noexcept
+		{
+			return m_version;
+		}
+		// allocator receives host memory of instance and its children, has to outlive the instance
+		void create(uint32_t count, const char** extension_names, bool enable_debug, VkAllocationCallbacks const* allocator = nullptr)
 		{
 			release();
+			m_allocator = allocator;
 
 			if (enable_debug)
 			{
@@ -51,7 +64,8 @@ namespace px
 			VkApplicationInfo application_info{ VK_STRUCTURE_TYPE_APPLICATION_INFO };
 			application_info.pApplicationName = "renderer";
 			application_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-			application_info.apiVersion = VK_API_VERSION_1_0;
+			m_version = std::min(loader_version(), static_cast<uint32_t>(VK_API_VERSION_1_2));
+			application_info.apiVersion = m_version;
 
 			VkInstanceCreateInfo instance_info{ VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
 			instance_info.pApplicationInfo = &application_info;
@@ -60,7 +74,7 @@ namespace px
 			instance_info.enabledLayerCount = layer_count();
 			instance_info.ppEnabledLayerNames = layers();
 
-			if (vkCreateInstance(&instance_info, nullptr, &m_instance) != VK_SUCCESS)
+			if (vkCreateInstance(&instance_info, m_allocator, &m_instance) != VK_SUCCESS)
 			{
 				throw std::runtime_error("px::vk_instance::create_instance - failed to create instance");
 			}
@@ -80,7 +94,7 @@ namespace px
 				info.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT;
 				info.pfnCallback = debug_callback;
 
-				if (CreateDebugReportCallbackEXT(m_instance, &info, nullptr, &m_debug_callback) != VK_SUCCESS)
+				if (CreateDebugReportCallbackEXT(m_instance, &info, m_allocator, &m_debug_callback) != VK_SUCCESS)
 				{
 					throw std::runtime_error("px::vk_device::setup_debug() - failed to set up debug callback!");
 				}
@@ -90,7 +104,7 @@ namespace px
 		{
 			if (m_debug_callback != VK_NULL_HANDLE)
 			{
-				DestroyDebugReportCallbackEXT(m_instance, m_debug_callback, nullptr);
+				DestroyDebugReportCallbackEXT(m_instance, m_debug_callback, m_allocator);
 				m_debug_callback = VK_NULL_HANDLE;
 			}
 		}
@@ -99,7 +113,7 @@ namespace px
 			stop_debug();
 			if (m_instance != VK_NULL_HANDLE)
 			{
-				vkDestroyInstance(m_instance, nullptr);
+				vkDestroyInstance(m_instance, m_allocator);
 				m_instance = VK_NULL_HANDLE;
 			}
 		}
@@ -108,6 +122,8 @@ namespace px
 		vk_instance() noexcept
 			: m_instance(VK_NULL_HANDLE)
 			, m_debug_callback(VK_NULL_HANDLE)
+			, m_version(VK_API_VERSION_1_0)
+			, m_allocator(nullptr)
 		{
 		}
 		vk_instance(uint32_t count, const char** extension_names, bool enable_debug)
@@ -123,12 +139,16 @@ namespace px
 			std::swap(m_instance, instance.m_instance);
 			std::swap(m_debug_callback, instance.m_debug_callback);
 			std::swap(m_layers, instance.m_layers);
+			std::swap(m_version, instance.m_version);
+			std::swap(m_allocator, instance.m_allocator);
 		}
 		vk_instance& operator=(vk_instance && instance) noexcept
 		{
 			std::swap(m_instance, instance.m_instance);
 			std::swap(m_debug_callback, instance.m_debug_callback);
 			std::swap(m_layers, instance.m_layers);
+			std::swap(m_version, instance.m_version);
+			std::swap(m_allocator, instance.m_allocator);
 			return *this;
 		}
 		~vk_instance()
@@ -137,6 +157,17 @@ namespace px
 		}
 
 	private:
+		// vulkan 1.0 loaders have no version query
+		static uint32_t loader_version()
+		{
+			auto enumerate = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"));
+			uint32_t version = VK_API_VERSION_1_0;
+			if (enumerate == nullptr || enumerate(&version) != VK_SUCCESS)
+			{
+				return VK_API_VERSION_1_0;
+			}
+			return VK_MAKE_VERSION(VK_VERSION_MAJOR(version), VK_VERSION_MINOR(version), 0);
+		}
 		bool support_layers(std::vector<const char*> const& validation_list) const
 		{
 			uint32_t count;
@@ -202,6 +233,8 @@ namespace px
 	private:
 		VkInstance m_instance;
 		VkDebugReportCallbackEXT m_debug_callback;
+		uint32_t m_version;
+		VkAllocationCallbacks const* m_allocator; // null for default
 
 		std::vector<const char*> m_layers;
 	};
@@ -0,0 +1,658 @@
+// name: vk_memory
+// type: c++ header
+// desc: device memory sub-allocated from blocks per memory type and category, with heap budget tracking
+// auth: is0urce
+
+#pragma once
+
+// every category (vertex, index, staging, image) has own blocks, so linear and optimal resources never share page and usage is visible per category
+// blocks start small and double up to preferred size of heap, requests over half of it get dedicated memory, lazily allocated memory is always dedicated
+// host visible blocks are mapped once on creation, allocation gets pointer into the mapping
+// memory type with preferred properties is taken only while its heap stays in budget, otherwise any type with required ones
+// heap budget and usage come from VK_EXT_memory_budget if enabled, estimated from heap size and own allocations otherwise
+// update once per frame notifies subscribers about heaps under pressure, then lets evictions settle for few frames
+// heaps which were under pressure report headroom below threshold at the same pace, so subscribers can grow back
+// buffers registered as movable may be relocated by defragmenter, their owners rebind through relocation callback
+// mapped allocations are never moved, device copy of frame would race host writes into them
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_device_profile.hpp"
+#include "vk_instance.hpp"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	class vk_memory final
+	{
+	public:
+		enum class category : uint32_t { vertex, index, staging, image };
+		static const uint32_t category_count = 4;
+
+		struct allocation;
+		// binds buffer to moved allocation and returns buffer it replaces, old one is destroyed when device is done with it
+		// owner has to stay unchanged if it throws, move is then undone
+		typedef std::function<VkBuffer(allocation const& moved)> relocate_fn;
+
+		// internal, allocations point to their block, free ranges are sorted by offset and merged on free
+		struct block
+		{
+			struct range
+			{
+				VkDeviceSize offset;
+				VkDeviceSize size;
+			};
+			struct movable
+			{
+				VkDeviceSize offset;
+				VkDeviceSize size;
+				VkDeviceSize alignment;
+				relocate_fn relocate;
+			};
+
+			VkDeviceMemory memory;
+			VkDeviceSize size;
+			VkDeviceSize used;
+			char * data; // mapping, null if not host visible
+			std::vector<range> free;
+			std::vector<movable> movables; // allocations defragmenter may move
+			uint32_t allocations;
+			uint32_t type;
+			uint32_t heap;
+			category kind;
+			bool dedicated;
+			bool draining; // being emptied, new allocations go elsewhere
+		};
+		struct allocation
+		{
+			VkDeviceMemory memory;
+			VkDeviceSize offset;
+			VkDeviceSize size; // requested
+			VkDeviceSize alignment;
+			void * data; // mapped at offset, null if not host visible
+			block * owner; // null if empty
+		};
+		struct heap_stats
+		{
+			VkDeviceSize size;
+			VkDeviceSize allocated; // device memory in blocks
+			VkDeviceSize used; // by live allocations
+			uint32_t blocks;
+			uint32_t allocations;
+			VkDeviceSize budget; // for whole process
+			VkDeviceSize usage; // by whole process if reported by driver, own blocks otherwise
+		};
+		struct category_stats
+		{
+			VkDeviceSize allocated;
+			VkDeviceSize used;
+			uint32_t blocks;
+			uint32_t allocations;
+		};
+		// called on render thread with bytes to release to get heap under pressure threshold
+		// or with zero excess and bytes heap can grow before reaching threshold, once it was under pressure
+		typedef std::function<void(uint32_t heap, VkDeviceSize excess, VkDeviceSize headroom)> budget_fn;
+
+	public:
+		// budget extension needs instance and device of at least 1.1 for memory properties query, adds extension to enable
+		static bool budget_supported(vk_instance const& instance, vk_device_profile const& profile, std::vector<const char*> & extensions)
+		{
+			if (instance.version() < VK_API_VERSION_1_1 || profile.properties().apiVersion < VK_API_VERSION_1_1 || !profile.supports(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+			{
+				return false;
+			}
+			if (vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2") == nullptr)
+			{
+				return false;
+			}
+			extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			return true;
+		}
+		static const char * name(category kind) noexcept
+		{
+			static const char * names[category_count] = { "vertex", "index", "staging", "image" };
+			return names[static_cast<uint32_t>(kind)];
+		}
+
+	public:
+		// memory bound to resource is owned by caller and freed with free() after resource is destroyed
+		allocation bind(VkBuffer buffer, category kind, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required)
+		{
+			VkMemoryRequirements requirements;
+			vkGetBufferMemoryRequirements(m_device, buffer, &requirements);
+			allocation result = allocate(requirements, kind, preferred, required);
+			if (vkBindBufferMemory(m_device, buffer, result.memory, result.offset) != VK_SUCCESS)
+			{
+				free(result);
+				throw std::runtime_error("px::vk_memory::bind() - failed to bind buffer memory");
+			}
+			return result;
+		}
+		allocation bind(VkImage image, category kind, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required)
+		{
+			VkMemoryRequirements requirements;
+			vkGetImageMemoryRequirements(m_device, image, &requirements);
+			allocation result = allocate(requirements, kind, preferred, required);
+			if (vkBindImageMemory(m_device, image, result.memory, result.offset) != VK_SUCCESS)
+			{
+				free(result);
+				throw std::runtime_error("px::vk_memory::bind() - failed to bind image memory");
+			}
+			return result;
+		}
+		allocation allocate(VkMemoryRequirements const& requirements, category kind, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			uint32_t type = choose(requirements.memoryTypeBits, requirements.size, preferred, required);
+			pool & target = m_pools[type * category_count + static_cast<uint32_t>(kind)];
+			VkDeviceSize preferred_block = block_size(type);
+			bool dedicated = requirements.size > preferred_block / 2 || (m_profile->memory().memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+
+			if (!dedicated)
+			{
+				for (auto & current : target.blocks)
+				{
+					VkDeviceSize offset;
+					if (!current->dedicated && !current->draining && fit(*current, requirements.size, requirements.alignment, offset))
+					{
+						return take(*current, offset, requirements.size, requirements.alignment);
+					}
+				}
+			}
+
+			// new block, smaller than preferred while pool is young
+			VkDeviceSize size = requirements.size;
+			if (!dedicated)
+			{
+				size = std::min(preferred_block, small_block << std::min<size_t>(target.blocks.size(), 16));
+				size = std::max(size, requirements.size);
+			}
+			block & created = create_block(target, type, kind, size, dedicated);
+			VkDeviceSize offset = 0;
+			fit(created, requirements.size, requirements.alignment, offset);
+			return take(created, offset, requirements.size, requirements.alignment);
+		}
+		void free(allocation & target) noexcept
+		{
+			if (target.owner == nullptr)
+			{
+				return;
+			}
+			std::lock_guard<std::mutex> lock(m_mutex);
+			block & owner = *target.owner;
+			give(owner, target.offset, target.size);
+			auto registered = std::find_if(std::begin(owner.movables), std::end(owner.movables), [&target](block::movable const& current) { return current.offset == target.offset; });
+			if (registered != std::end(owner.movables))
+			{
+				owner.movables.erase(registered);
+			}
+			owner.used -= target.size;
+			--owner.allocations;
+			m_heaps[owner.heap].used -= target.size;
+			--m_heaps[owner.heap].allocations;
+
+			// empty blocks go back to driver, except last block of pool
+			pool & parent = pool_of(owner);
+			if (owner.allocations == 0 && (owner.dedicated || parent.blocks.size() > 1))
+			{
+				destroy_block(parent, owner);
+			}
+			else if (owner.allocations == 0)
+			{
+				owner.draining = false; // last block of pool stays in use
+			}
+			target = {};
+		}
+
+		// allows defragmenter to move allocation, only unmapped buffers of linear categories are moved
+		void movable(allocation const& target, relocate_fn relocate)
+		{
+			if (target.owner == nullptr || target.owner->kind == category::image || target.data != nullptr)
+			{
+				return;
+			}
+			std::lock_guard<std::mutex> lock(m_mutex);
+			target.owner->movables.push_back({ target.offset, target.size, target.alignment, std::move(relocate) });
+		}
+		// new buffer bound to allocation, helper for relocation callbacks
+		VkBuffer buffer(VkBufferCreateInfo const& info, allocation const& memory)
+		{
+			VkBuffer result;
+			if (vkCreateBuffer(m_device, &info, m_allocator, &result) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_memory::buffer() - failed to create buffer");
+			}
+			if (vkBindBufferMemory(m_device, result, memory.memory, memory.offset) != VK_SUCCESS)
+			{
+				vkDestroyBuffer(m_device, result, m_allocator);
+				throw std::runtime_error("px::vk_memory::buffer() - failed to bind buffer memory");
+			}
+			return result;
+		}
+
+		// queries budget and notifies subscribers about heaps over pressure threshold, call once per frame on render thread
+		void update()
+		{
+			std::vector<std::pair<uint32_t, VkDeviceSize>> pressured;
+			std::vector<std::pair<uint32_t, VkDeviceSize>> relieved;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				query_budget();
+				for (uint32_t i = 0; i != m_heaps.size(); ++i)
+				{
+					heap_data & current = m_heaps[i];
+					if (current.settle != 0)
+					{
+						--current.settle;
+						continue;
+					}
+					VkDeviceSize usage = usage_of(i);
+					VkDeviceSize threshold = static_cast<VkDeviceSize>(current.budget * m_pressure);
+					if (usage > threshold)
+					{
+						pressured.emplace_back(i, usage - threshold);
+						current.pressured = true;
+						current.settle = settle_frames;
+					}
+					else if (current.pressured)
+					{
+						relieved.emplace_back(i, threshold - usage);
+						current.settle = settle_frames;
+					}
+				}
+			}
+			for (auto const& heap : pressured)
+			{
+				std::cout << "px::vk_memory - heap " << heap.first << " over budget by " << heap.second / 1024 << " kb" << std::endl;
+				for (auto const& subscriber : m_subscribers)
+				{
+					subscriber.second(heap.first, heap.second, 0);
+				}
+			}
+			for (auto const& heap : relieved)
+			{
+				for (auto const& subscriber : m_subscribers)
+				{
+					subscriber.second(heap.first, 0, heap.second);
+				}
+			}
+		}
+		// returns token for unsubscribe
+		uint32_t subscribe(budget_fn fn)
+		{
+			m_subscribers.emplace_back(++m_token, std::move(fn));
+			return m_token;
+		}
+		void unsubscribe(uint32_t token)
+		{
+			m_subscribers.erase(std::remove_if(std::begin(m_subscribers), std::end(m_subscribers), [token](std::pair<uint32_t, budget_fn> const& current) { return current.first == token; }), std::end(m_subscribers));
+		}
+		// fraction of budget subscribers are asked to stay under
+		void pressure(float fraction) noexcept
+		{
+			m_pressure = fraction;
+		}
+		bool budget_extension() const noexcept
+		{
+			return m_query != nullptr;
+		}
+
+		uint32_t heap_count() const noexcept
+		{
+			return static_cast<uint32_t>(m_heaps.size());
+		}
+		heap_stats heap(uint32_t index) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			heap_data const& current = m_heaps.at(index);
+			return{ m_profile->memory().memoryHeaps[index].size, current.allocated, current.used, current.blocks, current.allocations, current.budget, usage_of(index) };
+		}
+		category_stats stats(category kind) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			category_stats result{};
+			for (uint32_t type = 0; type != m_profile->memory().memoryTypeCount; ++type)
+			{
+				for (auto const& current : m_pools[type * category_count + static_cast<uint32_t>(kind)].blocks)
+				{
+					result.allocated += current->size;
+					result.used += current->used;
+					result.blocks += 1;
+					result.allocations += current->allocations;
+				}
+			}
+			return result;
+		}
+		void report(std::ostream & stream) const
+		{
+			stream << "px::vk_memory - " << (budget_extension() ? "budget reported by driver" : "budget estimated") << std::endl;
+			for (uint32_t i = 0; i != heap_count(); ++i)
+			{
+				heap_stats current = heap(i);
+				stream << "  heap " << i << std::setw(10) << current.allocated / 1024 << " kb allocated"
+					<< std::setw(10) << current.used / 1024 << " kb used"
+					<< std::setw(6) << current.blocks << " blocks"
+					<< std::setw(8) << current.allocations << " live"
+					<< std::setw(10) << current.usage / 1024 << " kb of"
+					<< std::setw(10) << current.budget / 1024 << " kb budget" << std::endl;
+			}
+			for (uint32_t i = 0; i != category_count; ++i)
+			{
+				category_stats current = stats(static_cast<category>(i));
+				stream << "  " << std::setw(8) << name(static_cast<category>(i))
+					<< std::setw(10) << current.allocated / 1024 << " kb allocated"
+					<< std::setw(10) << current.used / 1024 << " kb used"
+					<< std::setw(6) << current.blocks << " blocks"
+					<< std::setw(8) << current.allocations << " live" << std::endl;
+			}
+		}
+
+		// budget is true if extension was enabled on device
+		void create(VkInstance instance, vk_device_profile const& profile, VkDevice device, bool budget, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_profile = &profile;
+			m_query = budget ? reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2")) : nullptr;
+			m_pools.resize(profile.memory().memoryTypeCount * category_count);
+			m_heaps.assign(profile.memory().memoryHeapCount, heap_data{});
+			std::lock_guard<std::mutex> lock(m_mutex);
+			query_budget();
+		}
+		// every allocation has to be freed before, leftovers are reported and freed with their blocks
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			for (auto & target : m_pools)
+			{
+				for (auto & current : target.blocks)
+				{
+					if (current->allocations != 0)
+					{
+						std::cout << "px::vk_memory - " << current->allocations << " " << name(current->kind) << " allocations leaked" << std::endl;
+					}
+					vkFreeMemory(m_device, current->memory, m_allocator);
+				}
+			}
+			m_pools.clear();
+			m_heaps.clear();
+			m_query = nullptr;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_memory() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_profile(nullptr)
+			, m_query(nullptr)
+			, m_pressure(0.9f)
+			, m_token(0)
+		{
+		}
+		vk_memory(vk_memory const&) = delete;
+		vk_memory& operator=(vk_memory const&) = delete;
+		~vk_memory()
+		{
+			release();
+		}
+
+	private:
+		friend class vk_defragmenter;
+
+		struct pool
+		{
+			std::vector<std::unique_ptr<block>> blocks;
+		};
+		struct heap_data
+		{
+			VkDeviceSize allocated;
+			VkDeviceSize used;
+			uint32_t blocks;
+			uint32_t allocations;
+			VkDeviceSize budget;
+			VkDeviceSize usage; // reported by driver, zero without extension
+			VkDeviceSize queried; // allocated bytes at time of last query
+			uint32_t settle; // updates left before next notification
+			bool pressured; // was over threshold, headroom is reported since
+		};
+
+	private:
+		static const VkDeviceSize small_block = 4 * 1024 * 1024;
+		static const VkDeviceSize large_heap = 512 * 1024 * 1024;
+		static const VkDeviceSize large_block = 64 * 1024 * 1024;
+		static const uint32_t settle_frames = 8;
+
+	private:
+		// preferred block size, eighth of small heaps
+		VkDeviceSize block_size(uint32_t type) const noexcept
+		{
+			VkDeviceSize heap = m_profile->memory().memoryHeaps[m_profile->memory().memoryTypes[type].heapIndex].size;
+			return heap >= large_heap ? VkDeviceSize{ large_block } : heap / 8;
+		}
+		// driver usage of last query corrected by own allocations since, own blocks without extension
+		VkDeviceSize usage_of(uint32_t heap) const noexcept
+		{
+			heap_data const& current = m_heaps[heap];
+			if (m_query == nullptr)
+			{
+				return current.allocated;
+			}
+			if (current.allocated >= current.queried)
+			{
+				return current.usage + (current.allocated - current.queried);
+			}
+			return current.usage - std::min(current.usage, current.queried - current.allocated);
+		}
+		void query_budget() noexcept
+		{
+			VkPhysicalDeviceMemoryProperties const& memory = m_profile->memory();
+			if (m_query == nullptr)
+			{
+				for (uint32_t i = 0; i != m_heaps.size(); ++i)
+				{
+					m_heaps[i].budget = memory.memoryHeaps[i].size / 10 * 8; // other processes and driver need some
+				}
+				return;
+			}
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+			VkPhysicalDeviceMemoryProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 };
+			properties.pNext = &budget;
+			m_query(*m_profile, &properties);
+			for (uint32_t i = 0; i != m_heaps.size(); ++i)
+			{
+				m_heaps[i].budget = budget.heapBudget[i];
+				m_heaps[i].usage = budget.heapUsage[i];
+				m_heaps[i].queried = m_heaps[i].allocated;
+			}
+		}
+		bool fits_budget(uint32_t type, VkDeviceSize size) const noexcept
+		{
+			uint32_t heap = m_profile->memory().memoryTypes[type].heapIndex;
+			return usage_of(heap) + size <= m_heaps[heap].budget;
+		}
+		uint32_t choose(uint32_t filter, VkDeviceSize size, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required) const
+		{
+			VkPhysicalDeviceMemoryProperties const& memory = m_profile->memory();
+			auto find = [&](VkMemoryPropertyFlags flags, bool budget) {
+				for (uint32_t i = 0; i != memory.memoryTypeCount; ++i)
+				{
+					if ((filter & (1 << i)) && (memory.memoryTypes[i].propertyFlags & flags) == flags && (!budget || fits_budget(i, size)))
+					{
+						return i;
+					}
+				}
+				return memory.memoryTypeCount;
+			};
+			uint32_t type = find(preferred | required, true);
+			if (type == memory.memoryTypeCount)
+			{
+				type = find(required, true);
+			}
+			if (type == memory.memoryTypeCount)
+			{
+				type = find(required, false); // over budget everywhere, driver may still page
+			}
+			if (type == memory.memoryTypeCount)
+			{
+				throw std::runtime_error("px::vk_memory::choose() - no memory type with required properties");
+			}
+			return type;
+		}
+
+		block & create_block(pool & target, uint32_t type, category kind, VkDeviceSize size, bool dedicated)
+		{
+			std::unique_ptr<block> created(new block{});
+			created->size = size;
+			created->type = type;
+			created->heap = m_profile->memory().memoryTypes[type].heapIndex;
+			created->kind = kind;
+			created->dedicated = dedicated;
+			created->free.push_back({ 0, size });
+
+			VkMemoryAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+			allocate_info.allocationSize = size;
+			allocate_info.memoryTypeIndex = type;
+			if (vkAllocateMemory(m_device, &allocate_info, m_allocator, &created->memory) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_memory::create_block() - failed to allocate device memory");
+			}
+			if ((m_profile->memory().memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+			{
+				void * data = nullptr;
+				if (vkMapMemory(m_device, created->memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+				{
+					vkFreeMemory(m_device, created->memory, m_allocator);
+					throw std::runtime_error("px::vk_memory::create_block() - failed to map device memory");
+				}
+				created->data = static_cast<char*>(data);
+			}
+
+			heap_data & heap = m_heaps[created->heap];
+			heap.allocated += size;
+			++heap.blocks;
+			target.blocks.push_back(std::move(created));
+			return *target.blocks.back();
+		}
+		void destroy_block(pool & target, block & victim) noexcept
+		{
+			heap_data & heap = m_heaps[victim.heap];
+			heap.allocated -= victim.size;
+			--heap.blocks;
+			vkFreeMemory(m_device, victim.memory, m_allocator); // implicitly unmapped
+			target.blocks.erase(std::find_if(std::begin(target.blocks), std::end(target.blocks), [&victim](std::unique_ptr<block> const& current) { return current.get() == &victim; }));
+		}
+
+		// best fit free range with aligned offset, range is carved and remainders on both sides stay free
+		static bool fit(block & target, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize & offset) noexcept
+		{
+			size_t best = target.free.size();
+			for (size_t i = 0, count = target.free.size(); i != count; ++i)
+			{
+				block::range const& current = target.free[i];
+				VkDeviceSize aligned = (current.offset + alignment - 1) / alignment * alignment;
+				if (aligned + size <= current.offset + current.size && (best == count || current.size < target.free[best].size))
+				{
+					best = i;
+				}
+			}
+			if (best == target.free.size())
+			{
+				return false;
+			}
+
+			block::range found = target.free[best];
+			offset = (found.offset + alignment - 1) / alignment * alignment;
+			block::range front{ found.offset, offset - found.offset };
+			block::range back{ offset + size, found.offset + found.size - offset - size };
+			target.free.erase(target.free.begin() + best);
+			if (back.size != 0)
+			{
+				target.free.insert(target.free.begin() + best, back);
+			}
+			if (front.size != 0)
+			{
+				target.free.insert(target.free.begin() + best, front);
+			}
+			return true;
+		}
+		static void give(block & target, VkDeviceSize offset, VkDeviceSize size)
+		{
+			auto next = std::lower_bound(std::begin(target.free), std::end(target.free), offset, [](block::range const& current, VkDeviceSize value) { return current.offset < value; });
+			if (next != std::end(target.free) && offset + size == next->offset)
+			{
+				next->offset = offset;
+				next->size += size;
+			}
+			else
+			{
+				next = target.free.insert(next, { offset, size });
+			}
+			if (next != std::begin(target.free))
+			{
+				auto previous = next - 1;
+				if (previous->offset + previous->size == next->offset)
+				{
+					previous->size += next->size;
+					target.free.erase(next);
+				}
+			}
+		}
+		pool & pool_of(block const& target) noexcept
+		{
+			return m_pools[target.type * category_count + static_cast<uint32_t>(target.kind)];
+		}
+		// room for moved allocation in other blocks of the same pool, no block is created
+		bool place(block const& source, VkDeviceSize size, VkDeviceSize alignment, allocation & result) noexcept
+		{
+			for (auto & current : pool_of(source).blocks)
+			{
+				VkDeviceSize offset;
+				if (current.get() != &source && !current->dedicated && !current->draining && fit(*current, size, alignment, offset))
+				{
+					result = take(*current, offset, size, alignment);
+					return true;
+				}
+			}
+			return false;
+		}
+		allocation take(block & target, VkDeviceSize offset, VkDeviceSize size, VkDeviceSize alignment) noexcept
+		{
+			target.used += size;
+			++target.allocations;
+			heap_data & heap = m_heaps[target.heap];
+			heap.used += size;
+			++heap.allocations;
+			return{ target.memory, offset, size, alignment, target.data != nullptr ? target.data + offset : nullptr, &target };
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_device_profile const* m_profile;
+		PFN_vkGetPhysicalDeviceMemoryProperties2 m_query; // null without budget extension
+
+		mutable std::mutex m_mutex;
+		std::vector<pool> m_pools; // by memory type and category
+		std::vector<heap_data> m_heaps;
+		float m_pressure;
+
+		std::vector<std::pair<uint32_t, budget_fn>> m_subscribers; // render thread only
+		uint32_t m_token;
+	};
+}
@@ -0,0 +1,604 @@
+// name: vk_pipeline_registry
+// type: c++ header
+// desc: registry of graphics pipeline variants compiled in background
+// auth: is0urce
+
+#pragma once
+
+// pipelines are keyed by full fixed-function state, shader set and specialization constants, identical requests share one pipeline
+// compilation runs as jobs on shared job system, all sharing single pipeline cache
+// lookup of pipeline not compiled yet returns fallback pipeline, so recording never waits for compiler
+// viewport and scissor are dynamic, so variants not depend on swapchain extent
+
+#include <vulkan/vulkan.hpp>
+
+#include "core/job_system.hpp"
+#include "vk_specialization.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace px
+{
+	enum class blend_mode : int
+	{
+		opaque,
+		alpha,
+		additive,
+		multiply
+	};
+
+	struct pipeline_state
+	{
+		std::string vertex_shader;
+		std::string fragment_shader;
+		vk_specialization vertex_constants;
+		vk_specialization fragment_constants;
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+		VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkPolygonMode polygon = VK_POLYGON_MODE_FILL;
+		VkCullModeFlags cull = VK_CULL_MODE_BACK_BIT;
+		VkFrontFace front = VK_FRONT_FACE_CLOCKWISE;
+		blend_mode blend = blend_mode::opaque;
+		bool depth_test = false;
+		bool depth_write = false;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		bool operator==(pipeline_state const& other) const noexcept
+		{
+			return vertex_shader == other.vertex_shader
+				&& fragment_shader == other.fragment_shader
+				&& vertex_constants == other.vertex_constants
+				&& fragment_constants == other.fragment_constants
+				&& std::equal(std::begin(bindings), std::end(bindings), std::begin(other.bindings), std::end(other.bindings), [](auto const& a, auto const& b) {
+					return a.binding == b.binding && a.stride == b.stride && a.inputRate == b.inputRate; })
+				&& std::equal(std::begin(attributes), std::end(attributes), std::begin(other.attributes), std::end(other.attributes), [](auto const& a, auto const& b) {
+					return a.location == b.location && a.binding == b.binding && a.format == b.format && a.offset == b.offset; })
+				&& topology == other.topology
+				&& polygon == other.polygon
+				&& cull == other.cull
+				&& front == other.front
+				&& blend == other.blend
+				&& depth_test == other.depth_test
+				&& depth_write == other.depth_write
+				&& layout == other.layout;
+		}
+		bool operator!=(pipeline_state const& other) const noexcept
+		{
+			return !operator==(other);
+		}
+		size_t hash() const noexcept
+		{
+			size_t seed = 0;
+			combine(seed, std::hash<std::string>{}(vertex_shader));
+			combine(seed, std::hash<std::string>{}(fragment_shader));
+			combine(seed, vertex_constants.hash());
+			combine(seed, fragment_constants.hash());
+			for (auto const& binding : bindings)
+			{
+				combine(seed, binding.binding);
+				combine(seed, binding.stride);
+				combine(seed, binding.inputRate);
+			}
+			for (auto const& attribute : attributes)
+			{
+				combine(seed, attribute.location);
+				combine(seed, attribute.binding);
+				combine(seed, attribute.format);
+				combine(seed, attribute.offset);
+			}
+			combine(seed, topology);
+			combine(seed, polygon);
+			combine(seed, cull);
+			combine(seed, front);
+			combine(seed, static_cast<int>(blend));
+			combine(seed, depth_test);
+			combine(seed, depth_write);
+			combine(seed, std::hash<VkPipelineLayout>{}(layout));
+			return seed;
+		}
+
+	private:
+		template <typename T>
+		static void combine(size_t & seed, T value) noexcept
+		{
+			seed ^= static_cast<size_t>(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		}
+	};
+
+	struct pipeline_state_hash
+	{
+		size_t operator()(pipeline_state const& state) const noexcept
+		{
+			return state.hash();
+		}
+	};
+
+	class vk_pipeline_registry final
+	{
+	public:
+		// returns identifier of pipeline variant, compilation is scheduled as job
+		uint32_t request(pipeline_state const& state)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto found = m_index.find(state);
+			if (found != m_index.end())
+			{
+				return found->second;
+			}
+
+			uint32_t id = static_cast<uint32_t>(m_entries.size());
+			m_entries.push_back(std::make_unique<entry>(state));
+			m_index.emplace(state, id);
+			if (m_renderpass != VK_NULL_HANDLE)
+			{
+				schedule(id);
+			}
+			return id;
+		}
+
+		// compile on calling thread (or wait for job already compiling it) and use as substitute for pipelines not ready
+		void fallback(uint32_t id)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_fallback = id;
+			}
+			compile(id);
+		}
+
+		// pipeline if ready, fallback pipeline otherwise
+		VkPipeline get(uint32_t id) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			VkPipeline pipeline = id < m_entries.size() ? m_entries[id]->pipeline.load() : VK_NULL_HANDLE;
+			if (pipeline == VK_NULL_HANDLE && m_fallback < m_entries.size())
+			{
+				pipeline = m_entries[m_fallback]->pipeline.load();
+			}
+			return pipeline;
+		}
+		bool ready(uint32_t id) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return id < m_entries.size() && m_entries[id]->status.load() == status_ready;
+		}
+
+		// read spir-v ahead of compilation, does not require device
+		void preload(pipeline_state const& state)
+		{
+			shader_code(state.vertex_shader);
+			shader_code(state.fragment_shader);
+		}
+
+		// incremented each time a pipeline is compiled, so users know when to re-record
+		uint32_t generation() const noexcept
+		{
+			return m_generation.load();
+		}
+
+		// all variants are invalidated and recompiled for new render pass and its sample count, identifiers stay valid
+		// pipelines must not be in use by device
+		void renderpass(VkRenderPass pass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				++m_epoch; // scheduled jobs become no-op
+				m_renderpass = pass;
+				m_samples = samples;
+			}
+			if (m_jobs)
+			{
+				m_jobs->wait(m_pending);
+			}
+
+			uint32_t fallback_id;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (auto & current : m_entries)
+				{
+					destroy(*current);
+					current->status = status_queued;
+				}
+				fallback_id = m_fallback;
+			}
+			if (fallback_id < m_entries.size())
+			{
+				compile(fallback_id);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (uint32_t i = 0, size = static_cast<uint32_t>(m_entries.size()); i != size; ++i)
+			{
+				if (m_entries[i]->status.load() == status_queued)
+				{
+					schedule(i);
+				}
+			}
+		}
+		void create(VkDevice device, job_system & jobs, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_jobs = &jobs;
+
+			VkPipelineCacheCreateInfo cache_info{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+			if (vkCreatePipelineCache(m_device, &cache_info, m_allocator, &m_cache) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_pipeline_registry::create() - failed to create pipeline cache");
+			}
+		}
+		void release()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				++m_epoch;
+			}
+			if (m_jobs)
+			{
+				m_jobs->wait(m_pending);
+			}
+			m_jobs = nullptr;
+
+			for (auto & current : m_entries)
+			{
+				destroy(*current);
+			}
+			m_entries.clear();
+			m_index.clear();
+			m_fallback = std::numeric_limits<uint32_t>::max();
+			m_renderpass = VK_NULL_HANDLE;
+			m_samples = VK_SAMPLE_COUNT_1_BIT;
+
+			if (m_cache != VK_NULL_HANDLE)
+			{
+				vkDestroyPipelineCache(m_device, m_cache, m_allocator);
+				m_cache = VK_NULL_HANDLE;
+			}
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_pipeline_registry() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_cache(VK_NULL_HANDLE)
+			, m_renderpass(VK_NULL_HANDLE)
+			, m_samples(VK_SAMPLE_COUNT_1_BIT)
+			, m_fallback(std::numeric_limits<uint32_t>::max())
+			, m_generation(0)
+			, m_jobs(nullptr)
+			, m_epoch(0)
+		{
+		}
+		vk_pipeline_registry(vk_pipeline_registry const&) = delete;
+		vk_pipeline_registry& operator=(vk_pipeline_registry const&) = delete;
+		~vk_pipeline_registry()
+		{
+			release();
+		}
+
+	private:
+		enum : int
+		{
+			status_queued,
+			status_compiling,
+			status_ready,
+			status_failed
+		};
+		struct entry
+		{
+			pipeline_state state;
+			std::atomic<VkPipeline> pipeline;
+			std::atomic<int> status;
+
+			entry(pipeline_state const& key)
+				: state(key)
+				, pipeline(VK_NULL_HANDLE)
+				, status(status_queued)
+			{
+			}
+		};
+
+	private:
+		// called under lock, job skips compilation if render pass changed meanwhile
+		void schedule(uint32_t id)
+		{
+			uint32_t epoch = m_epoch;
+			m_jobs->run([this, id, epoch]() {
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (epoch != m_epoch)
+					{
+						return;
+					}
+				}
+				build(id);
+			}, &m_pending);
+		}
+		void compile(uint32_t id)
+		{
+			build(id);
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			entry & target = *m_entries[id];
+			m_done.wait(lock, [&target]() { return target.status.load() != status_compiling; });
+			if (target.status.load() != status_ready)
+			{
+				throw std::runtime_error("px::vk_pipeline_registry::compile() - failed to create graphics pipeline");
+			}
+		}
+		void build(uint32_t id)
+		{
+			entry * target;
+			VkRenderPass pass;
+			VkSampleCountFlagBits samples;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				target = m_entries[id].get();
+				pass = m_renderpass;
+				samples = m_samples;
+			}
+
+			int expected = status_queued;
+			if (!target->status.compare_exchange_strong(expected, status_compiling))
+			{
+				return; // already compiled or in progress
+			}
+
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			try
+			{
+				pipeline = create_pipeline(target->state, pass, samples);
+			}
+			catch (std::exception const& exception) // job must not throw, failure is reported by status
+			{
+				std::cerr << exception.what() << std::endl;
+			}
+			catch (...)
+			{
+				std::cerr << "px::vk_pipeline_registry::build() - unknown error creating " << target->state.vertex_shader << " " << target->state.fragment_shader << std::endl;
+			}
+
+			target->pipeline.store(pipeline);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				target->status.store(pipeline != VK_NULL_HANDLE ? status_ready : status_failed);
+			}
+			if (pipeline != VK_NULL_HANDLE)
+			{
+				++m_generation;
+			}
+			m_done.notify_all();
+		}
+		void destroy(entry & target)
+		{
+			VkPipeline pipeline = target.pipeline.exchange(VK_NULL_HANDLE);
+			if (pipeline != VK_NULL_HANDLE)
+			{
+				vkDestroyPipeline(m_device, pipeline, m_allocator);
+			}
+		}
+		VkPipeline create_pipeline(pipeline_state const& state, VkRenderPass pass, VkSampleCountFlagBits samples)
+		{
+			VkShaderModule vertex = create_shader(shader_code(state.vertex_shader));
+			VkShaderModule fragment = VK_NULL_HANDLE;
+			try
+			{
+				fragment = create_shader(shader_code(state.fragment_shader));
+			}
+			catch (...)
+			{
+				vkDestroyShaderModule(m_device, vertex, m_allocator);
+				throw;
+			}
+
+			VkSpecializationInfo vertex_specialization = state.vertex_constants.info();
+			VkSpecializationInfo fragment_specialization = state.fragment_constants.info();
+
+			VkPipelineShaderStageCreateInfo vertex_info{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+			vertex_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
+			vertex_info.module = vertex;
+			vertex_info.pName = "main";
+			vertex_info.pSpecializationInfo = state.vertex_constants.empty() ? nullptr : &vertex_specialization;
+			VkPipelineShaderStageCreateInfo fragment_info{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+			fragment_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			fragment_info.module = fragment;
+			fragment_info.pName = "main";
+			fragment_info.pSpecializationInfo = state.fragment_constants.empty() ? nullptr : &fragment_specialization;
+			VkPipelineShaderStageCreateInfo shader_stages[] = { vertex_info, fragment_info };
+
+			VkPipelineVertexInputStateCreateInfo vertex_input_info = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+			vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(state.bindings.size());
+			vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.attributes.size());
+			vertex_input_info.pVertexBindingDescriptions = state.bindings.empty() ? nullptr : state.bindings.data();
+			vertex_input_info.pVertexAttributeDescriptions = state.attributes.empty() ? nullptr : state.attributes.data();
+
+			VkPipelineInputAssemblyStateCreateInfo input_assembly_info = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+			input_assembly_info.topology = state.topology;
+			input_assembly_info.primitiveRestartEnable = VK_FALSE;
+
+			VkPipelineViewportStateCreateInfo viewport_info = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+			viewport_info.viewportCount = 1;
+			viewport_info.pViewports = nullptr; // dynamic
+			viewport_info.scissorCount = 1;
+			viewport_info.pScissors = nullptr; // dynamic
+
+			VkPipelineRasterizationStateCreateInfo rasterizer{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+			rasterizer.depthClampEnable = VK_FALSE;
+			rasterizer.rasterizerDiscardEnable = VK_FALSE;
+			rasterizer.polygonMode = state.polygon;
+			rasterizer.lineWidth = 1.0f;
+			rasterizer.cullMode = state.cull;
+			rasterizer.frontFace = state.front;
+			rasterizer.depthBiasEnable = VK_FALSE;
+
+			VkPipelineMultisampleStateCreateInfo multisampling{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+			multisampling.sampleShadingEnable = VK_FALSE;
+			multisampling.rasterizationSamples = samples;
+			multisampling.minSampleShading = 1.0f;
+			multisampling.pSampleMask = nullptr;
+			multisampling.alphaToCoverageEnable = VK_FALSE;
+			multisampling.alphaToOneEnable = VK_FALSE;
+
+			VkPipelineDepthStencilStateCreateInfo depth_stencil{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+			depth_stencil.depthTestEnable = state.depth_test ? VK_TRUE : VK_FALSE;
+			depth_stencil.depthWriteEnable = state.depth_write ? VK_TRUE : VK_FALSE;
+			depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+			depth_stencil.depthBoundsTestEnable = VK_FALSE;
+			depth_stencil.stencilTestEnable = VK_FALSE;
+
+			VkPipelineColorBlendAttachmentState blend_attachment = blend_state(state.blend);
+			VkPipelineColorBlendStateCreateInfo blending{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+			blending.logicOpEnable = VK_FALSE;
+			blending.attachmentCount = 1;
+			blending.pAttachments = &blend_attachment;
+
+			VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+			VkPipelineDynamicStateCreateInfo dynamic_info{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+			dynamic_info.dynamicStateCount = 2;
+			dynamic_info.pDynamicStates = dynamic_states;
+
+			VkGraphicsPipelineCreateInfo pipeline_info{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+			pipeline_info.stageCount = 2;
+			pipeline_info.pStages = shader_stages;
+			pipeline_info.pVertexInputState = &vertex_input_info;
+			pipeline_info.pInputAssemblyState = &input_assembly_info;
+			pipeline_info.pViewportState = &viewport_info;
+			pipeline_info.pRasterizationState = &rasterizer;
+			pipeline_info.pMultisampleState = &multisampling;
+			pipeline_info.pDepthStencilState = &depth_stencil;
+			pipeline_info.pColorBlendState = &blending;
+			pipeline_info.pDynamicState = &dynamic_info;
+			pipeline_info.layout = state.layout;
+			pipeline_info.renderPass = pass;
+			pipeline_info.subpass = 0; // index of pass
+			pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkResult result = vkCreateGraphicsPipelines(m_device, m_cache, 1, &pipeline_info, m_allocator, &pipeline); // cache is internally synchronized
+
+			vkDestroyShaderModule(m_device, vertex, m_allocator);
+			vkDestroyShaderModule(m_device, fragment, m_allocator);
+
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_pipeline_registry::create_pipeline() - failed to create graphics pipeline " + state.vertex_shader + " " + state.fragment_shader);
+			}
+			return pipeline;
+		}
+		VkShaderModule create_shader(std::vector<char> const& code) const
+		{
+			VkShaderModuleCreateInfo create_info{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+			create_info.codeSize = code.size();
+			create_info.pCode = reinterpret_cast<uint32_t const*>(code.data());
+
+			VkShaderModule shader;
+			if (vkCreateShaderModule(m_device, &create_info, m_allocator, &shader) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_pipeline_registry::create_shader() - failed to create shader module!");
+			}
+			return shader;
+		}
+
+		// spir-v is read once per file and kept for device lifetimes, references to map nodes are stable
+		std::vector<char> const& shader_code(std::string const& name)
+		{
+			std::lock_guard<std::mutex> lock(m_shader_mutex);
+			auto found = m_shaders.find(name);
+			if (found == m_shaders.end())
+			{
+				found = m_shaders.emplace(name, read_file(name)).first;
+			}
+			return found->second;
+		}
+		static std::vector<char> read_file(std::string const& name)
+		{
+			std::ifstream file(name, std::ios::ate | std::ios::binary);
+
+			if (!file.is_open())
+			{
+				throw std::runtime_error("px::vk_pipeline_registry::read_file() - failed to open file " + name);
+			}
+
+			size_t size = static_cast<size_t>(file.tellg());
+			std::vector<char> buffer(size);
+
+			file.seekg(0);
+			file.read(buffer.data(), size);
+
+			file.close();
+
+			return buffer;
+		}
+		static VkPipelineColorBlendAttachmentState blend_state(blend_mode mode) noexcept
+		{
+			VkPipelineColorBlendAttachmentState blend = {};
+			blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+			blend.blendEnable = mode == blend_mode::opaque ? VK_FALSE : VK_TRUE;
+			blend.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			blend.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+			blend.colorBlendOp = VK_BLEND_OP_ADD;
+			blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			blend.alphaBlendOp = VK_BLEND_OP_ADD;
+
+			switch (mode)
+			{
+			case blend_mode::alpha:
+				blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+				blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+				blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+				break;
+			case blend_mode::additive:
+				blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+				blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+				blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+				break;
+			case blend_mode::multiply:
+				blend.srcColorBlendFactor = VK_BLEND_FACTOR_DST_COLOR;
+				blend.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+				break;
+			default:
+				break;
+			}
+			return blend;
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		VkPipelineCache m_cache; // shared by all jobs
+		VkRenderPass m_renderpass;
+		VkSampleCountFlagBits m_samples; // of render pass
+
+		std::vector<std::unique_ptr<entry>> m_entries; // index is pipeline identifier
+		std::unordered_map<pipeline_state, uint32_t, pipeline_state_hash> m_index;
+		uint32_t m_fallback;
+		std::atomic<uint32_t> m_generation;
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_done; // compilation finished
+		job_system * m_jobs;
+		job_counter m_pending; // scheduled compilation jobs
+		uint32_t m_epoch; // incremented with render pass change
+
+		std::mutex m_shader_mutex;
+		std::unordered_map<std::string, std::vector<char>> m_shaders;
+	};
+}
@@ -0,0 +1,98 @@
+// name: vk_present_policy
+// type: c++ header
+// desc: presentation mode and swapchain depth chosen by latency or throughput preference
+// auth: is0urce
+
+#pragma once
+
+// low latency - newest frame shown on next vblank without tearing (mailbox), fifo with one image in flight otherwise, default
+// vsync - classic fifo with one image in flight for smooth throughput
+// uncapped - no waiting for vblank at all (immediate), tearing allowed, only policy that may tear
+// power saving - fifo with minimal number of images, device idles between vblanks
+// unsupported modes fall back along preference list, fifo is always available
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	enum class present_policy : int
+	{
+		low_latency,
+		vsync,
+		uncapped,
+		power_saving
+	};
+
+	struct vk_present_config
+	{
+		VkPresentModeKHR mode;
+		uint32_t image_count;
+	};
+
+	inline char const* to_string(present_policy policy) noexcept
+	{
+		switch (policy)
+		{
+		case present_policy::low_latency: return "low latency";
+		case present_policy::vsync: return "vsync";
+		case present_policy::uncapped: return "uncapped";
+		case present_policy::power_saving: return "power saving";
+		default: return "unknown";
+		}
+	}
+
+	inline char const* to_string(VkPresentModeKHR mode) noexcept
+	{
+		switch (mode)
+		{
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+		default: return "unknown";
+		}
+	}
+
+	inline vk_present_config choose_present_config(present_policy policy, std::vector<VkPresentModeKHR> const& modes, VkSurfaceCapabilitiesKHR const& capabilities)
+	{
+		std::vector<VkPresentModeKHR> preference;
+		switch (policy)
+		{
+		case present_policy::low_latency:
+			preference = { VK_PRESENT_MODE_MAILBOX_KHR };
+			break;
+		case present_policy::uncapped:
+			preference = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+			break;
+		default:
+			break; // fifo
+		}
+
+		vk_present_config config{ VK_PRESENT_MODE_FIFO_KHR, capabilities.minImageCount + 1 };
+		for (auto mode : preference)
+		{
+			if (std::find(std::begin(modes), std::end(modes), mode) != std::end(modes))
+			{
+				config.mode = mode;
+				break;
+			}
+		}
+
+		// mailbox needs spare image to replace queued one, power saving gets shallowest queue
+		if (policy == present_policy::power_saving)
+		{
+			config.image_count = std::max(capabilities.minImageCount, 2u);
+		}
+
+		// zero maximum means no limit besides memory
+		if (capabilities.maxImageCount > 0)
+		{
+			config.image_count = std::min(config.image_count, capabilities.maxImageCount);
+		}
+		return config;
+	}
+}
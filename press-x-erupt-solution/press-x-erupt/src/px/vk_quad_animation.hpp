@@ -0,0 +1,236 @@
+// name: vk_quad_animation
+// type: c++ header
+// desc: vertices of default quad rotated every frame by compute pass
+// auth: is0urce
+
+#pragma once
+
+// one vertex buffer per frame slot, compute writes it whole and graphics of the same slot reads it as vertex input
+// compute of slot is recorded after fence of slot was waited, so graphics of previous frame in slot is done with buffer
+// buffers are shared through vk_async_compute, on dedicated compute family they change owner every frame
+// vertex layout matches renderer::vertex, two floats of position and three of color without padding
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_async_compute.hpp"
+#include "vk_memory.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class vk_quad_animation final
+	{
+	public:
+		bool created() const noexcept
+		{
+			return m_device != VK_NULL_HANDLE;
+		}
+		VkBuffer buffer(uint32_t slot) const noexcept
+		{
+			return m_slots[slot].buffer;
+		}
+
+		// quad rotated by angle in radians, recorded into compute commands of recorder slot
+		void record(vk_async_compute::recorder & context, float angle)
+		{
+			slot_data const& current = m_slots[context.slot()];
+			VkCommandBuffer commands = context.commands();
+			vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+			vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &current.set, 0, nullptr);
+			vkCmdPushConstants(commands, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(angle), &angle);
+			vkCmdDispatch(commands, 1, 1, 1); // one invocation per vertex
+			context.share(current.buffer, 0, size, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		}
+
+		void create(VkDevice device, vk_memory & memory, uint32_t slots, std::string const& shader, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_memory = &memory;
+
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = 0;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			binding.descriptorCount = 1;
+			binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			VkDescriptorSetLayoutCreateInfo set_layout_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+			set_layout_info.bindingCount = 1;
+			set_layout_info.pBindings = &binding;
+			if (vkCreateDescriptorSetLayout(m_device, &set_layout_info, m_allocator, &m_set_layout) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_quad_animation::create() - failed to create descriptor set layout");
+			}
+
+			VkPushConstantRange push_range{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float) };
+			VkPipelineLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+			layout_info.setLayoutCount = 1;
+			layout_info.pSetLayouts = &m_set_layout;
+			layout_info.pushConstantRangeCount = 1;
+			layout_info.pPushConstantRanges = &push_range;
+			if (vkCreatePipelineLayout(m_device, &layout_info, m_allocator, &m_layout) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_quad_animation::create() - failed to create pipeline layout");
+			}
+
+			create_pipeline(shader);
+
+			VkDescriptorPoolSize pool_size{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slots };
+			VkDescriptorPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+			pool_info.maxSets = slots;
+			pool_info.poolSizeCount = 1;
+			pool_info.pPoolSizes = &pool_size;
+			if (vkCreateDescriptorPool(m_device, &pool_info, m_allocator, &m_pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_quad_animation::create() - failed to create descriptor pool");
+			}
+
+			m_slots.resize(slots);
+			for (auto & current : m_slots)
+			{
+				create_slot(current);
+			}
+		}
+		// device must be done with buffers
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			for (auto & current : m_slots)
+			{
+				vkDestroyBuffer(m_device, current.buffer, m_allocator);
+				m_memory->free(current.memory);
+			}
+			m_slots.clear();
+			vkDestroyDescriptorPool(m_device, m_pool, m_allocator); // frees sets
+			vkDestroyPipeline(m_device, m_pipeline, m_allocator);
+			vkDestroyPipelineLayout(m_device, m_layout, m_allocator);
+			vkDestroyDescriptorSetLayout(m_device, m_set_layout, m_allocator);
+			m_pool = VK_NULL_HANDLE;
+			m_pipeline = VK_NULL_HANDLE;
+			m_layout = VK_NULL_HANDLE;
+			m_set_layout = VK_NULL_HANDLE;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_quad_animation() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_memory(nullptr)
+			, m_set_layout(VK_NULL_HANDLE)
+			, m_layout(VK_NULL_HANDLE)
+			, m_pipeline(VK_NULL_HANDLE)
+			, m_pool(VK_NULL_HANDLE)
+		{
+		}
+		vk_quad_animation(vk_quad_animation const&) = delete;
+		vk_quad_animation& operator=(vk_quad_animation const&) = delete;
+		~vk_quad_animation()
+		{
+			release();
+		}
+
+	private:
+		struct slot_data
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vk_memory::allocation memory{};
+			VkDescriptorSet set = VK_NULL_HANDLE;
+		};
+
+	private:
+		static const VkDeviceSize size = 4 * 5 * sizeof(float); // four vertices
+
+	private:
+		void create_pipeline(std::string const& shader)
+		{
+			std::ifstream file(shader, std::ios::ate | std::ios::binary);
+			if (!file.is_open())
+			{
+				throw std::runtime_error("px::vk_quad_animation::create_pipeline() - failed to open file " + shader);
+			}
+			std::vector<char> code(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(code.data(), code.size());
+
+			VkShaderModuleCreateInfo module_info{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+			module_info.codeSize = code.size();
+			module_info.pCode = reinterpret_cast<uint32_t const*>(code.data());
+			VkShaderModule module;
+			if (vkCreateShaderModule(m_device, &module_info, m_allocator, &module) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_quad_animation::create_pipeline() - failed to create shader module");
+			}
+
+			VkComputePipelineCreateInfo pipeline_info{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+			pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipeline_info.stage.module = module;
+			pipeline_info.stage.pName = "main";
+			pipeline_info.layout = m_layout;
+			VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipeline_info, m_allocator, &m_pipeline);
+			vkDestroyShaderModule(m_device, module, m_allocator);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_quad_animation::create_pipeline() - failed to create compute pipeline " + shader);
+			}
+		}
+		void create_slot(slot_data & current)
+		{
+			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			buffer_info.size = size;
+			buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // owner is handed over by vk_async_compute
+			if (vkCreateBuffer(m_device, &buffer_info, m_allocator, &current.buffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_quad_animation::create_slot() - failed to create vertex buffer");
+			}
+			try
+			{
+				current.memory = m_memory->bind(current.buffer, vk_memory::category::vertex, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			}
+			catch (...)
+			{
+				vkDestroyBuffer(m_device, current.buffer, m_allocator);
+				current.buffer = VK_NULL_HANDLE;
+				throw;
+			}
+
+			VkDescriptorSetAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+			allocate_info.descriptorPool = m_pool;
+			allocate_info.descriptorSetCount = 1;
+			allocate_info.pSetLayouts = &m_set_layout;
+			if (vkAllocateDescriptorSets(m_device, &allocate_info, &current.set) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_quad_animation::create_slot() - failed to allocate descriptor set");
+			}
+
+			VkDescriptorBufferInfo buffer_descriptor{ current.buffer, 0, size };
+			VkWriteDescriptorSet write{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+			write.dstSet = current.set;
+			write.dstBinding = 0;
+			write.descriptorCount = 1;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.pBufferInfo = &buffer_descriptor;
+			vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_memory * m_memory;
+		VkDescriptorSetLayout m_set_layout;
+		VkPipelineLayout m_layout;
+		VkPipeline m_pipeline;
+		VkDescriptorPool m_pool;
+		std::vector<slot_data> m_slots;
+	};
+}
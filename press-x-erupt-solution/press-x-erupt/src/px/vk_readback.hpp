@@ -0,0 +1,295 @@
+// name: vk_readback
+// type: c++ header
+// desc: asynchronous copies of rendered frames into host memory
+// auth: is0urce
+
+#pragma once
+
+// requests are queued from any thread and taken by next recorded frame, one copy serves every request of the frame
+// copy of image into host visible buffer is recorded into frame command buffer, nothing waits for device
+// completion is seen when fence of the slot is waited before reuse, then job copies pixels out and calls continuations
+// buffers are pooled and taken until their job finished, frame has no readback if all of them are busy
+// request that could not be served is dropped, its continuation is destroyed without being called
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_memory.hpp"
+#include <px/core/job_system.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	class vk_readback final
+	{
+	public:
+		struct image
+		{
+			uint32_t width;
+			uint32_t height;
+			bool bgra; // channel order of texels, rgba otherwise
+			std::vector<uint8_t> pixels; // rows of four byte texels without padding, top row first
+		};
+		// called on worker thread with pixels of frame
+		typedef std::function<void(image && frame)> done_fn;
+
+	public:
+		// next recorded frame is read back, safe to call from any thread
+		void request(done_fn done)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back(std::move(done));
+			m_requested.store(true, std::memory_order_release);
+		}
+		// future is broken if frame could not be read back
+		std::future<image> request()
+		{
+			auto promise = std::make_shared<std::promise<image>>();
+			std::future<image> result = promise->get_future();
+			request([promise](image && frame) { promise->set_value(std::move(frame)); });
+			return result;
+		}
+
+		// copies of slot submitted before are finished by device, their pixels are handed to job
+		void update(uint32_t slot)
+		{
+			pending & current = m_pending[slot];
+			if (current.source == nullptr)
+			{
+				return;
+			}
+			m_jobs->run([source = current.source, width = current.width, height = current.height, bgra = current.bgra, done = std::move(current.done)]() mutable {
+				image frame{ width, height, bgra, std::vector<uint8_t>(size_t{ width } * height * 4) };
+				std::memcpy(frame.pixels.data(), source->memory.data, frame.pixels.size());
+				source->busy.store(false, std::memory_order_release);
+				for (size_t i = 0; i != done.size(); ++i)
+				{
+					try
+					{
+						if (i + 1 == done.size())
+						{
+							done[i](std::move(frame));
+						}
+						else
+						{
+							done[i](image(frame));
+						}
+					}
+					catch (std::exception const& e)
+					{
+						std::cout << "px::vk_readback - continuation failed, " << e.what() << std::endl;
+					}
+				}
+			}, &m_running);
+			current.source = nullptr;
+			current.done.clear();
+		}
+		// copy of extent of source in transfer source layout, after commands writing it
+		void record(VkCommandBuffer commands, uint32_t slot, VkImage source, VkFormat format, VkExtent2D extent)
+		{
+			if (!m_requested.load(std::memory_order_acquire))
+			{
+				return;
+			}
+			std::vector<done_fn> requests;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				requests.swap(m_requests);
+				m_requested = false;
+			}
+			bool bgra = false;
+			switch (format)
+			{
+			case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_B8G8R8A8_SRGB:
+				bgra = true;
+				break;
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				break;
+			default:
+				std::cout << "px::vk_readback - format " << format << " is not read back, " << requests.size() << " requests dropped" << std::endl;
+				return;
+			}
+			buffer * target = take(VkDeviceSize{ extent.width } * extent.height * 4);
+			if (target == nullptr)
+			{
+				std::cout << "px::vk_readback - all buffers busy, " << requests.size() << " requests dropped" << std::endl;
+				return;
+			}
+
+			VkBufferImageCopy copy{};
+			copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copy.imageExtent = { extent.width, extent.height, 1 };
+			vkCmdCopyImageToBuffer(commands, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target->handle, 1, &copy);
+
+			// host reads after fence, barrier makes transfer writes available to it
+			VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = target->handle;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+			pending & current = m_pending[slot];
+			current.source = target;
+			current.width = extent.width;
+			current.height = extent.height;
+			current.bgra = bgra;
+			current.done = std::move(requests);
+		}
+
+		void create(VkDevice device, vk_memory & memory, job_system & jobs, uint32_t slots, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_memory = &memory;
+			m_jobs = &jobs;
+			m_pending.resize(slots);
+		}
+		// slots not updated since their submission are dropped, device has to be idle
+		void release()
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			m_jobs->wait(m_running);
+			m_pending.clear();
+			for (auto & current : m_buffers)
+			{
+				destroy(*current);
+			}
+			m_buffers.clear();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_requests.clear();
+				m_requested = false;
+			}
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_readback() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_memory(nullptr)
+			, m_jobs(nullptr)
+			, m_requested(false)
+		{
+		}
+		vk_readback(vk_readback const&) = delete;
+		vk_readback& operator=(vk_readback const&) = delete;
+		~vk_readback()
+		{
+			release();
+		}
+
+	private:
+		struct buffer
+		{
+			VkBuffer handle;
+			vk_memory::allocation memory;
+			VkDeviceSize size;
+			std::atomic<bool> busy; // from recorded copy until job copied pixels out
+		};
+		struct pending
+		{
+			buffer * source; // null if slot has no readback
+			uint32_t width;
+			uint32_t height;
+			bool bgra;
+			std::vector<done_fn> done;
+		};
+
+	private:
+		static const size_t max_buffers = 4; // frames in flight and jobs still copying
+
+	private:
+		// free buffer of at least size, too small one is recreated
+		buffer * take(VkDeviceSize size)
+		{
+			buffer * free = nullptr;
+			for (auto & current : m_buffers)
+			{
+				if (current->busy.load(std::memory_order_acquire))
+				{
+					continue;
+				}
+				if (current->size >= size)
+				{
+					current->busy = true;
+					return current.get();
+				}
+				free = current.get();
+			}
+			if (free != nullptr)
+			{
+				destroy(*free);
+			}
+			else if (m_buffers.size() < max_buffers)
+			{
+				m_buffers.emplace_back(new buffer{});
+				free = m_buffers.back().get();
+			}
+			else
+			{
+				return nullptr;
+			}
+
+			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			buffer_info.size = size;
+			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateBuffer(m_device, &buffer_info, m_allocator, &free->handle) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_readback::take() - failed to create readback buffer");
+			}
+			// cached memory makes reads of host fast, coherent spares invalidation
+			free->memory = m_memory->bind(free->handle, vk_memory::category::staging, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			free->size = size;
+			free->busy = true;
+			return free;
+		}
+		void destroy(buffer & target) noexcept
+		{
+			if (target.handle == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			vkDestroyBuffer(m_device, target.handle, m_allocator);
+			m_memory->free(target.memory);
+			target.handle = VK_NULL_HANDLE;
+			target.size = 0;
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_memory * m_memory;
+		job_system * m_jobs;
+
+		std::mutex m_mutex; // requests
+		std::vector<done_fn> m_requests;
+		std::atomic<bool> m_requested; // requests are not empty
+
+		std::vector<std::unique_ptr<buffer>> m_buffers;
+		std::vector<pending> m_pending; // per frame slot
+		job_counter m_running; // pixel copies and continuations
+	};
+}
@@ -0,0 +1,122 @@
+// name: vk_specialization
+// type: c++ header
+// desc: typed specialization constants for shader stages
+// auth: is0urce
+
+#pragma once
+
+// values are copied, so specialization can be a part of pipeline key
+// struct fields map to constant_id in order of declaration in constructor call
+// booleans must be declared as VkBool32, as required by specification
+// setting id again replaces its value, also with type of other width
+//
+// struct lighting { VkBool32 enabled; uint32_t samples; };
+// vk_specialization constants(lighting{ VK_TRUE, 4 }, &lighting::enabled, &lighting::samples); // constant_id 0 and 1
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+namespace px
+{
+	class vk_specialization final
+	{
+	public:
+		template <typename T>
+		vk_specialization & set(uint32_t id, T value)
+		{
+			static_assert(!std::is_same<T, bool>::value, "px::vk_specialization::set() - use VkBool32 for boolean constants");
+			static_assert(std::is_arithmetic<T>::value && (sizeof(T) == 4 || sizeof(T) == 8), "px::vk_specialization::set() - constant must be 32 or 64 bit scalar");
+
+			// entries are kept sorted by id with data laid out in the same order, so equal sets compare equal whatever order they were set in
+			auto found = std::lower_bound(std::begin(m_entries), std::end(m_entries), id, [](VkSpecializationMapEntry const& entry, uint32_t key) { return entry.constantID < key; });
+			uint32_t replaced = 0; // size of previous value of the same id
+			if (found != std::end(m_entries) && found->constantID == id)
+			{
+				replaced = static_cast<uint32_t>(found->size);
+				if (replaced != sizeof(T))
+				{
+					m_data.erase(std::begin(m_data) + found->offset, std::begin(m_data) + found->offset + replaced);
+					m_data.insert(std::begin(m_data) + found->offset, sizeof(T), 0);
+					found->size = sizeof(T);
+				}
+			}
+			else
+			{
+				VkSpecializationMapEntry entry{};
+				entry.constantID = id;
+				entry.offset = found != std::end(m_entries) ? found->offset : static_cast<uint32_t>(m_data.size());
+				entry.size = sizeof(T);
+				m_data.insert(std::begin(m_data) + entry.offset, sizeof(T), 0);
+				found = m_entries.insert(found, entry);
+			}
+			for (auto next = found + 1; next != std::end(m_entries); ++next)
+			{
+				next->offset = next->offset + static_cast<uint32_t>(sizeof(T)) - replaced;
+			}
+			std::memcpy(m_data.data() + found->offset, &value, sizeof(T));
+			return *this;
+		}
+		bool empty() const noexcept
+		{
+			return m_entries.empty();
+		}
+
+		// pointers are valid while this object is alive and unchanged
+		VkSpecializationInfo info() const noexcept
+		{
+			VkSpecializationInfo result{};
+			result.mapEntryCount = static_cast<uint32_t>(m_entries.size());
+			result.pMapEntries = m_entries.empty() ? nullptr : m_entries.data();
+			result.dataSize = m_data.size();
+			result.pData = m_data.empty() ? nullptr : m_data.data();
+			return result;
+		}
+		bool operator==(vk_specialization const& other) const noexcept
+		{
+			return m_data == other.m_data
+				&& m_entries.size() == other.m_entries.size()
+				&& std::equal(std::begin(m_entries), std::end(m_entries), std::begin(other.m_entries), [](auto const& a, auto const& b) {
+					return a.constantID == b.constantID && a.offset == b.offset && a.size == b.size; });
+		}
+		bool operator!=(vk_specialization const& other) const noexcept
+		{
+			return !operator==(other);
+		}
+		size_t hash() const noexcept
+		{
+			size_t seed = m_entries.size();
+			for (auto const& entry : m_entries)
+			{
+				seed ^= entry.constantID + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			}
+			for (char byte : m_data)
+			{
+				seed ^= static_cast<size_t>(static_cast<unsigned char>(byte)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			}
+			return seed;
+		}
+
+	public:
+		vk_specialization() = default;
+		template <typename Struct, typename... Fields>
+		explicit vk_specialization(Struct const& constants, Fields Struct::*... fields)
+		{
+			uint32_t id = 0;
+			int expand[] = { 0, (set(id++, constants.*fields), 0)... };
+			(void)expand;
+		}
+		vk_specialization(vk_specialization const&) = default;
+		vk_specialization& operator=(vk_specialization const&) = default;
+		vk_specialization(vk_specialization &&) = default;
+		vk_specialization& operator=(vk_specialization &&) = default;
+
+	private:
+		std::vector<VkSpecializationMapEntry> m_entries;
+		std::vector<char> m_data;
+	};
+}
@@ -0,0 +1,234 @@
+// name: vk_sprite_layer
+// type: c++ header
+// desc: per frame instance buffers filled by scene gather and drawn as textured quads
+// auth: is0urce
+
+#pragma once
+
+// every frame slot owns persistently mapped host visible instance buffer, gather of visible objects writes it directly
+// quads are expanded from vertex index, so instance data is the only vertex input
+// bindless mode draws all visible objects at once, classic mode splits draws by texture batches of the gather
+// push constants are the camera part of tilemap block, so both layers share pipeline layout
+// replay feeds captured instances instead of scene, they are copied to the same buffers and drawn the same way
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_memory.hpp"
+#include "vk_texture_table.hpp"
+#include <px/core/scene.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	class vk_sprite_layer final
+	{
+	public:
+		struct push_block
+		{
+			float scale[2]; // world to clip space
+			float offset[2];
+		};
+
+	public:
+		static VkVertexInputBindingDescription binding_description() noexcept
+		{
+			return{ 0, sizeof(scene::instance), VK_VERTEX_INPUT_RATE_INSTANCE };
+		}
+		static std::array<VkVertexInputAttributeDescription, 4> attribute_descriptions() noexcept
+		{
+			return{ {
+				{ 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(scene::instance, position) },
+				{ 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(scene::instance, extent) },
+				{ 2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(scene::instance, color) },
+				{ 3, 0, VK_FORMAT_R32_UINT, offsetof(scene::instance, texture) }
+			} };
+		}
+
+	public:
+		// scene is not owned and edited on render thread only, null detaches
+		void attach(scene * objects) noexcept
+		{
+			m_scene = objects;
+			m_fed = false;
+			m_fed_instances.clear();
+			m_fed_batches.clear();
+			m_count = 0;
+			m_batches.clear();
+		}
+		scene * objects() const noexcept
+		{
+			return m_scene;
+		}
+		// instances drawn every frame in place of scene gather, as replay of captured frames does, scene is detached
+		void feed(std::vector<scene::instance> instances, std::vector<scene::batch> batches)
+		{
+			attach(nullptr);
+			m_fed = true;
+			m_fed_instances = std::move(instances);
+			m_fed_batches = std::move(batches);
+		}
+		// scene attached or instances fed
+		bool attached() const noexcept
+		{
+			return m_scene != nullptr || m_fed;
+		}
+		uint32_t capacity() const noexcept
+		{
+			return m_capacity;
+		}
+		// instances gathered by last update
+		uint32_t visible() const noexcept
+		{
+			return m_count;
+		}
+
+		// gathers scene objects in view into buffer of slot, slot must not be in use by device
+		void update(uint32_t slot, aabb const& view)
+		{
+			m_slot = slot;
+			m_count = 0;
+			m_batches.clear();
+			if (m_fed)
+			{
+				m_count = static_cast<uint32_t>(std::min<size_t>(m_fed_instances.size(), m_capacity));
+				std::copy(std::begin(m_fed_instances), std::begin(m_fed_instances) + m_count, static_cast<scene::instance*>(m_allocations[slot].data));
+				m_batches = m_fed_batches;
+				for (auto & current : m_batches)
+				{
+					current.count = current.first < m_count ? std::min(current.count, m_count - current.first) : 0;
+				}
+				return;
+			}
+			if (m_scene == nullptr)
+			{
+				return;
+			}
+			m_count = m_scene->gather(view, static_cast<scene::instance*>(m_allocations[slot].data), m_capacity, m_batches);
+			if (m_count == m_capacity && !m_overflow)
+			{
+				m_overflow = true;
+				std::cout << "px::vk_sprite_layer - more than " << m_capacity << " objects visible, rest is not drawn" << std::endl;
+			}
+		}
+		// sprite pipeline must be bound
+		void draw(VkCommandBuffer commands, VkPipelineLayout layout, vk_texture_table const& table, push_block const& camera) const
+		{
+			if (m_count == 0)
+			{
+				return;
+			}
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(commands, 0, 1, &m_buffers[m_slot], &offset);
+			vkCmdPushConstants(commands, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_block), &camera);
+			if (table.bindless())
+			{
+				vkCmdDraw(commands, 6, m_count, 0, 0);
+				return;
+			}
+			for (auto const& current : m_batches)
+			{
+				table.bind(commands, layout, m_slot, current.texture);
+				vkCmdDraw(commands, 6, current.count, 0, current.first);
+			}
+		}
+
+		void create(VkDevice device, vk_memory & memory, uint32_t capacity, uint32_t slots, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_memory = &memory;
+			m_capacity = capacity;
+			m_buffers.assign(slots, VK_NULL_HANDLE);
+			m_allocations.assign(slots, vk_memory::allocation{});
+			for (uint32_t i = 0; i != slots; ++i)
+			{
+				VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+				buffer_info.size = VkDeviceSize{ capacity } * sizeof(scene::instance);
+				buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+				buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				if (vkCreateBuffer(m_device, &buffer_info, m_allocator, &m_buffers[i]) != VK_SUCCESS)
+				{
+					m_buffers[i] = VK_NULL_HANDLE;
+					release(); // buffers of previous slots
+					throw std::runtime_error("px::vk_sprite_layer::create() - failed to create instance buffer");
+				}
+
+				// device local and host visible memory is read directly by vertex fetch where available
+				// written by host every frame, so not movable
+				try
+				{
+					m_allocations[i] = memory.bind(m_buffers[i], vk_memory::category::vertex, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				}
+				catch (...)
+				{
+					vkDestroyBuffer(m_device, m_buffers[i], m_allocator);
+					m_buffers[i] = VK_NULL_HANDLE;
+					release(); // buffers of previous slots
+					throw;
+				}
+			}
+		}
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			for (size_t i = 0; i != m_buffers.size(); ++i)
+			{
+				vkDestroyBuffer(m_device, m_buffers[i], m_allocator);
+				m_memory->free(m_allocations[i]);
+			}
+			m_buffers.clear();
+			m_allocations.clear();
+			m_count = 0;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_sprite_layer() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_memory(nullptr)
+			, m_scene(nullptr)
+			, m_fed(false)
+			, m_capacity(0)
+			, m_slot(0)
+			, m_count(0)
+			, m_overflow(false)
+		{
+		}
+		vk_sprite_layer(vk_sprite_layer const&) = delete;
+		vk_sprite_layer& operator=(vk_sprite_layer const&) = delete;
+		~vk_sprite_layer()
+		{
+			release();
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_memory * m_memory;
+		std::vector<VkBuffer> m_buffers; // per frame slot
+		std::vector<vk_memory::allocation> m_allocations; // persistently mapped
+
+		scene * m_scene;
+		bool m_fed; // instances are drawn instead of scene
+		std::vector<scene::instance> m_fed_instances;
+		std::vector<scene::batch> m_fed_batches;
+		uint32_t m_capacity; // instances per slot
+		uint32_t m_slot; // of last update
+		uint32_t m_count;
+		std::vector<scene::batch> m_batches;
+		bool m_overflow; // reported
+	};
+}
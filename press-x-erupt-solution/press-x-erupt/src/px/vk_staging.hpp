@@ -0,0 +1,124 @@
+// name: vk_staging
+// type: c++ header
+// desc: persistently mapped staging ring for batched uploads in frame command buffers
+// auth: is0urce
+
+#pragma once
+
+// one host visible buffer split into region per frame slot, region is reused after fence of its slot was waited
+// allocations are linear within frame, copies are recorded by callers into command buffer of the same slot
+// failed allocation means frame budget is exhausted, upload is retried next frame
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_memory.hpp"
+
+#include <stdexcept>
+
+namespace px
+{
+	class vk_staging final
+	{
+	public:
+		struct range
+		{
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			void * data; // null if allocation failed
+		};
+
+	public:
+		VkDeviceSize capacity() const noexcept
+		{
+			return m_capacity;
+		}
+		// bytes allocated in current slot
+		VkDeviceSize used() const noexcept
+		{
+			return m_offset - m_slot * m_capacity;
+		}
+
+		// starts allocation in slot, previous use of slot must be finished by device
+		void begin(uint32_t slot) noexcept
+		{
+			m_slot = slot;
+			m_offset = slot * m_capacity;
+		}
+		range allocate(VkDeviceSize size, VkDeviceSize alignment = 16) noexcept
+		{
+			VkDeviceSize offset = (m_offset + alignment - 1) / alignment * alignment;
+			if (offset + size > (m_slot + 1) * m_capacity)
+			{
+				return{ m_buffer, 0, nullptr };
+			}
+			m_offset = offset + size;
+			return{ m_buffer, offset, static_cast<char*>(m_data) + offset };
+		}
+
+		void create(VkDevice device, vk_memory & memory, VkDeviceSize capacity, uint32_t slots, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_memory = &memory;
+			m_capacity = capacity;
+
+			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			buffer_info.size = capacity * slots;
+			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateBuffer(m_device, &buffer_info, m_allocator, &m_buffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_staging::create() - failed to create staging buffer");
+			}
+
+			m_allocation = memory.bind(m_buffer, vk_memory::category::staging, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			m_data = m_allocation.data;
+			begin(0);
+		}
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			vkDestroyBuffer(m_device, m_buffer, m_allocator);
+			m_memory->free(m_allocation);
+			m_buffer = VK_NULL_HANDLE;
+			m_data = nullptr;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_staging() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_memory(nullptr)
+			, m_buffer(VK_NULL_HANDLE)
+			, m_allocation{}
+			, m_data(nullptr)
+			, m_capacity(0)
+			, m_slot(0)
+			, m_offset(0)
+		{
+		}
+		vk_staging(vk_staging const&) = delete;
+		vk_staging& operator=(vk_staging const&) = delete;
+		~vk_staging()
+		{
+			release();
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_memory * m_memory;
+		VkBuffer m_buffer;
+		vk_memory::allocation m_allocation;
+		void * m_data;
+		VkDeviceSize m_capacity; // per slot
+		uint32_t m_slot;
+		VkDeviceSize m_offset; // next free byte of whole buffer
+	};
+}
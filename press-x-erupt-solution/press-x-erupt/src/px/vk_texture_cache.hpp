@@ -0,0 +1,660 @@
+// name: vk_texture_cache
+// type: c++ header
+// desc: textures streamed by mip level within device memory budget
+// auth: is0urce
+
+#pragma once
+
+// loading is asynchronous, header and smallest levels (tail) are read by job, texture has view after they are uploaded
+// higher levels are read by jobs one at a time for recently used textures, each arrival rebuilds image with one more level
+// resident levels are copied image to image, so only new data passes through staging ring of frame
+// formats device can not sample are decoded to rgba8 by the read jobs, if decoder exists
+// over budget least recently used textures lose their largest levels by the same rebuild, tail is never evicted
+// replaced images are destroyed when frame slot which recorded the rebuild comes around again
+// everything besides file reads runs on render thread, views change with rebuilds, so they are fetched every frame
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_device_profile.hpp"
+#include "vk_memory.hpp"
+#include "vk_staging.hpp"
+#include "vk_texture_file.hpp"
+#include "vk_texture_format.hpp"
+#include <px/core/job_system.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	class vk_texture_cache final
+	{
+	public:
+		// identifier is index, stable for lifetime of cache
+		uint32_t load(std::string const& path)
+		{
+			uint32_t id = static_cast<uint32_t>(m_textures.size());
+			m_textures.emplace_back();
+			texture & created = m_textures.back();
+			created.path = path;
+			created.used = m_frame; // streams right after load, even if not drawn yet
+			created.streaming = true;
+			++m_streams;
+
+			m_jobs->run([this, id, path]() {
+				arrival result;
+				result.texture = id;
+				result.header = true;
+				try
+				{
+					result.file.open(path);
+					result.format = choose_texture_format(result.file.format(), *m_profile);
+					if (result.format.upload != VK_FORMAT_UNDEFINED)
+					{
+						result.first = tail_level(result.file);
+						result.data = read(result.file, result.format, result.first, result.file.levels());
+					}
+				}
+				catch (std::exception const& e)
+				{
+					result.error = e.what();
+				}
+				deliver(std::move(result));
+			}, &m_pending);
+			return id;
+		}
+		size_t size() const noexcept
+		{
+			return m_textures.size();
+		}
+		std::string const& path(uint32_t id) const
+		{
+			return m_textures.at(id).path;
+		}
+		// null until first levels are resident
+		VkImageView view(uint32_t id) const
+		{
+			return m_textures.at(id).resident.view;
+		}
+		// opaque white texel, sampled in place of textures without resident levels, valid after first update
+		VkImageView fallback() const noexcept
+		{
+			return m_fallback.view;
+		}
+		uint32_t resident_levels(uint32_t id) const
+		{
+			texture const& current = m_textures.at(id);
+			return current.resident.image == VK_NULL_HANDLE ? 0 : current.file.levels() - current.base;
+		}
+		// marks texture as used in current frame, recently used textures stream and are evicted last
+		void touch(uint32_t id)
+		{
+			m_textures.at(id).used = m_frame;
+		}
+
+		// bytes of device memory for texture images, tails are kept even if they alone exceed it
+		void budget(VkDeviceSize bytes) noexcept
+		{
+			m_budget = bytes;
+		}
+		VkDeviceSize budget() const noexcept
+		{
+			return m_budget;
+		}
+		VkDeviceSize usage() const noexcept
+		{
+			return m_usage;
+		}
+
+		// records uploads, rebuilds and evictions into frame command buffer before its render pass
+		// fence of slot must be waited, so staging region and retired images of slot are free
+		void update(VkCommandBuffer commands, uint32_t slot)
+		{
+			++m_frame;
+			retire(slot);
+			m_staging.begin(slot);
+
+			if (m_fallback_pending)
+			{
+				upload_fallback(commands);
+			}
+			receive();
+			upload(commands, slot);
+			evict(commands, slot);
+			stream();
+		}
+
+		void create(VkDevice device, vk_device_profile const& profile, vk_memory & memory, job_system & jobs, VkDeviceSize staging, uint32_t slots, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_profile = &profile;
+			m_memory = &memory;
+			m_jobs = &jobs;
+			m_staging.create(device, memory, staging, slots, allocator);
+			m_retired.resize(slots);
+			m_fallback = create_image(VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 1);
+			m_fallback_pending = true;
+		}
+		void release()
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			m_jobs->wait(m_pending);
+
+			for (uint32_t slot = 0; slot != m_retired.size(); ++slot)
+			{
+				retire(slot);
+			}
+			for (auto & current : m_textures)
+			{
+				destroy(current.resident);
+			}
+			destroy(m_fallback);
+			m_textures.clear();
+			m_incoming.clear();
+			m_arrivals.clear();
+			m_retired.clear();
+			m_staging.release();
+			m_usage = 0;
+			m_streams = 0;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_texture_cache() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_profile(nullptr)
+			, m_memory(nullptr)
+			, m_jobs(nullptr)
+			, m_budget(256 * 1024 * 1024)
+			, m_usage(0)
+			, m_frame(0)
+			, m_streams(0)
+			, m_fallback{}
+			, m_fallback_pending(false)
+		{
+		}
+		vk_texture_cache(vk_texture_cache const&) = delete;
+		vk_texture_cache& operator=(vk_texture_cache const&) = delete;
+		~vk_texture_cache()
+		{
+			release();
+		}
+
+	private:
+		struct allocation
+		{
+			VkImage image;
+			vk_memory::allocation memory;
+			VkImageView view;
+			VkDeviceSize size;
+		};
+		struct texture
+		{
+			std::string path;
+			vk_texture_file file; // empty until header arrived
+			vk_texture_format format{};
+			allocation resident{};
+			uint32_t base = 0; // first resident level
+			uint32_t tail = 0; // first level loaded with header, never evicted
+			uint32_t limit = 0; // first level which can be streamed, raised when level does not fit staging
+			uint32_t first = 0; // first level of incoming data
+			std::vector<std::vector<char>> incoming;
+			uint64_t used = 0; // frame of last touch
+			bool streaming = false; // read job in flight or data waiting for upload
+			bool failed = false;
+			bool refused = false; // next level did not fit budget, not streamed again until budget or usage changes
+			VkDeviceSize refused_budget = 0;
+			VkDeviceSize refused_usage = 0;
+		};
+		// result of read job
+		struct arrival
+		{
+			uint32_t texture = 0;
+			uint32_t first = 0;
+			bool header = false;
+			vk_texture_file file;
+			vk_texture_format format{};
+			std::vector<std::vector<char>> data;
+			std::string error;
+		};
+
+	private:
+		static const uint32_t tail_size = 128; // largest dimension of levels loaded up front
+		static const uint32_t max_streams = 4; // levels read or waiting for upload at once
+		static const uint64_t recent_frames = 60; // textures used within are streamed
+
+	private:
+		static uint32_t tail_level(vk_texture_file const& file)
+		{
+			for (uint32_t i = 0; i != file.levels(); ++i)
+			{
+				if (std::max(file.at(i).width, file.at(i).height) <= tail_size)
+				{
+					return i;
+				}
+			}
+			return file.levels() - 1;
+		}
+		static VkDeviceSize level_bytes(texture const& current, uint32_t level)
+		{
+			auto const& stored = current.file.at(level);
+			return current.format.decode ? VkDeviceSize{ stored.width } * stored.height * 4 : static_cast<VkDeviceSize>(stored.size);
+		}
+
+		// called from job threads, decoding of each level is spread over job system too
+		std::vector<std::vector<char>> read(vk_texture_file const& file, vk_texture_format const& format, uint32_t first, uint32_t last)
+		{
+			auto result = file.read(first, last);
+			if (format.decode)
+			{
+				for (uint32_t level = first; level != last; ++level)
+				{
+					auto & data = result[level - first];
+					data = decode_blocks(format.source, data, file.at(level).width, file.at(level).height, *m_jobs);
+				}
+			}
+			return result;
+		}
+
+		// called from job threads
+		void deliver(arrival && result)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_arrivals.push_back(std::move(result));
+		}
+		void receive()
+		{
+			std::vector<arrival> arrivals;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				arrivals.swap(m_arrivals);
+			}
+			for (auto & result : arrivals)
+			{
+				texture & current = m_textures[result.texture];
+				if (!result.error.empty())
+				{
+					std::cout << "px::vk_texture_cache - " << result.error << std::endl;
+					current.streaming = false;
+					current.failed = result.header; // only stream failed otherwise, resident levels stay
+					current.limit = current.base;
+					--m_streams;
+					continue;
+				}
+				if (result.header)
+				{
+					current.file = std::move(result.file);
+					current.format = result.format;
+					current.tail = result.first;
+					current.base = current.file.levels();
+					if (current.format.decode)
+					{
+						std::cout << "px::vk_texture_cache - format not sampled by device, decoding to rgba8 " << current.path << std::endl;
+					}
+					if (current.format.upload == VK_FORMAT_UNDEFINED)
+					{
+						std::cout << "px::vk_texture_cache - format neither sampled by device nor decodable " << current.path << std::endl;
+						current.failed = true;
+						current.streaming = false;
+						--m_streams;
+						continue;
+					}
+				}
+				current.first = result.first;
+				current.incoming = std::move(result.data);
+				m_incoming.push_back(result.texture);
+			}
+		}
+
+		void upload_fallback(VkCommandBuffer commands)
+		{
+			vk_staging::range range = m_staging.allocate(4);
+			std::memset(range.data, 0xff, 4);
+
+			VkImageMemoryBarrier transfer = barrier(m_fallback.image, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+			vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &transfer);
+			VkBufferImageCopy copy{};
+			copy.bufferOffset = range.offset;
+			copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copy.imageExtent = { 1, 1, 1 };
+			vkCmdCopyBufferToImage(commands, range.buffer, m_fallback.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+			VkImageMemoryBarrier ready = barrier(m_fallback.image, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ready);
+			m_fallback_pending = false;
+		}
+
+		// incoming data in arrival order, stops at first upload which does not fit staging of this frame
+		void upload(VkCommandBuffer commands, uint32_t slot)
+		{
+			while (!m_incoming.empty())
+			{
+				texture & current = m_textures[m_incoming.front()];
+				bool initial = current.resident.image == VK_NULL_HANDLE;
+
+				VkDeviceSize growth = 0;
+				if (!initial)
+				{
+					VkDeviceSize rebuilt = image_size(current.format.upload, current.file.at(current.first).width, current.file.at(current.first).height, current.file.levels() - current.first);
+					growth = rebuilt > current.resident.size ? rebuilt - current.resident.size : 0;
+				}
+				if (!initial && !make_room(growth, current.used, commands, slot))
+				{
+					current.refused = true;
+					current.refused_budget = m_budget;
+					current.refused_usage = m_usage;
+					drop(current, current.limit); // requested again when budget allows
+					continue;
+				}
+
+				VkDeviceSize staged_before = m_staging.used();
+				std::vector<VkDeviceSize> offsets;
+				VkBuffer buffer = VK_NULL_HANDLE;
+				bool staged = true;
+				for (auto const& level : current.incoming)
+				{
+					vk_staging::range range = m_staging.allocate(level.size());
+					if (range.data == nullptr)
+					{
+						staged = false;
+						break;
+					}
+					std::memcpy(range.data, level.data(), level.size());
+					offsets.push_back(range.offset);
+					buffer = range.buffer;
+				}
+				if (!staged)
+				{
+					if (staged_before != 0)
+					{
+						return; // other uploads took this frame, retried next one
+					}
+					std::cout << "px::vk_texture_cache - level " << current.first << " does not fit staging " << current.path << std::endl;
+					current.failed = initial;
+					drop(current, current.first + 1);
+					continue;
+				}
+
+				rebuild(current, current.first, buffer, offsets, commands, slot);
+				drop(current, current.limit);
+			}
+		}
+		void drop(texture & current, uint32_t limit)
+		{
+			current.incoming.clear();
+			current.streaming = false;
+			current.limit = limit;
+			--m_streams;
+			m_incoming.pop_front();
+		}
+
+		// evicts largest levels of textures used before given frame, until growth fits budget
+		bool make_room(VkDeviceSize growth, uint64_t used, VkCommandBuffer commands, uint32_t slot)
+		{
+			while (m_usage + growth > m_budget)
+			{
+				texture * victim = least_recent(used);
+				if (victim == nullptr)
+				{
+					return false;
+				}
+				rebuild(*victim, victim->base + 1, VK_NULL_HANDLE, {}, commands, slot);
+			}
+			return true;
+		}
+		void evict(VkCommandBuffer commands, uint32_t slot)
+		{
+			make_room(0, m_frame, commands, slot);
+		}
+		texture * least_recent(uint64_t used)
+		{
+			texture * result = nullptr;
+			for (auto & current : m_textures)
+			{
+				if (current.resident.image != VK_NULL_HANDLE && current.base < current.tail && !current.streaming && current.used < used && (result == nullptr || current.used < result->used))
+				{
+					result = &current;
+				}
+			}
+			return result;
+		}
+
+		// next level read for most recently used textures while estimated growth fits budget
+		void stream()
+		{
+			std::vector<texture *> candidates;
+			for (auto & current : m_textures)
+			{
+				if (current.resident.image != VK_NULL_HANDLE && !current.streaming && !current.failed && !refused(current) && current.base > current.limit && m_frame - current.used <= recent_frames)
+				{
+					candidates.push_back(&current);
+				}
+			}
+			std::sort(std::begin(candidates), std::end(candidates), [](texture const* a, texture const* b) { return a->used > b->used; });
+
+			for (texture * current : candidates)
+			{
+				if (m_streams >= max_streams)
+				{
+					break;
+				}
+				uint32_t level = current->base - 1;
+				if (m_usage + level_bytes(*current, level) > m_budget && least_recent(current->used) == nullptr)
+				{
+					continue;
+				}
+
+				current->streaming = true;
+				current->refused = false;
+				++m_streams;
+				uint32_t id = static_cast<uint32_t>(current - m_textures.data());
+				vk_texture_file file = current->file;
+				vk_texture_format format = current->format;
+				m_jobs->run([this, id, level, file, format]() {
+					arrival result;
+					result.texture = id;
+					result.first = level;
+					try
+					{
+						result.data = read(file, format, level, level + 1);
+					}
+					catch (std::exception const& e)
+					{
+						result.error = e.what();
+					}
+					deliver(std::move(result));
+				}, &m_pending);
+			}
+		}
+
+		// refused growth fits only after usage went down or budget changed
+		bool refused(texture const& current) const noexcept
+		{
+			return current.refused && m_budget == current.refused_budget && m_usage >= current.refused_usage;
+		}
+
+		// replaces image with one holding levels from base, resident levels are copied, missing ones come from staging
+		void rebuild(texture & current, uint32_t base, VkBuffer staging, std::vector<VkDeviceSize> const& offsets, VkCommandBuffer commands, uint32_t slot)
+		{
+			vk_texture_file const& file = current.file;
+			allocation previous = current.resident;
+			uint32_t previous_base = current.base;
+			uint32_t levels = file.levels() - base;
+			allocation created = create_image(current.format.upload, file.at(base).width, file.at(base).height, levels);
+
+			std::vector<VkImageMemoryBarrier> barriers;
+			barriers.push_back(barrier(created.image, levels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+			if (previous.image != VK_NULL_HANDLE)
+			{
+				barriers.push_back(barrier(previous.image, file.levels() - previous_base, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+			}
+			vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+			if (previous.image != VK_NULL_HANDLE)
+			{
+				std::vector<VkImageCopy> copies;
+				for (uint32_t level = std::max(base, previous_base); level != file.levels(); ++level)
+				{
+					VkImageCopy copy{};
+					copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - previous_base, 0, 1 };
+					copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - base, 0, 1 };
+					copy.extent = { file.at(level).width, file.at(level).height, 1 };
+					copies.push_back(copy);
+				}
+				vkCmdCopyImage(commands, previous.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, created.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+			}
+			if (!offsets.empty())
+			{
+				std::vector<VkBufferImageCopy> copies;
+				for (uint32_t i = 0; i != offsets.size(); ++i)
+				{
+					VkBufferImageCopy copy{};
+					copy.bufferOffset = offsets[i];
+					copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+					copy.imageExtent = { file.at(base + i).width, file.at(base + i).height, 1 };
+					copies.push_back(copy);
+				}
+				vkCmdCopyBufferToImage(commands, staging, created.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+			}
+
+			VkImageMemoryBarrier ready = barrier(created.image, levels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ready);
+
+			if (previous.image != VK_NULL_HANDLE)
+			{
+				m_usage -= previous.size;
+				m_retired[slot].push_back(previous);
+			}
+			m_usage += created.size;
+			current.resident = created;
+			current.base = base;
+		}
+		static VkImageMemoryBarrier barrier(VkImage image, uint32_t levels, VkImageLayout from, VkImageLayout to, VkAccessFlags src_access, VkAccessFlags dst_access)
+		{
+			VkImageMemoryBarrier result{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+			result.srcAccessMask = src_access;
+			result.dstAccessMask = dst_access;
+			result.oldLayout = from;
+			result.newLayout = to;
+			result.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			result.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			result.image = image;
+			result.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+			return result;
+		}
+
+		static VkImageCreateInfo image_info(VkFormat format, uint32_t width, uint32_t height, uint32_t levels) noexcept
+		{
+			VkImageCreateInfo result{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+			result.imageType = VK_IMAGE_TYPE_2D;
+			result.format = format;
+			result.extent = { width, height, 1 };
+			result.mipLevels = levels;
+			result.arrayLayers = 1;
+			result.samples = VK_SAMPLE_COUNT_1_BIT;
+			result.tiling = VK_IMAGE_TILING_OPTIMAL;
+			result.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // source of next rebuild
+			result.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			result.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			return result;
+		}
+		// bytes image would take, as counted in usage, queried from image without memory
+		VkDeviceSize image_size(VkFormat format, uint32_t width, uint32_t height, uint32_t levels)
+		{
+			VkImageCreateInfo info = image_info(format, width, height, levels);
+			VkImage image;
+			if (vkCreateImage(m_device, &info, m_allocator, &image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_texture_cache::image_size() - failed to create texture image");
+			}
+			VkMemoryRequirements requirements;
+			vkGetImageMemoryRequirements(m_device, image, &requirements);
+			vkDestroyImage(m_device, image, m_allocator);
+			return requirements.size;
+		}
+		allocation create_image(VkFormat format, uint32_t width, uint32_t height, uint32_t levels)
+		{
+			allocation result{};
+
+			VkImageCreateInfo info = image_info(format, width, height, levels);
+			if (vkCreateImage(m_device, &info, m_allocator, &result.image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_texture_cache::create_image() - failed to create texture image");
+			}
+
+			try
+			{
+				result.memory = m_memory->bind(result.image, vk_memory::category::image, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			}
+			catch (...)
+			{
+				destroy(result);
+				throw;
+			}
+			result.size = result.memory.size;
+
+			VkImageViewCreateInfo view_info{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+			view_info.image = result.image;
+			view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view_info.format = format;
+			view_info.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+			view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+			if (vkCreateImageView(m_device, &view_info, m_allocator, &result.view) != VK_SUCCESS)
+			{
+				destroy(result);
+				throw std::runtime_error("px::vk_texture_cache::create_image() - failed to create texture view");
+			}
+			return result;
+		}
+		void destroy(allocation & target) noexcept
+		{
+			vkDestroyImageView(m_device, target.view, m_allocator);
+			vkDestroyImage(m_device, target.image, m_allocator);
+			m_memory->free(target.memory);
+			target = {};
+		}
+		void retire(uint32_t slot) noexcept
+		{
+			for (auto & retired : m_retired[slot])
+			{
+				destroy(retired);
+			}
+			m_retired[slot].clear();
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_device_profile const* m_profile;
+		vk_memory * m_memory;
+		job_system * m_jobs;
+		vk_staging m_staging;
+
+		std::vector<texture> m_textures;
+		std::deque<uint32_t> m_incoming; // textures with data waiting for staging, in arrival order
+		std::vector<std::vector<allocation>> m_retired; // per frame slot
+		VkDeviceSize m_budget;
+		VkDeviceSize m_usage;
+		uint64_t m_frame; // updates so far
+		uint32_t m_streams; // textures with read or upload in flight
+		allocation m_fallback;
+		bool m_fallback_pending; // not uploaded yet
+
+		std::mutex m_mutex;
+		std::vector<arrival> m_arrivals; // finished reads, guarded by mutex
+		job_counter m_pending; // read jobs
+	};
+}
@@ -0,0 +1,306 @@
+// name: vk_texture_file
+// type: c++ header
+// desc: pre-mipped texture container (ktx2, dds) with per level reads
+// auth: is0urce
+
+#pragma once
+
+// only header and level index are read on open, level data is read on demand, so mips can be streamed separately
+// reads open own stream, so different levels can be read from several threads at once
+// 2d single layer textures without supercompression only, level 0 is the largest
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace px
+{
+	// texel block dimensions and bytes, zero bytes for formats containers are not expected to hold
+	struct vk_format_block
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t bytes;
+	};
+
+	inline vk_format_block format_block(VkFormat format) noexcept
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return{ 1, 1, 4 };
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+			return{ 4, 4, 8 };
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			return{ 4, 4, 16 };
+		default:
+			return{ 1, 1, 0 };
+		}
+	}
+
+	class vk_texture_file final
+	{
+	public:
+		struct level
+		{
+			uint64_t offset; // in file
+			uint64_t size;
+			uint32_t width;
+			uint32_t height;
+		};
+
+	public:
+		std::string const& path() const noexcept
+		{
+			return m_path;
+		}
+		VkFormat format() const noexcept
+		{
+			return m_format;
+		}
+		uint32_t levels() const noexcept
+		{
+			return static_cast<uint32_t>(m_levels.size());
+		}
+		level const& at(uint32_t index) const
+		{
+			return m_levels.at(index);
+		}
+
+		// data of levels [first, last), each level in own vector
+		std::vector<std::vector<char>> read(uint32_t first, uint32_t last) const
+		{
+			std::ifstream stream(m_path, std::ios::binary);
+			if (!stream)
+			{
+				throw std::runtime_error("px::vk_texture_file::read() - can't open " + m_path);
+			}
+
+			std::vector<std::vector<char>> result;
+			for (uint32_t i = first; i != last; ++i)
+			{
+				level const& current = m_levels.at(i);
+				result.emplace_back(static_cast<size_t>(current.size));
+				stream.seekg(static_cast<std::streamoff>(current.offset));
+				stream.read(result.back().data(), static_cast<std::streamsize>(current.size));
+				if (!stream)
+				{
+					throw std::runtime_error("px::vk_texture_file::read() - truncated level in " + m_path);
+				}
+			}
+			return result;
+		}
+
+		void open(std::string path)
+		{
+			m_path = path;
+			m_levels.clear();
+
+			std::ifstream stream(m_path, std::ios::binary);
+			if (!stream)
+			{
+				throw std::runtime_error("px::vk_texture_file::open() - can't open " + m_path);
+			}
+
+			char const ktx2[12] = { '\xAB', 'K', 'T', 'X', ' ', '2', '0', '\xBB', '\r', '\n', '\x1A', '\n' };
+			char magic[12] = {};
+			stream.read(magic, sizeof(magic));
+			if (std::memcmp(magic, ktx2, sizeof(magic)) == 0)
+			{
+				open_ktx2(stream);
+			}
+			else if (std::memcmp(magic, "DDS ", 4) == 0)
+			{
+				stream.seekg(4);
+				open_dds(stream);
+			}
+			else
+			{
+				throw std::runtime_error("px::vk_texture_file::open() - unknown container " + m_path);
+			}
+
+			if (m_levels.empty() || m_levels[0].width == 0 || m_levels[0].height == 0)
+			{
+				throw std::runtime_error("px::vk_texture_file::open() - empty texture " + m_path);
+			}
+		}
+
+	public:
+		vk_texture_file() noexcept
+			: m_format(VK_FORMAT_UNDEFINED)
+		{
+		}
+
+	private:
+		template <typename T>
+		static T read_value(std::istream & stream)
+		{
+			T value{};
+			stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+			if (!stream)
+			{
+				throw std::runtime_error("px::vk_texture_file::read_value() - truncated header");
+			}
+			return value;
+		}
+		static uint32_t fourcc(char const* code) noexcept
+		{
+			return static_cast<uint32_t>(code[0]) | static_cast<uint32_t>(code[1]) << 8 | static_cast<uint32_t>(code[2]) << 16 | static_cast<uint32_t>(code[3]) << 24;
+		}
+
+		// identifier, header, index, then level index with largest level first, level data itself is stored smallest first
+		void open_ktx2(std::istream & stream)
+		{
+			uint32_t header[9];
+			for (auto & value : header)
+			{
+				value = read_value<uint32_t>(stream);
+			}
+			uint32_t width = header[2];
+			uint32_t height = std::max(header[3], 1u);
+			if (header[4] > 1 || header[5] > 1 || header[6] > 1)
+			{
+				throw std::runtime_error("px::vk_texture_file::open_ktx2() - only 2d textures supported in " + m_path);
+			}
+			if (header[8] != 0)
+			{
+				throw std::runtime_error("px::vk_texture_file::open_ktx2() - supercompressed textures not supported in " + m_path);
+			}
+			m_format = static_cast<VkFormat>(header[0]);
+
+			stream.seekg(4 * 4 + 2 * 8, std::ios::cur); // data format descriptor, key values and supercompression ranges
+			uint32_t count = std::max(header[7], 1u);
+			for (uint32_t i = 0; i != count; ++i)
+			{
+				level current;
+				current.offset = read_value<uint64_t>(stream);
+				current.size = read_value<uint64_t>(stream);
+				read_value<uint64_t>(stream); // uncompressed length, same without supercompression
+				current.width = std::max(width >> i, 1u);
+				current.height = std::max(height >> i, 1u);
+				m_levels.push_back(current);
+			}
+		}
+
+		// magic, header, optional dx10 extension, then levels largest first
+		void open_dds(std::istream & stream)
+		{
+			uint32_t header[31];
+			for (auto & value : header)
+			{
+				value = read_value<uint32_t>(stream);
+			}
+			uint32_t height = header[2];
+			uint32_t width = header[3];
+			uint32_t count = std::max(header[6], 1u);
+			uint32_t const* pixel_format = header + 18; // size, flags, fourcc, bits, masks
+
+			uint64_t offset = 4 + 124;
+			if (pixel_format[2] == fourcc("DX10"))
+			{
+				uint32_t dxgi = read_value<uint32_t>(stream);
+				uint32_t dimension = read_value<uint32_t>(stream);
+				uint32_t misc = read_value<uint32_t>(stream);
+				uint32_t layers = read_value<uint32_t>(stream);
+				if (dimension != 3 || layers > 1 || (misc & 0x4) != 0) // cube flag, layer count is then in cubes
+				{
+					throw std::runtime_error("px::vk_texture_file::open_dds() - only 2d textures supported in " + m_path);
+				}
+				m_format = dxgi_format(dxgi);
+				offset += 20;
+			}
+			else
+			{
+				m_format = legacy_format(pixel_format);
+			}
+			if ((header[27] & 0x200) != 0 || (header[27] & 0x200000) != 0)
+			{
+				throw std::runtime_error("px::vk_texture_file::open_dds() - cubemaps and volumes not supported in " + m_path);
+			}
+
+			vk_format_block block = format_block(m_format);
+			if (block.bytes == 0)
+			{
+				throw std::runtime_error("px::vk_texture_file::open_dds() - unsupported format in " + m_path);
+			}
+			for (uint32_t i = 0; i != count; ++i)
+			{
+				level current;
+				current.width = std::max(width >> i, 1u);
+				current.height = std::max(height >> i, 1u);
+				current.offset = offset;
+				current.size = uint64_t{ (current.width + block.width - 1) / block.width } * ((current.height + block.height - 1) / block.height) * block.bytes;
+				offset += current.size;
+				m_levels.push_back(current);
+			}
+		}
+
+		static VkFormat dxgi_format(uint32_t dxgi)
+		{
+			switch (dxgi)
+			{
+			case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+			case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+			case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+			case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+			case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+			case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+			case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+			case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+			case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+			case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+			case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+			case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+			default: return VK_FORMAT_UNDEFINED;
+			}
+		}
+		static VkFormat legacy_format(uint32_t const* pixel_format)
+		{
+			uint32_t flags = pixel_format[1];
+			if ((flags & 0x4) != 0) // fourcc
+			{
+				uint32_t code = pixel_format[2];
+				if (code == fourcc("DXT1")) return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+				if (code == fourcc("DXT3")) return VK_FORMAT_BC2_UNORM_BLOCK;
+				if (code == fourcc("DXT5")) return VK_FORMAT_BC3_UNORM_BLOCK;
+				if (code == fourcc("ATI1") || code == fourcc("BC4U")) return VK_FORMAT_BC4_UNORM_BLOCK;
+				if (code == fourcc("ATI2") || code == fourcc("BC5U")) return VK_FORMAT_BC5_UNORM_BLOCK;
+				return VK_FORMAT_UNDEFINED;
+			}
+			if ((flags & 0x40) != 0 && pixel_format[3] == 32) // rgb with 32 bits per pixel
+			{
+				if (pixel_format[4] == 0x000000ff) return VK_FORMAT_R8G8B8A8_UNORM;
+				if (pixel_format[4] == 0x00ff0000) return VK_FORMAT_B8G8R8A8_UNORM;
+			}
+			return VK_FORMAT_UNDEFINED;
+		}
+
+	private:
+		std::string m_path;
+		VkFormat m_format;
+		std::vector<level> m_levels;
+	};
+}
@@ -0,0 +1,70 @@
+// name: vk_texture_format
+// type: c++ header
+// desc: choice between native sampling of stored format and cpu decoding to rgba8
+// auth: is0urce
+
+#pragma once
+
+// block compressed formats are kept compressed in memory when device samples them (bc on desktop, etc2 and astc on mobile)
+// support is taken from format properties, compression features have to be enabled on logical device for them to be reported usable
+// otherwise formats with cpu decoder are uploaded as rgba8 of the same color space, costing four to eight times the memory
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_device_profile.hpp"
+#include <px/core/block_decoder.hpp>
+
+namespace px
+{
+	struct vk_texture_format
+	{
+		VkFormat upload; // format of image, undefined if texture can not be used
+		bool decode; // stored blocks are decoded on cpu
+		block_format source;
+	};
+
+	inline bool decodable(VkFormat format, block_format & source, bool & srgb) noexcept
+	{
+		srgb = false;
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: srgb = true; // fallthrough
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: source = block_format::bc1; return true;
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK: source = block_format::bc1_rgb; return true;
+		case VK_FORMAT_BC2_UNORM_BLOCK: source = block_format::bc2; return true;
+		case VK_FORMAT_BC3_SRGB_BLOCK: srgb = true; // fallthrough
+		case VK_FORMAT_BC3_UNORM_BLOCK: source = block_format::bc3; return true;
+		case VK_FORMAT_BC4_UNORM_BLOCK: source = block_format::bc4; return true;
+		case VK_FORMAT_BC5_UNORM_BLOCK: source = block_format::bc5; return true;
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK: source = block_format::etc2_rgb; return true;
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK: srgb = true; // fallthrough
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK: source = block_format::etc2_rgba; return true;
+		default: return false;
+		}
+	}
+
+	// safe to call from any thread, profile caches format properties under lock
+	inline vk_texture_format choose_texture_format(VkFormat stored, vk_device_profile const& profile)
+	{
+		auto native = [&profile](VkFormat format) {
+			return (profile.format_properties(format).optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+		};
+
+		vk_texture_format result{ VK_FORMAT_UNDEFINED, false, block_format::bc1 };
+		bool srgb;
+		if (native(stored))
+		{
+			result.upload = stored;
+		}
+		else if (decodable(stored, result.source, srgb))
+		{
+			VkFormat decoded = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+			if (native(decoded))
+			{
+				result.upload = decoded;
+				result.decode = true;
+			}
+		}
+		return result;
+	}
+}
@@ -0,0 +1,274 @@
+// name: vk_texture_table
+// type: c++ header
+// desc: texture descriptors for draws, one bindless array or one set per texture
+// auth: is0urce
+
+#pragma once
+
+// bindless - every texture in one partially bound array of combined image samplers, indexed by texture id from instance data
+// set is bound once per frame, so batches split only on pipeline changes
+// classic - without descriptor indexing every texture has own set, bound before draws with different texture
+// both modes use set 0 binding 0, shaders differ in array declaration only
+// every frame slot has own sets, views changed by streaming are written when the slot is reused, pending frames are untouched
+// textures without resident levels get fallback view, so any id loaded so far can be sampled
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_device_profile.hpp"
+#include "vk_instance.hpp"
+#include "vk_texture_cache.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	class vk_texture_table final
+	{
+	public:
+		// descriptor indexing from core 1.2 or extension, feature query needs instance and device of at least 1.1
+		// fills features to chain into device creation and extensions to enable
+		static bool supported(vk_instance const& instance, vk_device_profile const& profile, VkPhysicalDeviceDescriptorIndexingFeatures & features, std::vector<const char*> & extensions)
+		{
+			uint32_t device_version = profile.properties().apiVersion;
+			bool core = device_version >= VK_API_VERSION_1_2 && instance.version() >= VK_API_VERSION_1_2;
+			if (instance.version() < VK_API_VERSION_1_1 || device_version < VK_API_VERSION_1_1 || (!core && !profile.supports(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)))
+			{
+				return false;
+			}
+
+			auto query = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2"));
+			if (query == nullptr)
+			{
+				return false;
+			}
+			VkPhysicalDeviceDescriptorIndexingFeatures available{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+			VkPhysicalDeviceFeatures2 query_features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			query_features.pNext = &available;
+			query(profile, &query_features);
+			if (!available.runtimeDescriptorArray || !available.descriptorBindingPartiallyBound || !available.shaderSampledImageArrayNonUniformIndexing)
+			{
+				return false;
+			}
+
+			features = VkPhysicalDeviceDescriptorIndexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+			features.runtimeDescriptorArray = VK_TRUE;
+			features.descriptorBindingPartiallyBound = VK_TRUE;
+			features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			if (!core)
+			{
+				extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			}
+			return true;
+		}
+
+	public:
+		bool bindless() const noexcept
+		{
+			return m_bindless;
+		}
+		// textures addressable, array size in bindless mode
+		uint32_t capacity() const noexcept
+		{
+			return m_capacity;
+		}
+		VkDescriptorSetLayout layout() const noexcept
+		{
+			return m_layout;
+		}
+
+		// writes views which changed since slot was last used, slot must not be in use by device
+		void update(uint32_t slot, vk_texture_cache const& textures)
+		{
+			slot_data & current = m_slots[slot];
+			uint32_t count = std::min(static_cast<uint32_t>(textures.size()), m_capacity);
+			if (textures.size() > m_capacity && !m_overflow)
+			{
+				m_overflow = true;
+				std::cout << "px::vk_texture_table - " << textures.size() << " textures loaded, only first " << m_capacity << " are addressable" << std::endl;
+			}
+			if (!m_bindless && current.sets.size() < count)
+			{
+				allocate_sets(current, count);
+			}
+			current.views.resize(count, VK_NULL_HANDLE);
+
+			std::vector<VkDescriptorImageInfo> infos;
+			std::vector<uint32_t> indices;
+			infos.reserve(count);
+			for (uint32_t i = 0; i != count; ++i)
+			{
+				VkImageView view = textures.view(i);
+				view = view == VK_NULL_HANDLE ? textures.fallback() : view;
+				if (view != current.views[i])
+				{
+					current.views[i] = view;
+					infos.push_back({ m_sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+					indices.push_back(i);
+				}
+			}
+
+			std::vector<VkWriteDescriptorSet> writes(infos.size(), VkWriteDescriptorSet{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET });
+			for (size_t i = 0; i != writes.size(); ++i)
+			{
+				writes[i].dstSet = m_bindless ? current.sets[0] : current.sets[indices[i]];
+				writes[i].dstBinding = 0;
+				writes[i].dstArrayElement = m_bindless ? indices[i] : 0;
+				writes[i].descriptorCount = 1;
+				writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				writes[i].pImageInfo = &infos[i];
+			}
+			if (!writes.empty())
+			{
+				vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+			}
+		}
+
+		// bindless mode ignores texture, array is bound once per frame and texture is selected by instance data
+		void bind(VkCommandBuffer commands, VkPipelineLayout layout, uint32_t slot, uint32_t texture) const
+		{
+			slot_data const& current = m_slots[slot];
+			VkDescriptorSet set = m_bindless ? current.sets[0] : current.sets.at(texture);
+			vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &set, 0, nullptr);
+		}
+
+		void create(VkDevice device, vk_device_profile const& profile, bool bindless, uint32_t slots, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_bindless = bindless;
+			auto const& limits = profile.limits();
+			m_capacity = m_bindless ? std::min({ max_bindless, limits.maxPerStageDescriptorSampledImages, limits.maxPerStageDescriptorSamplers, limits.maxDescriptorSetSampledImages }) : max_classic;
+
+			VkSamplerCreateInfo sampler_info{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+			sampler_info.magFilter = VK_FILTER_LINEAR;
+			sampler_info.minFilter = VK_FILTER_LINEAR;
+			sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			sampler_info.maxLod = 16.0f; // views of streamed textures start at their largest resident level
+			if (vkCreateSampler(m_device, &sampler_info, m_allocator, &m_sampler) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_texture_table::create() - failed to create sampler");
+			}
+
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = 0;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			binding.descriptorCount = m_bindless ? m_capacity : 1;
+			binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+			VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT; // slots past loaded textures stay unwritten
+			VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+			flags_info.bindingCount = 1;
+			flags_info.pBindingFlags = &binding_flags;
+
+			VkDescriptorSetLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+			layout_info.pNext = m_bindless ? &flags_info : nullptr;
+			layout_info.bindingCount = 1;
+			layout_info.pBindings = &binding;
+			if (vkCreateDescriptorSetLayout(m_device, &layout_info, m_allocator, &m_layout) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_texture_table::create() - failed to create descriptor set layout");
+			}
+
+			uint32_t sets = m_bindless ? slots : slots * m_capacity;
+			VkDescriptorPoolSize pool_size{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slots * m_capacity };
+			VkDescriptorPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+			pool_info.maxSets = sets;
+			pool_info.poolSizeCount = 1;
+			pool_info.pPoolSizes = &pool_size;
+			if (vkCreateDescriptorPool(m_device, &pool_info, m_allocator, &m_pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_texture_table::create() - failed to create descriptor pool");
+			}
+
+			m_slots.resize(slots);
+			if (m_bindless)
+			{
+				for (auto & current : m_slots)
+				{
+					allocate_sets(current, 1);
+				}
+			}
+		}
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			vkDestroyDescriptorPool(m_device, m_pool, m_allocator); // frees sets
+			vkDestroyDescriptorSetLayout(m_device, m_layout, m_allocator);
+			vkDestroySampler(m_device, m_sampler, m_allocator);
+			m_slots.clear();
+			m_pool = VK_NULL_HANDLE;
+			m_layout = VK_NULL_HANDLE;
+			m_sampler = VK_NULL_HANDLE;
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_texture_table() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_sampler(VK_NULL_HANDLE)
+			, m_layout(VK_NULL_HANDLE)
+			, m_pool(VK_NULL_HANDLE)
+			, m_bindless(false)
+			, m_capacity(0)
+			, m_overflow(false)
+		{
+		}
+		vk_texture_table(vk_texture_table const&) = delete;
+		vk_texture_table& operator=(vk_texture_table const&) = delete;
+		~vk_texture_table()
+		{
+			release();
+		}
+
+	private:
+		struct slot_data
+		{
+			std::vector<VkDescriptorSet> sets; // single array in bindless mode, one per texture otherwise
+			std::vector<VkImageView> views; // written to sets
+		};
+
+	private:
+		static const uint32_t max_bindless = 4096;
+		static const uint32_t max_classic = 1024;
+
+	private:
+		void allocate_sets(slot_data & current, uint32_t count)
+		{
+			size_t first = current.sets.size();
+			std::vector<VkDescriptorSetLayout> layouts(count - first, m_layout);
+			current.sets.resize(count);
+
+			VkDescriptorSetAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+			allocate_info.descriptorPool = m_pool;
+			allocate_info.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+			allocate_info.pSetLayouts = layouts.data();
+			if (vkAllocateDescriptorSets(m_device, &allocate_info, current.sets.data() + first) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_texture_table::allocate_sets() - failed to allocate descriptor sets");
+			}
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		VkSampler m_sampler;
+		VkDescriptorSetLayout m_layout;
+		VkDescriptorPool m_pool;
+		bool m_bindless;
+		uint32_t m_capacity;
+		bool m_overflow; // reported
+		std::vector<slot_data> m_slots;
+	};
+}
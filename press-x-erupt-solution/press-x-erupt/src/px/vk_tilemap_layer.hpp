@@ -0,0 +1,367 @@
+// name: vk_tilemap_layer
+// type: c++ header
+// desc: residency, incremental upload and drawing of tilemap chunks intersecting the view
+// auth: is0urce
+
+#pragma once
+
+// device local buffer is split into fixed slots of one chunk each, chunk tiles are instance data of one quad per tile
+// visible chunks get slot on demand, least recently visible chunk loses its slot when buffer is full
+// newly resident chunk is copied whole, resident one only in range of tiles changed since last upload
+// copies go through own staging ring, chunk not fitting frame budget is retried next frame
+// frame cost depends on chunks covering the view, map size only affects memory of cpu side
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_memory.hpp"
+#include "vk_staging.hpp"
+#include "vk_texture_table.hpp"
+#include <px/core/tilemap.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace px
+{
+	class vk_tilemap_layer final
+	{
+	public:
+		// vertex stage push constants of tilemap.vert
+		struct push_block
+		{
+			float scale[2]; // tiles to clip space
+			float offset[2];
+			int32_t origin[2]; // first tile of chunk
+			uint32_t texture; // atlas
+			uint32_t grid; // atlas columns in low half, rows in high half
+		};
+
+	public:
+		static VkPushConstantRange push_range() noexcept
+		{
+			return{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_block) };
+		}
+		// per instance binding of tile data
+		static VkVertexInputBindingDescription binding_description() noexcept
+		{
+			return{ 0, sizeof(tile), VK_VERTEX_INPUT_RATE_INSTANCE };
+		}
+		static VkVertexInputAttributeDescription attribute_description() noexcept
+		{
+			return{ 0, 0, VK_FORMAT_R16G16_UINT, 0 };
+		}
+
+	public:
+		// map is not owned and edited on render thread only, null detaches
+		void attach(tilemap * map, uint32_t texture, uint32_t columns, uint32_t rows)
+		{
+			m_map = map;
+			m_texture = texture;
+			m_columns = columns;
+			m_rows = rows;
+			m_chunk_slot.assign(m_map ? size_t{ m_map->chunks_x() } * m_map->chunks_y() : 0, none);
+			std::fill(std::begin(m_slot_chunk), std::end(m_slot_chunk), none);
+			m_visible.clear();
+		}
+		tilemap * map() const noexcept
+		{
+			return m_map;
+		}
+		uint32_t texture() const noexcept
+		{
+			return m_texture;
+		}
+		// atlas cells per row and column
+		uint32_t columns() const noexcept
+		{
+			return m_columns;
+		}
+		uint32_t rows() const noexcept
+		{
+			return m_rows;
+		}
+		// rectangle of the map shown on screen, in tiles
+		void view(float x, float y, float width, float height) noexcept
+		{
+			m_view[0] = x;
+			m_view[1] = y;
+			m_view[2] = width;
+			m_view[3] = height;
+		}
+		// chunks with slot
+		size_t resident() const noexcept
+		{
+			return m_slot_chunk.size() - std::count(std::begin(m_slot_chunk), std::end(m_slot_chunk), none);
+		}
+		// chunks drawn by last update
+		size_t visible() const noexcept
+		{
+			return m_visible.size();
+		}
+
+		// records copies for chunks in view, outside of render pass, slot must not be in use by device
+		void update(VkCommandBuffer commands, uint32_t slot)
+		{
+			++m_frame;
+			m_visible.clear();
+			m_staging.begin(slot);
+			if (!m_map)
+			{
+				return;
+			}
+
+			std::vector<VkBufferCopy> copies;
+			VkBuffer source = VK_NULL_HANDLE;
+			tilemap::chunk_range range = m_map->covering(m_view[0], m_view[1], m_view[2], m_view[3]);
+			for (uint32_t y = range.y0; y != range.y1; ++y)
+			{
+				for (uint32_t x = range.x0; x != range.x1; ++x)
+				{
+					tilemap::chunk const& current = m_map->at(x, y);
+					uint32_t index = y * m_map->chunks_x() + x;
+					uint32_t target = m_chunk_slot[index];
+					if (current.filled == 0 && target == none)
+					{
+						continue;
+					}
+
+					bool whole = target == none;
+					uint32_t begin = whole ? 0 : current.dirty_begin;
+					uint32_t end = whole ? tilemap::chunk_tiles : current.dirty_end;
+					if (begin != end)
+					{
+						VkDeviceSize size = (end - begin) * sizeof(tile);
+						vk_staging::range staged = m_staging.allocate(size, sizeof(tile));
+						if (staged.data == nullptr)
+						{
+							if (whole)
+							{
+								continue; // nothing to draw yet
+							}
+						}
+						else
+						{
+							if (whole)
+							{
+								target = acquire(index);
+								if (target == none)
+								{
+									report_overflow();
+									continue;
+								}
+							}
+							std::memcpy(staged.data, current.tiles.data() + begin, static_cast<size_t>(size));
+							copies.push_back({ staged.offset, target * chunk_bytes + begin * sizeof(tile), size });
+							source = staged.buffer;
+							uint32_t taken_begin, taken_end;
+							m_map->take_dirty(x, y, taken_begin, taken_end);
+						}
+					}
+
+					m_slot_used[target] = m_frame;
+					if (current.filled != 0)
+					{
+						m_visible.push_back(target);
+					}
+				}
+			}
+
+			if (copies.empty())
+			{
+				return;
+			}
+			// previous frames read instances of slots being overwritten
+			VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+			barrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = m_buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+			vkCmdCopyBuffer(commands, source, m_buffer, static_cast<uint32_t>(copies.size()), copies.data());
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+
+		// records draws of chunks collected by update, tilemap pipeline must be bound
+		void draw(VkCommandBuffer commands, VkPipelineLayout layout, vk_texture_table const& table, uint32_t slot) const
+		{
+			if (m_visible.empty())
+			{
+				return;
+			}
+			if (!table.bindless())
+			{
+				table.bind(commands, layout, slot, m_texture);
+			}
+
+			push_block block;
+			block.scale[0] = 2.0f / m_view[2];
+			block.scale[1] = 2.0f / m_view[3];
+			block.offset[0] = -m_view[0] * block.scale[0] - 1.0f;
+			block.offset[1] = -m_view[1] * block.scale[1] - 1.0f;
+			block.texture = m_texture;
+			block.grid = (m_columns & 0xffff) | (m_rows << 16);
+			for (uint32_t target : m_visible)
+			{
+				uint32_t index = m_slot_chunk[target];
+				block.origin[0] = static_cast<int32_t>(index % m_map->chunks_x() * tilemap::chunk_size);
+				block.origin[1] = static_cast<int32_t>(index / m_map->chunks_x() * tilemap::chunk_size);
+				VkDeviceSize offset = target * chunk_bytes;
+				vkCmdBindVertexBuffers(commands, 0, 1, &m_buffer, &offset);
+				vkCmdPushConstants(commands, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_block), &block);
+				vkCmdDraw(commands, 6, tilemap::chunk_tiles, 0, 0);
+			}
+		}
+
+		// slots is number of chunks resident at once, has to exceed chunks covering the view
+		void create(VkDevice device, vk_memory & memory, uint32_t slots, VkDeviceSize staging_bytes, uint32_t frames, VkAllocationCallbacks const* allocator = nullptr)
+		{
+			release();
+
+			m_device = device;
+			m_allocator = allocator;
+			m_memory = &memory;
+			m_staging.create(device, memory, staging_bytes, frames, allocator);
+
+			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			buffer_info.size = slots * chunk_bytes;
+			buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateBuffer(m_device, &buffer_info, m_allocator, &m_buffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("px::vk_tilemap_layer::create() - failed to create chunk buffer");
+			}
+
+			try
+			{
+				m_allocation = memory.bind(m_buffer, vk_memory::category::vertex, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			}
+			catch (...)
+			{
+				vkDestroyBuffer(m_device, m_buffer, m_allocator);
+				m_buffer = VK_NULL_HANDLE;
+				throw;
+			}
+			memory.movable(m_allocation, [this, buffer_info](vk_memory::allocation const& moved) {
+				VkBuffer replaced = m_buffer;
+				m_buffer = m_memory->buffer(buffer_info, moved);
+				m_allocation = moved;
+				return replaced;
+			});
+
+			m_slot_chunk.assign(slots, none);
+			m_slot_used.assign(slots, 0);
+			attach(m_map, m_texture, m_columns, m_rows); // resident chunks are lost
+		}
+		void release() noexcept
+		{
+			if (m_device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			m_staging.release();
+			vkDestroyBuffer(m_device, m_buffer, m_allocator);
+			m_memory->free(m_allocation);
+			m_buffer = VK_NULL_HANDLE;
+			m_slot_chunk.clear();
+			m_slot_used.clear();
+			m_visible.clear();
+			m_device = VK_NULL_HANDLE;
+		}
+
+	public:
+		vk_tilemap_layer() noexcept
+			: m_device(VK_NULL_HANDLE)
+			, m_allocator(nullptr)
+			, m_memory(nullptr)
+			, m_buffer(VK_NULL_HANDLE)
+			, m_allocation{}
+			, m_map(nullptr)
+			, m_texture(0)
+			, m_columns(1)
+			, m_rows(1)
+			, m_view{ 0, 0, 1, 1 }
+			, m_frame(0)
+			, m_overflow(false)
+		{
+		}
+		vk_tilemap_layer(vk_tilemap_layer const&) = delete;
+		vk_tilemap_layer& operator=(vk_tilemap_layer const&) = delete;
+		~vk_tilemap_layer()
+		{
+			release();
+		}
+
+	private:
+		enum : uint32_t { none = 0xffffffff }; // no slot or no chunk
+		static const VkDeviceSize chunk_bytes = tilemap::chunk_tiles * sizeof(tile);
+
+	private:
+		// free slot or slot of least recently visible chunk not used in current frame
+		uint32_t acquire(uint32_t chunk)
+		{
+			uint32_t found = none;
+			for (uint32_t i = 0, size = static_cast<uint32_t>(m_slot_chunk.size()); i != size; ++i)
+			{
+				if (m_slot_chunk[i] == none)
+				{
+					found = i;
+					break;
+				}
+				if (m_slot_used[i] != m_frame && (found == none || m_slot_used[i] < m_slot_used[found]))
+				{
+					found = i;
+				}
+			}
+			if (found != none)
+			{
+				if (m_slot_chunk[found] != none)
+				{
+					m_chunk_slot[m_slot_chunk[found]] = none;
+				}
+				m_slot_chunk[found] = chunk;
+				m_chunk_slot[chunk] = found;
+			}
+			return found;
+		}
+		void report_overflow()
+		{
+			if (!m_overflow)
+			{
+				m_overflow = true;
+				std::cout << "px::vk_tilemap_layer - view covers more than " << m_slot_chunk.size() << " chunks, rest is not drawn" << std::endl;
+			}
+		}
+
+	private:
+		VkDevice m_device;
+		VkAllocationCallbacks const* m_allocator; // host memory of driver, null for default
+		vk_memory * m_memory;
+		VkBuffer m_buffer; // chunk slots
+		vk_memory::allocation m_allocation;
+		vk_staging m_staging;
+
+		tilemap * m_map;
+		uint32_t m_texture;
+		uint32_t m_columns;
+		uint32_t m_rows;
+		float m_view[4]; // x, y, width, height in tiles
+
+		std::vector<uint32_t> m_chunk_slot; // per map chunk, none if not resident
+		std::vector<uint32_t> m_slot_chunk; // per slot, none if free
+		std::vector<uint64_t> m_slot_used; // frame slot was last visible in
+		std::vector<uint32_t> m_visible; // slots drawn this frame
+		uint64_t m_frame;
+		bool m_overflow; // reported
+	};
+}
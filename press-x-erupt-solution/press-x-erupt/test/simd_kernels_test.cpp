@@ -0,0 +1,12 @@
+// every simd level supported by cpu gives bit identical results to scalar kernels
+
+#include <px/core/simd_benchmark.hpp>
+
+#include <cstdlib>
+#include <iostream>
+
+int main()
+{
+	// odd count runs vector bodies and scalar remainders of every level
+	return px::benchmark_simd(std::cout, (1 << 12) + 3, 1) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,82 @@
+// queries of spatial grid match brute force intersection under random inserts, moves and erases
+// boxes reach out of grid bounds and span several cells, so overflow cell and loose placement are covered
+
+#include <px/core/spatial_grid.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+int main()
+{
+	static const uint32_t count = 5000;
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-150.0f, 1150.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 80.0f);
+	auto make_box = [&]() {
+		float x = position(random);
+		float y = position(random);
+		return px::aabb{ x, y, x + extent(random), y + extent(random) };
+	};
+
+	px::spatial_grid grid({ 0, 0, 1000, 1000 }, 32);
+	std::vector<px::aabb> boxes(count);
+	std::vector<bool> alive(count, true);
+	for (uint32_t id = 0; id != count; ++id)
+	{
+		boxes[id] = make_box();
+		grid.insert(id, boxes[id]);
+	}
+
+	for (int round = 0; round != 200; ++round)
+	{
+		for (int change = 0; change != 300; ++change)
+		{
+			uint32_t id = random() % count;
+			if (!alive[id])
+			{
+				boxes[id] = make_box();
+				grid.insert(id, boxes[id]);
+				alive[id] = true;
+			}
+			else if (change % 5 == 0)
+			{
+				grid.erase(id);
+				alive[id] = false;
+			}
+			else
+			{
+				float shift = (position(random) - 500.0f) / 50.0f;
+				boxes[id].min_x += shift;
+				boxes[id].max_x += shift;
+				grid.move(id, boxes[id]);
+			}
+		}
+
+		px::aabb view = make_box();
+		view.max_x += 100;
+		view.max_y += 50;
+		std::vector<uint32_t> visible;
+		grid.query(view, visible);
+
+		std::multiset<uint32_t> found(visible.begin(), visible.end()); // duplicates are errors too
+		std::multiset<uint32_t> expected;
+		for (uint32_t id = 0; id != count; ++id)
+		{
+			if (alive[id] && boxes[id].intersects(view))
+			{
+				expected.insert(id);
+			}
+		}
+		if (found != expected)
+		{
+			std::cout << "px::spatial_grid_test - round " << round << " found " << found.size() << " expected " << expected.size() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+// defragmenter drains sparse blocks of mock device, buffers keep their contents and stay bound where owners think
+// device memory is host heap and transfer copies run immediately, so contents can be checked right after frame
+// some relocation callbacks throw, those moves have to be undone with owner and source untouched
+
+#include <px/vk_defragmenter.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	int memory_objects = 0;
+	int buffer_objects = 0;
+	std::map<VkBuffer, VkDeviceSize> sizes;
+	std::map<VkBuffer, std::pair<VkDeviceMemory, VkDeviceSize>> bindings;
+
+	unsigned char * host(VkDeviceMemory memory, VkDeviceSize offset)
+	{
+		return reinterpret_cast<unsigned char *>(memory) + offset;
+	}
+}
+
+VkResult vkAllocateMemory(VkDevice, VkMemoryAllocateInfo const* info, VkAllocationCallbacks const*, VkDeviceMemory * memory)
+{
+	*memory = reinterpret_cast<VkDeviceMemory>(std::malloc(static_cast<size_t>(info->allocationSize)));
+	++memory_objects;
+	return VK_SUCCESS;
+}
+void vkFreeMemory(VkDevice, VkDeviceMemory memory, VkAllocationCallbacks const*)
+{
+	std::free(reinterpret_cast<void *>(memory));
+	--memory_objects;
+}
+VkResult vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize, VkDeviceSize, VkMemoryMapFlags, void ** data)
+{
+	*data = reinterpret_cast<void *>(memory);
+	return VK_SUCCESS;
+}
+PFN_vkVoidFunction vkGetInstanceProcAddr(VkInstance, char const*)
+{
+	return nullptr;
+}
+VkResult vkCreateBuffer(VkDevice, VkBufferCreateInfo const* info, VkAllocationCallbacks const*, VkBuffer * buffer)
+{
+	*buffer = reinterpret_cast<VkBuffer>(new char);
+	sizes[*buffer] = info->size;
+	++buffer_objects;
+	return VK_SUCCESS;
+}
+void vkDestroyBuffer(VkDevice, VkBuffer buffer, VkAllocationCallbacks const*)
+{
+	if (buffer != VK_NULL_HANDLE)
+	{
+		delete reinterpret_cast<char *>(buffer);
+		sizes.erase(buffer);
+		bindings.erase(buffer);
+		--buffer_objects;
+	}
+}
+void vkGetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements * requirements)
+{
+	requirements->size = sizes.at(buffer);
+	requirements->alignment = 16;
+	requirements->memoryTypeBits = 1;
+}
+VkResult vkBindBufferMemory(VkDevice, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize offset)
+{
+	bindings[buffer] = { memory, offset };
+	return VK_SUCCESS;
+}
+void vkCmdCopyBuffer(VkCommandBuffer, VkBuffer source, VkBuffer target, uint32_t count, VkBufferCopy const* copies)
+{
+	auto from = bindings.at(source);
+	auto to = bindings.at(target);
+	for (uint32_t i = 0; i != count; ++i)
+	{
+		std::memmove(host(to.first, to.second + copies[i].dstOffset), host(from.first, from.second + copies[i].srcOffset), static_cast<size_t>(copies[i].size));
+	}
+}
+void vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags, uint32_t, VkMemoryBarrier const*, uint32_t, VkBufferMemoryBarrier const*, uint32_t, VkImageMemoryBarrier const*)
+{
+}
+
+int main()
+{
+	struct owner
+	{
+		VkBuffer buffer;
+		px::vk_memory::allocation memory;
+		unsigned char tag;
+	};
+
+	// one device local heap, memory is not mapped, so allocations are movable
+	px::vk_device_profile profile;
+	auto & properties = const_cast<VkPhysicalDeviceMemoryProperties &>(profile.memory());
+	properties.memoryHeapCount = 1;
+	properties.memoryHeaps[0] = { VkDeviceSize{ 1 } << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+	properties.memoryTypeCount = 1;
+	properties.memoryTypes[0] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+
+	VkDevice device = reinterpret_cast<VkDevice>(&profile);
+	VkCommandBuffer commands = reinterpret_cast<VkCommandBuffer>(&profile);
+	px::vk_memory memory;
+	memory.create(VK_NULL_HANDLE, profile, device, false);
+	px::vk_defragmenter defragmenter;
+	defragmenter.create(device, memory, 3);
+
+	std::mt19937 random(3);
+	unsigned int relocations = 0;
+	std::vector<std::unique_ptr<owner>> owners;
+	for (int i = 0; i != 3000; ++i)
+	{
+		VkBufferCreateInfo info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		info.size = random() % 40000 + 1;
+		std::unique_ptr<owner> created(new owner{});
+		vkCreateBuffer(device, &info, nullptr, &created->buffer);
+		created->memory = memory.bind(created->buffer, px::vk_memory::category::vertex, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		created->tag = static_cast<unsigned char>(random());
+		std::memset(host(created->memory.memory, created->memory.offset), created->tag, static_cast<size_t>(created->memory.size));
+		owner * target = created.get();
+		memory.movable(created->memory, [&memory, &relocations, target, info](px::vk_memory::allocation const& moved) {
+			if (++relocations % 13 == 0)
+			{
+				throw std::runtime_error("rebind refused by test");
+			}
+			VkBuffer replaced = target->buffer;
+			target->buffer = memory.buffer(info, moved);
+			target->memory = moved;
+			return replaced;
+		});
+		owners.push_back(std::move(created));
+	}
+	for (size_t i = 0; i != owners.size();)
+	{
+		if (random() % 5 != 0)
+		{
+			vkDestroyBuffer(device, owners[i]->buffer, nullptr);
+			memory.free(owners[i]->memory);
+			owners[i] = std::move(owners.back());
+			owners.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+	memory.report(std::cout);
+
+	bool failed = false;
+	for (int frame = 0; frame != 3000 && !failed; ++frame)
+	{
+		defragmenter.update(commands, frame % 3);
+		bool contents = frame % 50 == 49; // bindings are checked every frame, contents now and then
+		for (auto const& current : owners)
+		{
+			auto bound = bindings.at(current->buffer);
+			unsigned char const* data = host(current->memory.memory, current->memory.offset);
+			if (bound.first != current->memory.memory || bound.second != current->memory.offset || (contents && std::count(data, data + current->memory.size, current->tag) != static_cast<std::ptrdiff_t>(current->memory.size)))
+			{
+				std::cout << "px::vk_defragmenter_test - frame " << frame << " buffer moved away from its contents" << std::endl;
+				failed = true;
+				break;
+			}
+		}
+	}
+	memory.report(std::cout);
+	defragmenter.report(std::cout);
+
+	for (auto const& current : owners)
+	{
+		vkDestroyBuffer(device, current->buffer, nullptr);
+		memory.free(current->memory);
+	}
+	defragmenter.release();
+	memory.release();
+	if (memory_objects != 0 || buffer_objects != 0)
+	{
+		std::cout << "px::vk_defragmenter_test - " << memory_objects << " memory objects and " << buffer_objects << " buffers leaked" << std::endl;
+		failed = true;
+	}
+	if (relocations < 13)
+	{
+		std::cout << "px::vk_defragmenter_test - nothing was moved" << std::endl;
+		failed = true;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+// threads allocate, reallocate and free through callbacks of one allocator, meant to run under address sanitizer too
+// blocks are aligned as requested, contents survive reallocation and accounting is back to zero at the end
+
+#include <px/vk_host_allocator.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+int main()
+{
+	px::vk_host_allocator allocator;
+	VkAllocationCallbacks const* callbacks = allocator.callbacks();
+	std::atomic<bool> failed(false);
+
+	auto work = [&](unsigned int seed) {
+		std::mt19937 random(seed);
+		std::vector<std::pair<void *, size_t>> live;
+		for (int i = 0; i != 50000 && !failed; ++i)
+		{
+			unsigned int operation = random() % 3;
+			if (operation != 2 || live.empty())
+			{
+				size_t size = 1 + random() % (random() % 10 == 0 ? 20000 : 300); // some requests bypass pools
+				size_t alignment = size_t{ 1 } << random() % 8;
+				VkSystemAllocationScope scope = static_cast<VkSystemAllocationScope>(random() % px::vk_host_allocator::scope_count);
+				void * block = callbacks->pfnAllocation(callbacks->pUserData, size, alignment, scope);
+				if (block == nullptr || reinterpret_cast<uintptr_t>(block) % alignment != 0)
+				{
+					std::cout << "px::vk_host_allocator_test - null or misaligned block" << std::endl;
+					failed = true;
+					break;
+				}
+				std::memset(block, 0xab, size);
+				live.emplace_back(block, size);
+			}
+			else if (random() % 2 == 0)
+			{
+				auto & current = live[random() % live.size()];
+				size_t size = 1 + random() % 5000;
+				unsigned char * block = static_cast<unsigned char *>(callbacks->pfnReallocation(callbacks->pUserData, current.first, size, 16, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT));
+				size_t kept = std::min(size, current.second);
+				if (block == nullptr || std::count(block, block + kept, 0xab) != static_cast<std::ptrdiff_t>(kept))
+				{
+					std::cout << "px::vk_host_allocator_test - reallocation lost contents" << std::endl;
+					failed = true;
+					break;
+				}
+				std::memset(block, 0xab, size);
+				current = { block, size };
+			}
+			else
+			{
+				size_t index = random() % live.size();
+				callbacks->pfnFree(callbacks->pUserData, live[index].first);
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+		for (auto const& current : live)
+		{
+			callbacks->pfnFree(callbacks->pUserData, current.first);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int seed = 1; seed != 4; ++seed)
+	{
+		threads.emplace_back(work, seed);
+	}
+	work(4);
+	for (auto & thread : threads)
+	{
+		thread.join();
+	}
+
+	for (size_t scope = 0; scope != px::vk_host_allocator::scope_count; ++scope)
+	{
+		px::vk_host_allocator::scope_stats current = allocator.stats(static_cast<VkSystemAllocationScope>(scope));
+		if (current.bytes != 0 || current.count != 0)
+		{
+			std::cout << "px::vk_host_allocator_test - scope " << scope << " not balanced" << std::endl;
+			failed = true;
+		}
+	}
+	allocator.report(std::cout);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}